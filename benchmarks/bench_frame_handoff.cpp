@@ -0,0 +1,133 @@
+// Measures the per-frame cost of handing ring slots between the offline
+// render loop and the encoder thread, with no GPU or encode work at all.
+// This is the overhead that dominates at small resolutions / high FPS.
+//
+// Usage: bench_frame_handoff [frames]
+#include "spsc_ring.h"
+
+#include <spdlog/fmt/fmt.h>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+constexpr uint32_t MAX_SLOTS = 8;
+
+struct EncodeItem {
+    uint32_t slotIndex = 0;
+    uint32_t frameIndex = 0;
+};
+
+// Mirror of the previous OfflineSDFRenderer scheme: one mutex, one shared
+// condition variable, a deque and per-slot pendingEncode flags.
+double runMutexHandoff(uint32_t frames, uint32_t ringSize) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<EncodeItem> queue;
+    std::array<bool, MAX_SLOTS> pending{};
+    bool stop = false;
+    uint64_t checksum = 0;
+
+    std::thread consumer([&] {
+        while (true) {
+            EncodeItem item;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return stop || !queue.empty(); });
+                if (queue.empty())
+                    break;
+                item = queue.front();
+                queue.pop_front();
+                cv.notify_all();
+            }
+            checksum += item.frameIndex;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending[item.slotIndex] = false;
+            }
+            cv.notify_all();
+        }
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        const uint32_t slot = frame % ringSize;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return !pending[slot]; });
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return queue.size() < ringSize; });
+        pending[slot] = true;
+        queue.push_back(EncodeItem{slot, frame});
+        lock.unlock();
+        cv.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    consumer.join();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    if (checksum == 0 && frames > 1)
+        std::abort();
+    return std::chrono::duration<double, std::nano>(elapsed).count() /
+           static_cast<double>(frames);
+}
+
+// Current scheme: free-slot ring + ready-frame ring.
+double runSpscHandoff(uint32_t frames, uint32_t ringSize) {
+    SpscRing<uint32_t> freeSlots(ringSize);
+    SpscRing<EncodeItem> readyFrames(ringSize);
+    for (uint32_t i = 0; i < ringSize; ++i) {
+        (void)freeSlots.tryPush(i);
+    }
+    uint64_t checksum = 0;
+
+    std::thread consumer([&] {
+        while (const auto item = readyFrames.pop()) {
+            checksum += item->frameIndex;
+            (void)freeSlots.push(item->slotIndex);
+        }
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        const auto slot = freeSlots.pop();
+        (void)readyFrames.push(EncodeItem{*slot, frame});
+    }
+    readyFrames.close();
+    consumer.join();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    if (checksum == 0 && frames > 1)
+        std::abort();
+    return std::chrono::duration<double, std::nano>(elapsed).count() /
+           static_cast<double>(frames);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    const uint32_t frames =
+        argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 1'000'000;
+
+    fmt::print("Frame handoff cost, {} frames (ns/frame)\n", frames);
+    fmt::print("{:>5} {:>14} {:>14} {:>9}\n", "ring", "mutex+cv",
+               "spsc", "speedup");
+    for (uint32_t ringSize : {1u, 2u, 3u, 4u, 8u}) {
+        const double mutexNs = runMutexHandoff(frames, ringSize);
+        const double spscNs = runSpscHandoff(frames, ringSize);
+        fmt::print("{:>5} {:>14.1f} {:>14.1f} {:>8.2f}x\n", ringSize, mutexNs,
+                   spscNs, mutexNs / spscNs);
+    }
+    return 0;
+}
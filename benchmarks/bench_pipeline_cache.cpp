@@ -0,0 +1,150 @@
+// Measures what the persistent pipeline cache saves at startup. Each
+// iteration creates a fresh device, as a new vsdf process would, and
+// times vkCreateGraphicsPipelines for one fragment shader:
+//   cold: empty VkPipelineCache (the first run on a machine)
+//   warm: cache seeded from a file written by an earlier device, going
+//         through the same pipeline_cache::saveAtomic/load as vsdf
+// Drivers keep their own on-disk shader caches which would make the cold
+// case look warm; turn them off to see the real difference, eg.
+//   MESA_SHADER_CACHE_DISABLE=true __GL_SHADER_DISK_CACHE=0 \
+//       bench_pipeline_cache
+//
+// Usage: bench_pipeline_cache [shader.frag] [iterations] [toy 0|1]
+// (defaults to shaders/testtoyshader.frag as a toy shader)
+#include "pipeline_cache.h"
+#include "shader_utils.h"
+#include "vkutils.h"
+
+#include <spdlog/fmt/fmt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+struct Timing {
+    double loadMs = 0.0;
+    double createMs = 0.0;
+};
+
+// One startup: device, cache (optionally seeded), render pass and the
+// pipeline. Returns the cache contents so the next run can be seeded.
+Timing measureStartup(VkInstance instance, VkPhysicalDevice physicalDevice,
+                      const std::vector<uint32_t> &fragSpirv,
+                      const std::filesystem::path *cacheFile,
+                      std::vector<uint8_t> &cacheData) {
+    const VkPhysicalDeviceProperties properties =
+        vkutils::getDeviceProperties(physicalDevice);
+    const uint32_t queueIndex =
+        vkutils::getVulkanGraphicsQueueIndex(physicalDevice);
+    VkDevice device =
+        vkutils::createVulkanLogicalDevice(physicalDevice, queueIndex, true);
+
+    Timing timing;
+    const auto loadStart = Clock::now();
+    std::vector<uint8_t> initialData;
+    if (cacheFile != nullptr) {
+        initialData = pipeline_cache::load(
+            *cacheFile, vkutils::pipelineCacheKey(properties));
+    }
+    VkPipelineCacheCreateInfo cacheInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .initialDataSize = initialData.size(),
+        .pInitialData = initialData.empty() ? nullptr : initialData.data(),
+    };
+    VkPipelineCache cache;
+    VK_CHECK(vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache));
+    timing.loadMs = Milliseconds(Clock::now() - loadStart).count();
+
+    VkRenderPass renderPass =
+        vkutils::createRenderPass(device, VK_FORMAT_B8G8R8A8_UNORM, true);
+    VkPipelineLayout layout = vkutils::createPipelineLayout(device);
+    const auto vertSpirv = shader_utils::compileFullscreenQuadVertSpirv();
+    VkShaderModule vert = vkutils::createShaderModule(device, vertSpirv);
+    VkShaderModule frag = vkutils::createShaderModule(device, fragSpirv);
+
+    const auto createStart = Clock::now();
+    VkPipeline pipeline = vkutils::createGraphicsPipeline(
+        device, renderPass, layout, VkExtent2D{1280, 720}, vert, frag,
+        std::nullopt, cache);
+    timing.createMs = Milliseconds(Clock::now() - createStart).count();
+
+    size_t size = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &size, nullptr));
+    cacheData.resize(size);
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &size, cacheData.data()));
+    cacheData.resize(size);
+
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyShaderModule(device, frag, nullptr);
+    vkDestroyShaderModule(device, vert, nullptr);
+    vkDestroyPipelineLayout(device, layout, nullptr);
+    vkDestroyRenderPass(device, renderPass, nullptr);
+    vkDestroyPipelineCache(device, cache, nullptr);
+    vkDestroyDevice(device, nullptr);
+    return timing;
+}
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    const std::string shaderPath =
+        argc > 1 ? argv[1]
+                 : std::string(VSDF_SOURCE_DIR) + "/shaders/testtoyshader.frag";
+    const uint32_t iterations =
+        argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 10;
+    const bool toy = argc > 3 ? std::string(argv[3]) != "0" : argc <= 1;
+    spdlog::set_level(spdlog::level::warn);
+
+    const auto fragSpirv = shader_utils::compileFileToSpirv(shaderPath, toy);
+    VkInstance instance = vkutils::setupVulkanInstance(true);
+    VkPhysicalDevice physicalDevice = vkutils::findGPU(instance);
+    const VkPhysicalDeviceProperties properties =
+        vkutils::getDeviceProperties(physicalDevice);
+    const auto cacheFile =
+        std::filesystem::temp_directory_path() /
+        fmt::format("vsdf_bench_pipeline_cache_{}.bin",
+                    Clock::now().time_since_epoch().count());
+
+    std::vector<double> coldMs;
+    std::vector<double> warmMs;
+    std::vector<double> warmLoadMs;
+    std::vector<uint8_t> cacheData;
+    for (uint32_t i = 0; i < iterations; ++i) {
+        coldMs.push_back(measureStartup(instance, physicalDevice, fragSpirv,
+                                        nullptr, cacheData)
+                             .createMs);
+    }
+    // The last cold run's cache is what vsdf would have saved on exit.
+    pipeline_cache::saveAtomic(cacheFile, cacheData);
+    const size_t cacheBytes = cacheData.size();
+    for (uint32_t i = 0; i < iterations; ++i) {
+        const Timing timing = measureStartup(instance, physicalDevice,
+                                             fragSpirv, &cacheFile, cacheData);
+        warmMs.push_back(timing.createMs);
+        warmLoadMs.push_back(timing.loadMs);
+    }
+    std::filesystem::remove(cacheFile);
+
+    fmt::print("Pipeline creation on {}, {} ({} iterations, median)\n",
+               properties.deviceName, shaderPath, iterations);
+    fmt::print("cold {:>9.3f} ms\n", median(coldMs));
+    fmt::print("warm {:>9.3f} ms (+{:.3f} ms to load {} byte cache)\n",
+               median(warmMs), median(warmLoadMs), cacheBytes);
+    fmt::print("speedup {:.1f}x\n", median(coldMs) / median(warmMs));
+
+    vkDestroyInstance(instance, nullptr);
+    return 0;
+}
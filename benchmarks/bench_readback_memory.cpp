@@ -0,0 +1,192 @@
+// Measures GPU -> CPU readback bandwidth for every host-visible memory type
+// on the current device. Each iteration the GPU fills a staging buffer,
+// the CPU waits, invalidates the mapping if the memory is non-coherent and
+// copies it out, which is what the encoder does with a ring slot.
+//
+// Usage: bench_readback_memory [MiB] [iterations]
+#include "vkutils.h"
+
+#include <spdlog/fmt/fmt.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+struct Device {
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+};
+
+std::string describeMemoryType(VkMemoryPropertyFlags flags) {
+    std::string out;
+    const auto add = [&out](const char *name) {
+        if (!out.empty())
+            out += '|';
+        out += name;
+    };
+    if (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+        add("DEVICE_LOCAL");
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        add("HOST_VISIBLE");
+    if (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+        add("HOST_COHERENT");
+    if (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)
+        add("HOST_CACHED");
+    return out;
+}
+
+// Returns MiB/s of CPU reads, or a negative value if the type can't back
+// a transfer destination buffer.
+double measureMemoryType(const Device &ctx, uint32_t memoryTypeIndex,
+                         bool coherent, VkDeviceSize bytes,
+                         uint32_t iterations) {
+    VkBufferCreateInfo bufferInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = bytes,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateBuffer(ctx.device, &bufferInfo, nullptr, &buffer));
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(ctx.device, buffer, &memRequirements);
+    if (!(memRequirements.memoryTypeBits & (1u << memoryTypeIndex))) {
+        vkDestroyBuffer(ctx.device, buffer, nullptr);
+        return -1.0;
+    }
+
+    VkMemoryAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = memoryTypeIndex,
+    };
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(ctx.device, &allocInfo, nullptr, &memory) !=
+        VK_SUCCESS) {
+        vkDestroyBuffer(ctx.device, buffer, nullptr);
+        return -1.0;
+    }
+    VK_CHECK(vkBindBufferMemory(ctx.device, buffer, memory, 0));
+    void *mapped = nullptr;
+    VK_CHECK(vkMapMemory(ctx.device, memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+
+    VkCommandBuffer commandBuffer =
+        vkutils::allocateCommandBuffer(ctx.device, ctx.commandPool);
+    std::vector<uint8_t> cpuCopy(bytes);
+    std::chrono::nanoseconds readTime{};
+    uint64_t checksum = 0;
+
+    for (uint32_t i = 0; i < iterations; ++i) {
+        VkCommandBufferBeginInfo beginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+        VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+        vkCmdFillBuffer(commandBuffer, buffer, 0, VK_WHOLE_SIZE, i + 1);
+        VkBufferMemoryBarrier toHost{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = buffer,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1,
+                             &toHost, 0, nullptr);
+        VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+        VkSubmitInfo submitInfo{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &commandBuffer,
+        };
+        VK_CHECK(vkQueueSubmit(ctx.queue, 1, &submitInfo, VK_NULL_HANDLE));
+        VK_CHECK(vkQueueWaitIdle(ctx.queue));
+
+        const auto start = std::chrono::steady_clock::now();
+        if (!coherent) {
+            VkMappedMemoryRange range{
+                .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+                .memory = memory,
+                .offset = 0,
+                .size = VK_WHOLE_SIZE,
+            };
+            VK_CHECK(vkInvalidateMappedMemoryRanges(ctx.device, 1, &range));
+        }
+        std::memcpy(cpuCopy.data(), mapped, cpuCopy.size());
+        readTime += std::chrono::steady_clock::now() - start;
+        checksum += cpuCopy[cpuCopy.size() / 2];
+    }
+
+    vkFreeCommandBuffers(ctx.device, ctx.commandPool, 1, &commandBuffer);
+    vkUnmapMemory(ctx.device, memory);
+    vkFreeMemory(ctx.device, memory, nullptr);
+    vkDestroyBuffer(ctx.device, buffer, nullptr);
+
+    if (checksum == 0)
+        std::abort();
+    const double seconds = std::chrono::duration<double>(readTime).count();
+    const double mib = static_cast<double>(bytes) / (1024.0 * 1024.0);
+    return mib * static_cast<double>(iterations) / seconds;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    const uint32_t sizeMiB =
+        argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 32;
+    const uint32_t iterations =
+        argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 20;
+    spdlog::set_level(spdlog::level::warn);
+
+    Device ctx;
+    ctx.instance = vkutils::setupVulkanInstance(true);
+    ctx.physicalDevice = vkutils::findGPU(ctx.instance);
+    const uint32_t queueIndex =
+        vkutils::getVulkanGraphicsQueueIndex(ctx.physicalDevice);
+    ctx.device = vkutils::createVulkanLogicalDevice(ctx.physicalDevice,
+                                                    queueIndex, true);
+    vkGetDeviceQueue(ctx.device, queueIndex, 0, &ctx.queue);
+    ctx.commandPool = vkutils::createCommandPool(ctx.device, queueIndex);
+
+    const VkPhysicalDeviceProperties properties =
+        vkutils::getDeviceProperties(ctx.physicalDevice);
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(ctx.physicalDevice, &memProperties);
+
+    const VkDeviceSize bytes = static_cast<VkDeviceSize>(sizeMiB) << 20;
+    fmt::print("Readback bandwidth on {}, {} MiB x {} iterations (MiB/s)\n",
+               properties.deviceName, sizeMiB, iterations);
+    fmt::print("{:>4} {:>12}  {}\n", "type", "MiB/s", "flags");
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+        const VkMemoryPropertyFlags flags =
+            memProperties.memoryTypes[i].propertyFlags;
+        if (!(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+            continue;
+        const bool coherent = flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        const double mibPerSecond =
+            measureMemoryType(ctx, i, coherent, bytes, iterations);
+        if (mibPerSecond < 0.0) {
+            fmt::print("{:>4} {:>12}  {}\n", i, "n/a",
+                       describeMemoryType(flags));
+            continue;
+        }
+        fmt::print("{:>4} {:>12.0f}  {}\n", i, mibPerSecond,
+                   describeMemoryType(flags));
+    }
+
+    vkDestroyCommandPool(ctx.device, ctx.commandPool, nullptr);
+    vkDestroyDevice(ctx.device, nullptr);
+    vkDestroyInstance(ctx.instance, nullptr);
+    return 0;
+}
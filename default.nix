@@ -11,6 +11,7 @@
 , spirv-tools
 , llvmPackages_21
 , ffmpeg
+, zlib
 , pkg-config
 , fetchFromGitHub
 }:
@@ -52,6 +53,7 @@ stdenv.mkDerivation {
     glslang
     spirv-tools
     ffmpeg
+    zlib
   ];
 
   cmakeFlags = [
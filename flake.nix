@@ -55,6 +55,7 @@
             vulkan-loader
             vulkan-headers
             ffmpeg
+            zlib
             pkg-config
 
             # shaderc
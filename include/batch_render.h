@@ -0,0 +1,42 @@
+#ifndef BATCH_RENDER_H
+#define BATCH_RENDER_H
+
+#include "job_manifest.h"
+#include "offline_sdf_renderer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Runs the jobs of a job file one after another on a single Vulkan
+// device. The instance, device, slot render pass and vertex module are
+// created once; the next job's fragment shader compiles on a worker
+// thread while the current job renders, so a job only waits for its
+// pipeline, ring and encoder.
+namespace batch_render {
+struct JobResult {
+    std::string name;
+    uint32_t frames = 0;
+    uint64_t pixelsPerFrame = 0;
+    // Setup + render + encode, excluding the shader compile.
+    double seconds = 0.0;
+    // Time spent waiting for the job's shader compile after the previous
+    // job finished; near zero when the compile was hidden by rendering.
+    double compileWaitSeconds = 0.0;
+    // Empty on success.
+    std::string error;
+};
+
+// `base` supplies everything a job doesn't set (ring, batching, blur,
+// ssaa, frame layers...); each job overrides its size, frame count and
+// encode settings (read with the command line's as defaults, see
+// job_manifest::readJobFile). A job that fails (shader compile, setup,
+// render or encode) gets its error in the result and the batch moves on;
+// only a lost device stops it, by throwing VulkanDeviceLost. Logs the
+// per-job and total throughput and returns one result per job.
+[[nodiscard]] std::vector<JobResult>
+runJobs(const std::vector<job_manifest::Job> &jobs,
+        const OfflineRenderOptions &base);
+} // namespace batch_render
+
+#endif // BATCH_RENDER_H
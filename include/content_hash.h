@@ -0,0 +1,24 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <cstdint>
+#include <string_view>
+
+namespace content_hash {
+inline constexpr uint64_t FNV1A_OFFSET = 0xcbf29ce484222325ull;
+
+// 64-bit FNV-1a of `bytes`, for content keys (SPIR-V cache entries,
+// checkpoint shader hashes); not meant to resist deliberate collisions.
+// Pass the previous result as `hash` to continue over data read in
+// pieces.
+[[nodiscard]] constexpr uint64_t
+fnv1a(std::string_view bytes, uint64_t hash = FNV1A_OFFSET) noexcept {
+    for (const char byte : bytes) {
+        hash ^= static_cast<uint8_t>(byte);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+} // namespace content_hash
+
+#endif // CONTENT_HASH_H
@@ -0,0 +1,43 @@
+#ifndef DEFERRED_DESTROY_QUEUE_H
+#define DEFERRED_DESTROY_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// Defers destroying GPU objects until the frames that may still use them
+// have finished, so they can be replaced without vkDeviceWaitIdle. Frames
+// are identified by a submit serial that increases by one per queue
+// submission; the owner tracks which serial each frame fence guards and
+// reports the newest serial known complete (submissions on one queue
+// complete in order).
+class DeferredDestroyQueue {
+  public:
+    DeferredDestroyQueue() = default;
+    DeferredDestroyQueue(const DeferredDestroyQueue &) = delete;
+    DeferredDestroyQueue &operator=(const DeferredDestroyQueue &) = delete;
+
+    // `destroy` runs once every submission up to and including
+    // lastUseSerial has completed.
+    void retire(uint64_t lastUseSerial, std::function<void()> destroy);
+
+    // Runs the destructors of everything retired at or before
+    // completedSerial. Returns how many ran.
+    size_t collect(uint64_t completedSerial);
+
+    // Runs everything left; the device must be idle.
+    void flush();
+
+    [[nodiscard]] size_t size() const noexcept { return pending.size(); }
+
+  private:
+    struct Retired {
+        uint64_t lastUseSerial;
+        std::function<void()> destroy;
+    };
+    // Ordered by lastUseSerial, since serials only grow.
+    std::deque<Retired> pending;
+};
+
+#endif // DEFERRED_DESTROY_QUEUE_H
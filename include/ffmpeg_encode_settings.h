@@ -4,12 +4,36 @@
 #include <string>
 
 namespace ffmpeg_utils {
+enum class MuxMode {
+    // Whatever the output extension implies; MP4 writes its index (moov)
+    // only when the render finishes.
+    Standard,
+    // MP4 with an empty moov up front and a fragment per GOP, so the file
+    // plays up to the last flushed fragment while rendering or if killed.
+    Fragmented,
+    // HLS playlist (.m3u8) listing each segment as it completes.
+    HLS,
+    // Standalone numbered files from a pattern such as out_%05d.mp4, each
+    // finalized when the next one starts.
+    Segments,
+};
+
 struct EncodeSettings {
     std::string outputPath;
     std::string codec = "libx264";
     int fps = 30;
     int crf = 20;
     std::string preset = "slow";
+    // Threads for RGB -> YUV conversion, each converting one horizontal
+    // slice of the frame. 0 picks a count from the available cores.
+    int convertThreads = 0;
+    // Keep every GOP self-contained so the output can be joined with
+    // neighbouring segments by stream copy (sharded renders).
+    bool closedGop = false;
+    MuxMode mux = MuxMode::Standard;
+    // GOP length, and so the fragment/segment length for the non-standard
+    // mux modes (every fragment starts on a keyframe).
+    float segmentSeconds = 1.0f;
 };
 } // namespace ffmpeg_utils
 
@@ -2,14 +2,15 @@
 #define FFMPEG_ENCODER_H
 
 #include "ffmpeg_encode_settings.h"
+#include "frame_converter.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
-#include <libswscale/swscale.h>
 }
 
 #include <cstdint>
+#include <memory>
 
 namespace ffmpeg_utils {
 class FfmpegEncoder {
@@ -22,12 +23,25 @@ class FfmpegEncoder {
     FfmpegEncoder(FfmpegEncoder &&) = delete;
     FfmpegEncoder &operator=(FfmpegEncoder &&) = delete;
 
+    // Time spent in each step of the last encodeFrame call.
+    struct FrameTimings {
+        double convertMs = 0.0;
+        double sendMs = 0.0;
+        double receiveMs = 0.0;
+        double muxMs = 0.0;
+    };
+
     void open();
     void encodeFrame(const uint8_t *srcData, int64_t frameIndex);
     void flush();
     void close() noexcept;
 
+    [[nodiscard]] const FrameTimings &lastFrameTimings() const noexcept {
+        return frameTimings;
+    }
+
   private:
+    void sendFrame(AVFrame *frame);
     void writePacket(AVPacket *packet);
 
     const EncodeSettings settings;
@@ -39,10 +53,19 @@ class FfmpegEncoder {
     AVFormatContext *formatContext = nullptr;
     AVCodecContext *codecContext = nullptr;
     AVStream *stream = nullptr;
-    SwsContext *swsContext = nullptr;
+    std::unique_ptr<FrameConverter> converter;
     AVFrame *dstFrame = nullptr;
     AVFrame *srcFrame = nullptr;
     AVPacket *packet = nullptr;
+    // Source is already in the encoder's pixel format; skip swscale.
+    bool passthrough = false;
+    // Passthrough frames wrap the caller's buffer instead of copying it.
+    // The caller reuses the buffer, so this is only turned on once the
+    // first (copied) frame shows the encoder drops its input references.
+    bool zeroCopy = false;
+    bool zeroCopyProbed = false;
+    size_t srcFrameBytes = 0;
+    FrameTimings frameTimings;
     bool opened = false;
 };
 } // namespace ffmpeg_utils
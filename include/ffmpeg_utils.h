@@ -2,9 +2,17 @@
 #define FFMPEG_UTILS_H
 
 #include <string>
+#include <vector>
 
 namespace ffmpeg_utils {
 std::string getLibavformatVersion();
+
+// Joins single-stream video segments end to end into outputPath by stream
+// copy (no re-encode). Each segment's timestamps are shifted to start where
+// the previous one ended, so segments must share codec parameters and
+// start on a keyframe (closed GOP).
+void concatSegments(const std::vector<std::string> &segmentPaths,
+                    const std::string &outputPath);
 } // namespace ffmpeg_utils
 
 #endif // FFMPEG_UTILS_H
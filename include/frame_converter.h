@@ -0,0 +1,34 @@
+#ifndef FRAME_CONVERTER_H
+#define FRAME_CONVERTER_H
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+#include <libswscale/swscale.h>
+}
+
+namespace ffmpeg_utils {
+// Pixel format conversion between two frames of the same size. With more
+// than one thread swscale splits the output into slices converted in
+// parallel; each slice reads the whole source, so the result is the same
+// for any thread count.
+class FrameConverter {
+  public:
+    FrameConverter(int width, int height, AVPixelFormat srcFormat,
+                   AVPixelFormat dstFormat, int threads);
+    ~FrameConverter();
+    FrameConverter(const FrameConverter &) = delete;
+    FrameConverter &operator=(const FrameConverter &) = delete;
+    FrameConverter(FrameConverter &&) = delete;
+    FrameConverter &operator=(FrameConverter &&) = delete;
+
+    // dst must be allocated and writable. A src without buffer references
+    // is copied by swscale first, so wrap borrowed memory in a buffer.
+    void convert(const AVFrame *src, AVFrame *dst);
+
+  private:
+    SwsContext *swsContext = nullptr;
+};
+} // namespace ffmpeg_utils
+
+#endif // FRAME_CONVERTER_H
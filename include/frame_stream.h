@@ -0,0 +1,59 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Streams finished offline frames to stdout, a named pipe or a file for an
+// external ffmpeg/gstreamer graph, skipping libav muxing entirely. Writes
+// block, so a slow reader stalls the ring instead of buffering frames.
+namespace frame_stream {
+enum class Format {
+    // YUV4MPEG2 with 4:2:0 planes from the GPU YUV420P conversion.
+    Y4M,
+    // Frames exactly as read back (BGRA/RGBA or YUV planes), no framing.
+    Raw,
+};
+
+[[nodiscard]] std::optional<Format> parseFormat(std::string_view name);
+
+// Y4M stream header. Chroma is the GPU conversion's 2x2 average (centered,
+// "420jpeg") in BT.601 limited range.
+[[nodiscard]] std::string y4mHeader(uint32_t width, uint32_t height, int fps);
+
+struct Settings {
+    // "-" writes to stdout.
+    std::string path;
+    Format format = Format::Y4M;
+};
+
+class FrameStreamWriter {
+  public:
+    // Opens the output (blocking until a FIFO has a reader) and writes the
+    // stream header. Writes only throw on a closed reader if the process
+    // ignores SIGPIPE; main does that for streaming.
+    FrameStreamWriter(const Settings &settings, uint32_t width,
+                      uint32_t height, int fps);
+    ~FrameStreamWriter();
+    FrameStreamWriter(const FrameStreamWriter &) = delete;
+    FrameStreamWriter &operator=(const FrameStreamWriter &) = delete;
+
+    // Writes one frame straight from data (e.g. a mapped staging buffer)
+    // with a single vectored write for the frame marker and pixels.
+    // Throws if the reader went away.
+    void writeFrame(const uint8_t *data, size_t size);
+
+  private:
+    void writeAll(const uint8_t *header, size_t headerSize,
+                  const uint8_t *data, size_t size);
+
+    int fd = -1;
+    bool ownsFd = false;
+    const Format format;
+};
+} // namespace frame_stream
+
+#endif // FRAME_STREAM_H
@@ -0,0 +1,102 @@
+#ifndef IMAGE_SEQUENCE_H
+#define IMAGE_SEQUENCE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Offline output as one image file per frame instead of a video. Frames
+// are copied out of the ring slot and compressed/written on a pool of
+// worker threads, with a fixed number of frame buffers bounding memory.
+namespace image_sequence {
+enum class Format {
+    PNG,
+    QOI,
+    // Tightly packed RGBA8 rows, no header.
+    Raw,
+};
+
+[[nodiscard]] std::optional<Format> parseFormat(std::string_view name);
+[[nodiscard]] std::string_view extension(Format format);
+
+// Numbered file for a frame: dir/frame_000042.png
+[[nodiscard]] std::filesystem::path
+framePath(const std::filesystem::path &outputDir, uint32_t frameIndex,
+          Format format);
+
+// Encode tightly packed RGBA8 pixels, replacing the contents of out.
+void encodePNG(const uint8_t *rgba, uint32_t width, uint32_t height,
+               std::vector<uint8_t> &out);
+void encodeQOI(const uint8_t *rgba, uint32_t width, uint32_t height,
+               std::vector<uint8_t> &out);
+
+struct Settings {
+    std::filesystem::path outputDir;
+    Format format = Format::PNG;
+    // Compression threads; 0 picks one per core.
+    uint32_t threads = 0;
+    // Frames copied out but not yet written; write() blocks past this.
+    // 0 means two per thread.
+    uint32_t maxInFlight = 0;
+};
+
+class ImageSequenceWriter {
+  public:
+    // bgra: source pixels are BGRA and get swizzled to RGBA.
+    ImageSequenceWriter(Settings writerSettings, uint32_t frameWidth,
+                        uint32_t frameHeight, bool bgra);
+    ~ImageSequenceWriter();
+    ImageSequenceWriter(const ImageSequenceWriter &) = delete;
+    ImageSequenceWriter &operator=(const ImageSequenceWriter &) = delete;
+
+    // Copies a frame (stride bytes per row, 4 bytes per pixel) and queues
+    // it for writing. Blocks while maxInFlight frames are pending, so a
+    // slow disk stalls the caller rather than growing memory. Rethrows
+    // the first error from a worker.
+    void write(const uint8_t *src, uint32_t stride, uint32_t frameIndex);
+    // Waits until every queued frame is on disk; rethrows worker errors.
+    void finish();
+
+    [[nodiscard]] size_t threadCount() const noexcept {
+        return workers.size();
+    }
+
+  private:
+    struct Job {
+        size_t buffer = 0;
+        uint32_t frameIndex = 0;
+    };
+
+    void workerLoop();
+    void writeFrame(std::vector<uint8_t> &pixels, uint32_t frameIndex,
+                    std::vector<uint8_t> &encoded) const;
+    void rethrowError();
+
+    const Settings settings;
+    const uint32_t width;
+    const uint32_t height;
+    const bool swapRB;
+
+    std::vector<std::vector<uint8_t>> buffers;
+    std::vector<size_t> freeBuffers;
+    std::deque<Job> jobs;
+    size_t busyJobs = 0;
+    std::exception_ptr error;
+    bool stopping = false;
+    std::mutex mutex;
+    // Signalled when a job is queued (workers) or a buffer is released
+    // (writer).
+    std::condition_variable jobCv;
+    std::condition_variable bufferCv;
+    std::vector<std::thread> workers;
+};
+} // namespace image_sequence
+
+#endif // IMAGE_SEQUENCE_H
@@ -0,0 +1,58 @@
+#ifndef JOB_MANIFEST_H
+#define JOB_MANIFEST_H
+
+#include "ffmpeg_encode_settings.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <string>
+#include <vector>
+
+// Job files for batch offline renders: many shaders rendered back to back
+// by one process so the Vulkan device and the job-independent objects are
+// created once.
+//
+// The format is a small TOML subset:
+//
+//   # defaults for every job
+//   width = 1920
+//   height = 1080
+//   codec = "libx265"
+//
+//   [[job]]
+//   shader = "shaders/a.frag"
+//   frames = 300
+//   output = "out/a.mp4"
+//
+// Keys before the first [[job]] are defaults, each [[job]] table is one
+// job. Values are "strings", integers or true/false; # starts a comment.
+namespace job_manifest {
+struct Job {
+    // Shown in the report; the shader's file name unless set.
+    std::string name;
+    std::filesystem::path shader;
+    bool toy = false;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    uint32_t frames = 0;
+    ffmpeg_utils::EncodeSettings encode;
+};
+
+// Relative shader and output paths resolve against baseDir. sourceName
+// prefixes error messages ("jobs.toml:12: ..."). Every job's encode
+// settings start from encodeDefaults (the command line's), then the
+// file's defaults and the job's own keys. Throws std::runtime_error on a
+// syntax error, an unknown key or a job missing its shader, output or
+// frame count.
+[[nodiscard]] std::vector<Job>
+parseJobs(std::istream &in, const std::filesystem::path &baseDir,
+          const std::string &sourceName,
+          const ffmpeg_utils::EncodeSettings &encodeDefaults = {});
+// Paths resolve against the job file's directory.
+[[nodiscard]] std::vector<Job>
+readJobFile(const std::filesystem::path &path,
+            const ffmpeg_utils::EncodeSettings &encodeDefaults = {});
+} // namespace job_manifest
+
+#endif // JOB_MANIFEST_H
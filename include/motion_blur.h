@@ -0,0 +1,30 @@
+#ifndef MOTION_BLUR_H
+#define MOTION_BLUR_H
+
+#include <cstdint>
+
+namespace motion_blur {
+// Shutter offset, in frames, of sub-frame `sample` out of `samples` for
+// output frame `frame`. The open shutter [0, shutter) is split into one
+// stratum per sample and each sample is jittered inside its stratum by a
+// hash of (frame, sample), so the pattern doesn't repeat every frame and
+// turn into visible banding. Deterministic, so re-renders and shards match.
+[[nodiscard]] inline float subframeOffset(uint32_t frame, uint32_t sample,
+                                          uint32_t samples,
+                                          float shutter) noexcept {
+    if (samples <= 1)
+        return 0.0f;
+    uint32_t h = frame * 0x9e3779b1u ^ (sample + 1u) * 0x85ebca77u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    // Top 24 bits -> [0, 1), exact in a float.
+    const float jitter = static_cast<float>(h >> 8) * (1.0f / 16777216.0f);
+    return shutter * (static_cast<float>(sample) + jitter) /
+           static_cast<float>(samples);
+}
+} // namespace motion_blur
+
+#endif // MOTION_BLUR_H
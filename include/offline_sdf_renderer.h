@@ -3,27 +3,164 @@
 #include "sdf_renderer.h"
 #include "ffmpeg_encode_settings.h"
 #include "ffmpeg_encoder.h"
+#include "frame_stream.h"
+#include "image_sequence.h"
+#include "render_checkpoint.h"
+#include "ring_depth_controller.h"
+#include "spsc_ring.h"
+#include "stage_profiler.h"
 #include "vkutils.h"
-#include <condition_variable>
-#include <deque>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
 #include <memory>
-#include <mutex>
 #include <optional>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 inline constexpr uint32_t OFFSCREEN_DEFAULT_WIDTH = 1280;
 inline constexpr uint32_t OFFSCREEN_DEFAULT_HEIGHT = 720;
 inline constexpr uint32_t OFFSCREEN_DEFAULT_RING_SIZE = 2;
+// ringSize value that lets the renderer size the ring at runtime.
+inline constexpr uint32_t OFFSCREEN_AUTO_RING_SIZE = 0;
+// Upper bound on ring slots; slots are allocated at runtime so this is
+// only a sanity limit, not an array size.
+inline constexpr uint32_t OFFSCREEN_MAX_RING_SIZE = 64;
+// Auto mode never lets ring slots (image + staging buffer) exceed this.
+inline constexpr uint64_t OFFSCREEN_DEFAULT_RING_MEMORY_BUDGET =
+    512ull * 1024 * 1024;
+// Frames per checkpoint segment when --resume is used without an explicit
+// segment length.
+inline constexpr uint32_t OFFSCREEN_DEFAULT_CHECKPOINT_FRAMES = 300;
+// Motion blur sub-frames per output frame; 1 disables accumulation.
+inline constexpr uint32_t OFFSCREEN_MAX_MOTION_BLUR_SAMPLES = 256;
+// Fraction of the frame interval the shutter is open (0.5 = 180 degrees).
+inline constexpr float OFFSCREEN_DEFAULT_SHUTTER = 0.5f;
+// Supersampling factor per axis; 1 renders at the output resolution.
+inline constexpr uint32_t OFFSCREEN_MAX_SSAA = 8;
+// Consecutive frames rendered per draw into the layers of a slot's array
+// image; 1 renders one frame per slot.
+inline constexpr uint32_t OFFSCREEN_MAX_FRAME_LAYERS = 64;
+
+// Optional color conversion done on the GPU before readback so only the
+// YUV planes (1.5 bytes/pixel) get copied back instead of BGRA8.
+enum class GpuColorConversion {
+    None,
+    YUV420P,
+    NV12,
+};
+
+// The job-independent Vulkan state of an offline render: instance, device,
+// queue, the slot render pass and the fullscreen quad vertex module.
+// Batch renders share one across their OfflineSDFRenderers so each job
+// only builds its own ring and pipeline; a renderer without one creates
+// and destroys its own.
+class OfflineVulkanContext {
+  public:
+    // A shader's pipeline kept alive across renders (see
+    // OfflineRenderOptions::pipelineKey). Viewport and scissor are dynamic,
+    // so one pipeline serves every output size.
+    struct WarmPipeline {
+        VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        bool frameInputsInBuffer = false;
+        uint64_t lastUsed = 0;
+    };
+
+    OfflineVulkanContext();
+    ~OfflineVulkanContext();
+    OfflineVulkanContext(const OfflineVulkanContext &) = delete;
+    OfflineVulkanContext &operator=(const OfflineVulkanContext &) = delete;
+
+    [[nodiscard]] const WarmPipeline *findPipeline(const std::string &key);
+    void addPipeline(const std::string &key, const WarmPipeline &pipeline);
+    // Destroys the least recently used pipelines past `keep`. No render
+    // may be using them.
+    void trimPipelines(size_t keep);
+    [[nodiscard]] size_t pipelineCount() const noexcept {
+        return pipelines.size();
+    }
+
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties deviceProperties{};
+    uint32_t graphicsQueueIndex = 0;
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    // Saved back to the per-device cache file when the context goes away.
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    // Single-layer variant; layered renderers compile their own.
+    VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+    // Frame-input set layout and the pipeline layout over it; identical
+    // for every renderer, so warm pipelines stay compatible.
+    VkDescriptorSetLayout frameInputSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+
+  private:
+    std::unordered_map<std::string, WarmPipeline> pipelines;
+    uint64_t useCounter = 0;
+};
 
 struct OfflineRenderOptions {
+    // Renders frames [frameStart, maxFrames). iTime/iFrame use the absolute
+    // frame number, while the encoded output's timestamps start at 0.
+    uint32_t frameStart = 0;
     uint32_t maxFrames = 1;
     std::optional<std::filesystem::path> debugDumpPPMDir = std::nullopt;
     uint32_t width = OFFSCREEN_DEFAULT_WIDTH;
     uint32_t height = OFFSCREEN_DEFAULT_HEIGHT;
     uint32_t ringSize = OFFSCREEN_DEFAULT_RING_SIZE;
+    uint64_t ringMemoryBudget = OFFSCREEN_DEFAULT_RING_MEMORY_BUDGET;
+    // Ring slots (frames, or tiles when tiling) recorded and sent per
+    // vkQueueSubmit. 0 sends whatever slots are free at the time; N waits
+    // until N are free, capped at the ring depth.
+    uint32_t submitBatch = 0;
+    // Render each frame as a grid of tileSize x tileSize tiles. 0 renders
+    // whole frames unless they exceed the device's maxImageDimension2D.
+    uint32_t tileSize = 0;
+    // Render motionBlurSamples sub-frames per output frame at jittered
+    // times across the open shutter and average them on the GPU.
+    uint32_t motionBlurSamples = 1;
+    float shutter = OFFSCREEN_DEFAULT_SHUTTER;
+    // Render at ssaa x the width and height and box-filter down to the
+    // output size on the GPU; only output-sized frames are read back.
+    uint32_t ssaa = 1;
+    // Render frameLayers consecutive frames into the layers of one array
+    // image with a single instanced draw and read them back with one copy.
+    // Cuts per-frame fixed costs for cheap shaders at small sizes; can't
+    // be combined with tiling, motion blur, ssaa or GPU color conversion.
+    uint32_t frameLayers = 1;
+    GpuColorConversion gpuColorConversion = GpuColorConversion::None;
     ffmpeg_utils::EncodeSettings encodeSettings = {};
+    // Write the output as checkpointed segments of checkpoint->segmentFrames
+    // frames, continuing the manifest's segments (frameStart should be its
+    // nextFrame). The segments are joined into the output at the end.
+    std::optional<render_checkpoint::Manifest> checkpoint = std::nullopt;
+    // Write numbered image files instead of a video; encodeSettings then
+    // only provides the fps that iTime advances by.
+    std::optional<image_sequence::Settings> imageSequence = std::nullopt;
+    // Stream frames to stdout or a pipe instead of muxing a video; as with
+    // imageSequence, encodeSettings only provides the fps.
+    std::optional<frame_stream::Settings> frameStream = std::nullopt;
+    // Write the per-frame stage profile here (.csv, otherwise JSON).
+    std::optional<std::filesystem::path> profileOutput = std::nullopt;
+    // Render on this context's device instead of creating one.
+    std::shared_ptr<OfflineVulkanContext> vulkanContext = nullptr;
+    // Fragment shader already compiled by OfflineSDFRenderer::
+    // compileFragment (for the same frameLayers), so a batch can compile
+    // the next job while this one renders.
+    std::optional<std::vector<uint32_t>> fragSpirv = std::nullopt;
+    // With vulkanContext: keep the pipeline in the context under this key
+    // (the shader's hash and template) and reuse it on later renders with
+    // the same key, skipping the compile. Only whole-frame renders without
+    // motion blur, ssaa or layers use it.
+    std::string pipelineKey;
+    // iTime of each frame in seconds instead of frame / fps; needs
+    // frameStart 0 and maxFrames == frameTimes.size().
+    std::vector<float> frameTimes;
 };
 
 // Offline SDF Renderer
@@ -35,11 +172,24 @@ class OfflineSDFRenderer : public SDFRenderer {
         VkDeviceMemory imageMemory = VK_NULL_HANDLE;
         VkImageView imageView = VK_NULL_HANDLE;
         VkFramebuffer framebuffer = VK_NULL_HANDLE;
-        vkutils::ReadbackBuffer stagingBuffer{};
+        // Motion blur accumulation / supersampled render target, resolved
+        // into image each frame.
+        VkImage intermediateImage = VK_NULL_HANDLE;
+        VkDeviceMemory intermediateImageMemory = VK_NULL_HANDLE;
+        VkImageView intermediateImageView = VK_NULL_HANDLE;
+        VkFramebuffer intermediateFramebuffer = VK_NULL_HANDLE;
+        VkDescriptorSet downsampleDescriptorSet = VK_NULL_HANDLE;
+        vkutils::HostBuffer stagingBuffer{};
+        VkDescriptorSet convertDescriptorSet = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        // Tile extent commandBuffer was last recorded for; zero when it
+        // has to be (re-)recorded before the next submit.
+        VkExtent2D recordedExtent{};
+        // image is still UNDEFINED; the next recording transitions it.
+        bool needsInitialLayout = false;
         void *mappedData = nullptr;
         uint32_t rowStride = 0;
         bool pendingReadback = false;
-        bool pendingEncode = false;
     };
 
     // Render Context
@@ -50,43 +200,255 @@ class OfflineSDFRenderer : public SDFRenderer {
     // Ring buffer timing intuition:
     //  - 1 slot: total ≈ N * (render + readback) (no overlap).
     //  - K >= 2: total ≈ (render + readback) + (N - 1) * max(render, readback).
-    const uint32_t ringSize = OFFSCREEN_DEFAULT_RING_SIZE;
-    std::array<RingSlot, MAX_FRAME_SLOTS> ringSlots;
+    // ringSlots is sized to maxRingSize once and never reallocated (the
+    // encoder thread indexes it); only ringSize slots hold live resources.
+    // In auto mode the render loop grows/shrinks ringSize towards
+    // targetRingSize, which the encoder thread updates from measurements.
+    const bool adaptiveRing = false;
+    const uint64_t ringMemoryBudget;
+    uint32_t maxRingSize = 0;
+    uint32_t ringSize = OFFSCREEN_DEFAULT_RING_SIZE;
+    std::vector<RingSlot> ringSlots;
+    std::vector<uint32_t> retiredSlots;
+    std::atomic<uint32_t> targetRingSize{OFFSCREEN_DEFAULT_RING_SIZE};
+    std::optional<RingDepthController> ringController;
+    const uint32_t frameStart;
     const uint32_t maxFrames;
+    const uint32_t submitBatch;
+
+    // Timestamps per slot: frame start, render pass done, readback done.
+    static constexpr uint32_t QUERIES_PER_SLOT = 3;
+    float timestampPeriodNs = 0.0f;
+
+    // Time spent per stage, for the end-of-render summary. Render-side
+    // fields are only touched by the render thread, the rest only by the
+    // encoder thread.
+    struct StageTimes {
+        std::chrono::nanoseconds renderWaitForSlot{};
+        std::chrono::nanoseconds encoderWaitForFrame{};
+        std::chrono::nanoseconds encoderWaitForGpu{};
+        std::chrono::nanoseconds encode{};
+        double gpuRenderMs = 0.0;
+        double gpuReadbackMs = 0.0;
+        uint64_t frames = 0;
+        uint64_t submits = 0;
+        uint64_t submittedSlots = 0;
+    };
+    StageTimes stageTimes;
+    // Per-frame stage timings, summarised when encoding stops. Tiles of a
+    // frame add up into pendingSample until its last tile is out.
+    StageProfiler profiler;
+    StageProfiler::Sample pendingSample;
+    std::chrono::steady_clock::time_point encodeStartTime{};
+    // Reused by submitFrames so a submit doesn't allocate.
+    std::vector<uint64_t> submitSignalValues;
+    std::vector<VkTimelineSemaphoreSubmitInfo> submitTimelineInfos;
+    std::vector<VkSubmitInfo> submitInfos;
+
+    // Tiled rendering: slots hold one renderExtent-sized tile, so GPU and
+    // staging memory scale with the tile, not the output. The encoder
+    // thread stitches tiles into stitchedFrame and encodes it after the
+    // frame's last tile. Untiled renders are a single full-frame tile.
+    const uint32_t requestedTileSize = 0;
+    VkExtent2D renderExtent{};
+    uint32_t tilesX = 1;
+    uint32_t tilesY = 1;
+    std::vector<uint8_t> stitchedFrame;
+    [[nodiscard]] uint32_t tileCount() const noexcept {
+        return tilesX * tilesY;
+    }
+    [[nodiscard]] VkRect2D tileRect(uint32_t tileIndex) const noexcept;
+    void resolveTiling();
+
+    // Frame completion tracking: one timeline semaphore for the whole ring.
+    // Its value is the number of tiles the GPU has finished, so tile T of
+    // frame N signals N * tileCount + T + 1 and the encoder waits for that.
+    VkSemaphore frameTimeline = VK_NULL_HANDLE;
+    [[nodiscard]] uint64_t tileDoneValue(uint32_t frameIndex,
+                                         uint32_t tileIndex) const noexcept {
+        return static_cast<uint64_t>(frameIndex) * tileCount() + tileIndex +
+               1;
+    }
+
+    // Motion blur: every sub-frame is blended into the slot's float
+    // intermediate image with weight 1/K, then one blit resolves it into
+    // the slot image. Readback and encode still see a single frame.
+    const uint32_t motionBlurSamples = 1;
+    const float shutter = OFFSCREEN_DEFAULT_SHUTTER;
+    static constexpr VkFormat ACCUM_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+    // Half floats carry 11 bits, so past this many 1/K-weighted adds the
+    // rounding drift reaches an 8-bit output step; blend in fp32 instead.
+    static constexpr uint32_t ACCUM_HALF_MAX_SAMPLES = 16;
+    static constexpr VkFormat ACCUM_FORMAT_WIDE =
+        VK_FORMAT_R32G32B32A32_SFLOAT;
+    [[nodiscard]] bool accumulating() const noexcept {
+        return motionBlurSamples > 1;
+    }
+
+    // Supersampling: the intermediate image is ssaa x renderExtent and a
+    // fullscreen box-filter pass (instead of the blit) writes the slot
+    // image, so readback and staging memory stay at the output size.
+    const uint32_t ssaa = 1;
+    VkSampler downsampleSampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout downsampleDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool downsampleDescriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout downsamplePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline downsamplePipeline = VK_NULL_HANDLE;
+    VkShaderModule downsampleShaderModule = VK_NULL_HANDLE;
+    [[nodiscard]] bool supersampling() const noexcept { return ssaa > 1; }
+
+    // Layered frames: slot images are frameLayers-layer arrays, every
+    // instance of the fullscreen draw is routed to its own layer and reads
+    // its own frame inputs, and the staging buffer holds the layers back
+    // to back. The encoder thread outputs them in order.
+    const uint32_t frameLayers = 1;
+    [[nodiscard]] bool layered() const noexcept { return frameLayers > 1; }
+
+    // With either feature the shader draws into the intermediate image
+    // (intermediateRenderPass) rather than straight into the slot image.
+    VkFormat intermediateFormat = VK_FORMAT_UNDEFINED;
+    VkRenderPass intermediateRenderPass = VK_NULL_HANDLE;
+    [[nodiscard]] bool usesIntermediate() const noexcept {
+        return accumulating() || supersampling();
+    }
+    [[nodiscard]] VkExtent2D scaled(VkExtent2D extent) const noexcept {
+        return {extent.width * ssaa, extent.height * ssaa};
+    }
+
+    // Per-frame shader inputs (iTime, iFrame, tile offset...) live in a
+    // persistently mapped uniform buffer, one entry per slot and motion
+    // blur sub-frame, bound with a dynamic offset. A slot's command buffer
+    // then only depends on its tile extent, so it is recorded once and
+    // resubmitted. Shaders that still declare push constants fall back to
+    // recording every frame.
+    bool frameInputsInBuffer = false;
+    VkDescriptorSetLayout frameInputSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool frameInputPool = VK_NULL_HANDLE;
+    VkDescriptorSet frameInputSet = VK_NULL_HANDLE;
+    vkutils::HostBuffer frameInputBuffer{};
+    uint8_t *frameInputData = nullptr;
+    VkDeviceSize frameInputStride = 0;
+    [[nodiscard]] uint32_t frameInputOffset(uint32_t slotIndex,
+                                            uint32_t sample) const noexcept {
+        return static_cast<uint32_t>(
+            (static_cast<VkDeviceSize>(slotIndex) * motionBlurSamples +
+             sample) *
+            frameInputStride);
+    }
+
+    // GPU color conversion (RGBA -> YUV420P/NV12 compute pass)
+    const GpuColorConversion gpuColorConversion = GpuColorConversion::None;
+    VkSampler convertSampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout convertDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool convertDescriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout convertPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline convertPipeline = VK_NULL_HANDLE;
+    VkShaderModule convertShaderModule = VK_NULL_HANDLE;
 
     static uint32_t validateRingSize(uint32_t value);
+    [[nodiscard]] uint32_t computeMaxRingSize() const;
+    static GpuColorConversion
+    validateGpuColorConversion(GpuColorConversion conversion, uint32_t width,
+                               uint32_t height);
 
     void vulkanSetup();
     void setupRenderContext();
+    void setupColorConversion();
+    void setupFrameInputs();
     void createPipeline();
-    void createCommandBuffers();
+    void createRingSlot(uint32_t slotIndex);
+    void setupSupersampling();
+    void createIntermediateTarget(RingSlot &slot);
+    void destroyRingSlot(RingSlot &slot);
+    void writeConvertDescriptorSet(const RingSlot &slot);
     void destroyRenderContext();
+    void destroyColorConversion();
+    void destroySupersampling();
+    void destroyFrameInputs();
     void destroyPipeline();
     void destroy();
 
-    void recordCommandBuffer(uint32_t slotIndex, uint32_t currentFrame);
-    [[nodiscard]] PPMDebugFrame debugReadbackOffscreenImage(const RingSlot &slot);
-    [[nodiscard]] vkutils::PushConstants
-    getPushConstants(uint32_t currentFrame) noexcept;
-
+    [[nodiscard]] VkDeviceSize readbackBytes() const noexcept;
+    [[nodiscard]] vkutils::YuvConvertPushConstants
+    getConvertPushConstants() const noexcept;
     struct EncodeItem {
         uint32_t slotIndex = 0;
         uint32_t frameIndex = 0;
+        uint32_t tileIndex = 0;
+        // Frames in the slot's layers, starting at frameIndex; 1 unless
+        // layered (and fewer than frameLayers for the last slot).
+        uint32_t frameCount = 1;
+        std::chrono::steady_clock::time_point submitted{};
+        // CPU time recording this item's command buffer, and its share of
+        // the vkQueueSubmit it went out in.
+        double recordMs = 0.0;
+        double submitMs = 0.0;
     };
 
+    void writeFrameInputs(const EncodeItem &item);
+    void recordCommandBuffer(const EncodeItem &item);
+    void recordReadbackCopy(VkCommandBuffer commandBuffer, const RingSlot &slot,
+                            VkExtent2D extent);
+    void recordColorConversion(VkCommandBuffer commandBuffer,
+                               const RingSlot &slot);
+    void recordAccumResolve(VkCommandBuffer commandBuffer, const RingSlot &slot,
+                            VkExtent2D extent);
+    void recordDownsample(VkCommandBuffer commandBuffer, const RingSlot &slot,
+                          VkExtent2D extent);
+    [[nodiscard]] PPMDebugFrame
+    debugReadbackOffscreenImage(const uint8_t *data) const;
+    void stitchTile(const RingSlot &slot, uint32_t tileIndex);
+    void outputFrame(const uint8_t *src, uint32_t frameIndex);
+    [[nodiscard]] vkutils::PushConstants
+    getPushConstants(uint32_t currentFrame, VkOffset2D tileOffset,
+                     float frameOffset = 0.0f) noexcept;
+
     ffmpeg_utils::EncodeSettings encodeSettings;
     std::unique_ptr<ffmpeg_utils::FfmpegEncoder> encoder;
+    AVPixelFormat encoderSrcFormat = AV_PIX_FMT_NONE;
+    int encoderSrcStride = 0;
+    // First frame of the file the encoder is writing; its PTS 0.
+    uint32_t encoderFirstFrame = 0;
     std::thread encoderThread;
-    std::mutex encodeMutex;
-    std::condition_variable encodeCv;
-    std::deque<EncodeItem> encodeQueue;
-    bool encodeStop = false;
-    bool encodeFailed = false;
+    // Checkpointed output; only touched by the encoder thread while
+    // encoding.
+    std::optional<render_checkpoint::Manifest> checkpoint;
+    // Image sequence output, used in place of encoder when set.
+    std::optional<image_sequence::Settings> imageSequence;
+    std::unique_ptr<image_sequence::ImageSequenceWriter> imageWriter;
+    // Streamed output, also used in place of encoder. Frames are written
+    // straight from the slot, so a blocked pipe holds the slot.
+    std::optional<frame_stream::Settings> frameStream;
+    std::unique_ptr<frame_stream::FrameStreamWriter> streamWriter;
+    size_t streamFrameBytes = 0;
+    std::optional<std::filesystem::path> profileOutput;
+    // Shared device state (batch renders); null when this renderer owns
+    // its instance, device, render pass and vertex module.
+    std::shared_ptr<OfflineVulkanContext> vulkanContext;
+    std::optional<std::vector<uint32_t>> precompiledFragSpirv;
+    const std::string pipelineKey;
+    // False when pipeline and fragShaderModule belong to vulkanContext.
+    bool ownsPipeline = true;
+    const std::vector<float> frameTimes;
+    // Render <-> encoder handoff, one lock-free SPSC ring per direction:
+    // freeSlots carries slot indices the encoder is done with back to the
+    // render loop, readyFrames carries submitted frames to the encoder.
+    std::unique_ptr<SpscRing<uint32_t>> freeSlots;
+    std::unique_ptr<SpscRing<EncodeItem>> readyFrames;
+    std::atomic<bool> encodeFailed{false};
 
     void startEncoding();
+    void openEncoder(uint32_t firstFrame);
+    void checkpointSegment(uint32_t nextFrame);
     void stopEncoding();
-    void enqueueEncode(uint32_t slotIndex, uint32_t frameIndex);
-    void waitForSlotEncode(uint32_t slotIndex);
+    [[nodiscard]] uint32_t acquireFreeSlot();
+    [[nodiscard]] uint32_t waitFreeSlot();
+    [[nodiscard]] uint32_t growRing();
+    void readGpuTimes(uint32_t slotIndex, double &renderMs,
+                      double &readbackMs) const;
+    void logStageSummary() const;
+    void submitFrames(std::vector<EncodeItem> &batch);
+    void enqueueEncode(const EncodeItem &item);
     void runEncoderLoop();
 
   public:
@@ -95,6 +457,19 @@ class OfflineSDFRenderer : public SDFRenderer {
     OfflineSDFRenderer(
         const std::string &fragShaderPath, bool useToyTemplate = false,
         OfflineRenderOptions options = {});
+    // Releases everything renderFrames() would have if it threw first.
+    ~OfflineSDFRenderer();
+    // Compiles a fragment shader the way setup() would, for
+    // OfflineRenderOptions::fragSpirv. Batch renders call it on a worker
+    // thread while the previous job renders.
+    [[nodiscard]] static std::vector<uint32_t>
+    compileFragment(const std::string &fragShaderPath, bool useToyTemplate,
+                    uint32_t frameLayers = 1);
+    // Same, for the source already read from fragShaderPath.
+    [[nodiscard]] static std::vector<uint32_t>
+    compileFragmentSource(const std::string &source,
+                          const std::string &fragShaderPath,
+                          bool useToyTemplate, uint32_t frameLayers = 1);
     void setup();
     void renderFrames();
 };
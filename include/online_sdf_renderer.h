@@ -1,9 +1,13 @@
 #ifndef ONLINE_SDF_RENDERER_H
 #define ONLINE_SDF_RENDERER_H
+#include "deferred_destroy_queue.h"
+#include "reload_hitch.h"
 #include "sdf_renderer.h"
 #include "vkutils.h"
+#include <array>
 #include <filesystem>
 #include <optional>
+#include <vector>
 
 inline constexpr uint32_t WINDOW_WIDTH = 800;
 inline constexpr uint32_t WINDOW_HEIGHT = 600;
@@ -50,6 +54,21 @@ class OnlineSDFRenderer : public SDFRenderer {
     // For CI to test resize
     bool ciResizeTriggered = false;
 
+    // Hot reload. Submissions are numbered; a replaced pipeline is freed
+    // once the submission that last could have used it has completed.
+    DeferredDestroyQueue retiredPipelines;
+    uint64_t submitSerial = 0;
+    uint64_t completedSerial = 0;
+    // Serial of the submission each frame fence guards.
+    std::array<uint64_t, MAX_FRAME_SLOTS> fenceSerials{};
+    ReloadHitchMeter reloadHitch;
+    // A reloaded shader's module and pipeline, built on the compile
+    // thread.
+    struct ReloadedPipeline {
+        VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+    };
+
     // Timing
     std::chrono::time_point<std::chrono::high_resolution_clock> cpuStartFrame,
         cpuEndFrame;
@@ -59,10 +78,15 @@ class OnlineSDFRenderer : public SDFRenderer {
     void setupRenderContext();
     void createCommandBuffers();
     void createPipeline();
-    void tryRecreatePipeline();
+    // Runs on the shader compile thread: the device and pipeline cache
+    // can be used concurrently, and the render pass, layout and vertex
+    // module it reads don't change while the loop runs.
+    [[nodiscard]] ReloadedPipeline buildReloadedPipeline() const;
+    // Swaps in a pipeline built off the render thread and retires the old
+    // one.
+    void swapPipeline(const ReloadedPipeline &reloaded);
     void calcTimestamps(uint32_t imageIndex);
     void destroyRenderContext();
-    void destroyPipeline();
     void destroy();
 
     [[nodiscard]] vkutils::PushConstants
@@ -0,0 +1,47 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// On-disk VkPipelineCache blobs. Drivers only accept cache data they wrote
+// themselves, so each blob is stored per device and driver build and
+// checked against VkPipelineCacheHeaderVersionOne before it is handed
+// back to vkCreatePipelineCache. Kept free of Vulkan headers so the file
+// handling can be tested without a device.
+namespace pipeline_cache {
+// The fields of VkPhysicalDeviceProperties that identify a cache.
+struct DeviceKey {
+    uint32_t vendorID = 0;
+    uint32_t deviceID = 0;
+    uint32_t driverVersion = 0;
+    std::array<uint8_t, 16> uuid{};
+};
+
+// $VSDF_CACHE_DIR if set, otherwise the platform's user cache directory
+// plus "vsdf". Empty if none can be determined.
+[[nodiscard]] std::filesystem::path defaultDirectory();
+
+// dir/pipeline_<vendor>_<device>_<driver>_<uuid>.bin, all hex.
+[[nodiscard]] std::filesystem::path cachePath(const std::filesystem::path &dir,
+                                              const DeviceKey &key);
+
+// True if blob starts with a version one header written for key.
+[[nodiscard]] bool headerMatches(const std::vector<uint8_t> &blob,
+                                 const DeviceKey &key);
+
+// Empty if the file is missing, unreadable or was written for another
+// device; a stale cache just means a cold start.
+[[nodiscard]] std::vector<uint8_t> load(const std::filesystem::path &path,
+                                        const DeviceKey &key);
+
+// Writes blob next to path and renames it into place, so a crash or a
+// second instance exiting at the same time never leaves a torn file.
+// Creates the directory. Throws on failure.
+void saveAtomic(const std::filesystem::path &path,
+                const std::vector<uint8_t> &blob);
+} // namespace pipeline_cache
+
+#endif // PIPELINE_CACHE_H
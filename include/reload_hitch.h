@@ -0,0 +1,40 @@
+#ifndef RELOAD_HITCH_H
+#define RELOAD_HITCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+// Measures the hot-reload hitch: the longest frame time (present to
+// present) from the frame that swaps the pipeline through the next few,
+// against the median frame time just before the reload.
+class ReloadHitchMeter {
+  public:
+    struct Report {
+        double longestMs = 0.0;
+        double typicalMs = 0.0;
+    };
+
+    explicit ReloadHitchMeter(uint32_t windowFrames = 8,
+                              size_t historyFrames = 32);
+
+    // Call for every presented frame, after reloaded() if that frame
+    // swapped the pipeline.
+    void frame(double frameMs);
+    // The current frame swaps in a new pipeline.
+    void reloaded();
+    // Once the window after a reload is complete.
+    [[nodiscard]] std::optional<Report> takeReport();
+
+  private:
+    const uint32_t windowFrames;
+    const size_t historyFrames;
+    std::deque<double> history;
+    // Frames of the current reload window still to come; 0 when idle.
+    uint32_t windowLeft = 0;
+    Report current;
+    std::optional<Report> finished;
+};
+
+#endif // RELOAD_HITCH_H
@@ -0,0 +1,61 @@
+#ifndef RENDER_CHECKPOINT_H
+#define RENDER_CHECKPOINT_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Checkpoints for long offline renders. The output is written as a series
+// of independently decodable segments (closed GOPs, timestamps from 0) and
+// a small manifest records which frames are already muxed, so a killed
+// render can continue from the last finished segment instead of frame 0.
+namespace render_checkpoint {
+struct Manifest {
+    // Identifies the render; a resume must match both exactly.
+    std::string shaderHash;
+    std::string settings;
+    // Frame range of the whole render, [frameStart, frameEnd).
+    uint32_t frameStart = 0;
+    uint32_t frameEnd = 0;
+    uint32_t segmentFrames = 0;
+    // Frames before this one are muxed into the finished segments.
+    uint32_t nextFrame = 0;
+    std::vector<std::string> segments;
+};
+
+// out.mp4 -> out.mp4.checkpoint
+[[nodiscard]] std::filesystem::path
+manifestPath(const std::filesystem::path &outputPath);
+
+// out.mp4 -> out.part0.mp4
+[[nodiscard]] std::filesystem::path
+segmentPath(const std::filesystem::path &outputPath, size_t index);
+
+// 64-bit FNV-1a of the file contents as hex.
+[[nodiscard]] std::string hashFile(const std::filesystem::path &path);
+// Same hash of contents already in memory.
+[[nodiscard]] std::string hashContents(std::string_view contents);
+
+// Replaces the manifest atomically (temp file + rename), so a kill while
+// writing leaves the previous checkpoint intact.
+void writeManifest(const std::filesystem::path &path,
+                   const Manifest &manifest);
+
+// nullopt if there is no manifest; throws if it can't be parsed.
+[[nodiscard]] std::optional<Manifest>
+readManifest(const std::filesystem::path &path);
+
+// Throws if `saved` was written by a different render than `expected`
+// (shader, settings or frame range changed) or its segments are missing.
+void validateResume(const Manifest &saved, const Manifest &expected);
+
+// Joins the finished segments into outputPath, then removes them and the
+// manifest.
+void finishRender(const Manifest &manifest,
+                  const std::filesystem::path &outputPath);
+} // namespace render_checkpoint
+
+#endif // RENDER_CHECKPOINT_H
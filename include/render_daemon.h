@@ -0,0 +1,29 @@
+#ifndef RENDER_DAEMON_H
+#define RENDER_DAEMON_H
+
+#include "offline_sdf_renderer.h"
+
+#include <cstddef>
+#include <filesystem>
+
+// Long-running offline renderer for preview and thumbnail services. The
+// Vulkan instance, device, render pass and vertex module are created once
+// and each shader's pipeline is kept warm (keyed by its content hash), so
+// a request only pays for its ring, its frames and the image writes.
+// Requests are served one at a time over a Unix socket; see
+// render_request.h for the wire format.
+namespace render_daemon {
+struct Settings {
+    std::filesystem::path socketPath;
+    // Warm pipelines kept; the least recently used go first.
+    size_t maxWarmPipelines = 64;
+};
+
+// `base` supplies the render options a request doesn't set (ring,
+// batching, fps for motion blur...). Runs until a shutdown request,
+// SIGINT or SIGTERM, then removes the socket. Throws if the socket can't
+// be created; a failed request only fails its reply.
+void serve(const Settings &settings, const OfflineRenderOptions &base);
+} // namespace render_daemon
+
+#endif // RENDER_DAEMON_H
@@ -0,0 +1,60 @@
+#ifndef RENDER_REQUEST_H
+#define RENDER_REQUEST_H
+
+#include "image_sequence.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <string>
+#include <vector>
+
+// Wire format of the render daemon (--daemon). A client connects to the
+// daemon's Unix socket, writes one request as "key value" lines ended by
+// a blank line or by shutting down its side, and reads back one reply
+// line:
+//
+//   shader /abs/path/clouds.frag
+//   toy 1
+//   width 320
+//   height 180
+//   times 0 1.5 3
+//   output /abs/path/thumbs
+//   format png
+//
+//   ok frames=3 ms=41.20 setup_ms=12.80 render_ms=28.40 warm=1
+//
+// The frames land in output as frame_000000.png, frame_000001.png, ...,
+// one per entry of times (iTime in seconds). A request of just
+// "shutdown" stops the daemon.
+namespace render_request {
+struct Request {
+    bool shutdown = false;
+    std::filesystem::path shader;
+    bool toy = false;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    std::vector<float> times;
+    std::filesystem::path output;
+    image_sequence::Format format = image_sequence::Format::PNG;
+};
+
+// Throws std::runtime_error naming the offending line. Paths must be
+// absolute since the client's working directory isn't the daemon's;
+// width and height are at most 16384.
+[[nodiscard]] Request parseRequest(std::istream &in);
+
+struct Latency {
+    double totalMs = 0.0;
+    // Renderer setup, including the pipeline when it wasn't warm.
+    double setupMs = 0.0;
+    double renderMs = 0.0;
+};
+
+[[nodiscard]] std::string okReply(size_t frames, const Latency &latency,
+                                  bool warm);
+// The message is flattened onto the single reply line.
+[[nodiscard]] std::string errorReply(const std::string &message);
+} // namespace render_request
+
+#endif // RENDER_REQUEST_H
@@ -0,0 +1,47 @@
+#ifndef RENDER_SHARDS_H
+#define RENDER_SHARDS_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Coordinator for splitting an offline render across local vsdf worker
+// processes. Each worker renders a contiguous frame range into its own
+// segment (closed GOPs, timestamps starting at 0) and the coordinator
+// stream-copies the segments into the final output, so joining is
+// lossless.
+namespace render_shards {
+// Half-open frame range [start, end).
+struct FrameRange {
+    uint32_t start = 0;
+    uint32_t end = 0;
+};
+
+// Splits [start, end) into up to shardCount contiguous ranges whose sizes
+// differ by at most one frame. Never returns empty ranges.
+[[nodiscard]] std::vector<FrameRange>
+splitFrameRange(FrameRange range, uint32_t shardCount);
+
+// Segment file for shard `index`, next to the final output:
+// out.mp4 -> out.shard0.mp4
+[[nodiscard]] std::filesystem::path
+segmentPath(const std::filesystem::path &outputPath, size_t index);
+
+// Worker command line: the coordinator's own arguments (without argv[0])
+// minus the sharding/range/output flags, plus the worker's frame range
+// and segment output.
+[[nodiscard]] std::vector<std::string>
+workerArgs(const std::vector<std::string> &coordinatorArgs,
+           const FrameRange &range, const std::filesystem::path &segment);
+
+// Runs the shards as parallel processes of `exePath`, waits for all of
+// them and joins their segments into outputPath. Throws if any worker
+// fails; segments are removed either way.
+void runShardedRender(const std::filesystem::path &exePath,
+                      const std::vector<std::string> &coordinatorArgs,
+                      FrameRange range, uint32_t shardCount,
+                      const std::filesystem::path &outputPath);
+} // namespace render_shards
+
+#endif // RENDER_SHARDS_H
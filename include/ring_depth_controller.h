@@ -0,0 +1,65 @@
+#ifndef RING_DEPTH_CONTROLLER_H
+#define RING_DEPTH_CONTROLLER_H
+
+#include <cstdint>
+
+// Picks the offline ring depth at runtime from measured per-frame stage
+// times. The producer side (GPU render + readback) and the consumer side
+// (encode) both want to stay busy; whichever one is slower is the
+// bottleneck, and a deeper ring only helps when the bottleneck still idles
+// because the other side's jitter leaves it waiting.
+//
+// Starts at minDepth, grows by one slot whenever a window of frames shows
+// the bottleneck idling, and gives a slot back after several calm windows
+// in a row. Pure bookkeeping, no threading: the offline encoder thread
+// feeds it one frame at a time.
+class RingDepthController {
+  public:
+    struct Config {
+        uint32_t minDepth = 2;
+        uint32_t maxDepth = 2;
+        uint32_t windowFrames = 30;
+        // Grow when the bottleneck idles more than this share of a window.
+        double growIdleFraction = 0.05;
+        // Shrink after shrinkAfterWindows windows in a row with the
+        // bottleneck idling less than this.
+        double shrinkIdleFraction = 0.01;
+        uint32_t shrinkAfterWindows = 4;
+        // Windows to hold off shrinking after a grow, so a depth that just
+        // proved too small isn't retried straight away.
+        uint32_t growCooldownWindows = 16;
+    };
+
+    struct FrameTimes {
+        double gpuMs = 0.0;
+        double readbackMs = 0.0;
+        double encodeMs = 0.0;
+        // Wall time the encoder spent on this frame including waiting for it.
+        double wallMs = 0.0;
+    };
+
+    explicit RingDepthController(const Config &config);
+
+    // Accounts one encoded frame. Returns the depth to use from now on.
+    uint32_t addFrame(const FrameTimes &times);
+
+    [[nodiscard]] uint32_t depth() const noexcept { return currentDepth; }
+    [[nodiscard]] uint32_t peakDepth() const noexcept { return maxSeenDepth; }
+
+  private:
+    void endWindow();
+
+    const Config config;
+    uint32_t currentDepth = 0;
+    uint32_t maxSeenDepth = 0;
+
+    uint32_t windowCount = 0;
+    double producerBusyMs = 0.0;
+    double consumerBusyMs = 0.0;
+    double wallMs = 0.0;
+
+    uint32_t calmWindows = 0;
+    uint32_t cooldownWindows = 0;
+};
+
+#endif // RING_DEPTH_CONTROLLER_H
@@ -44,6 +44,8 @@ class SDFRenderer {
     VkRenderPass renderPass = VK_NULL_HANDLE;
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
     VkPipeline pipeline = VK_NULL_HANDLE;
+    // Seeded from and saved back to the per-device cache file.
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
     vkutils::CommandBuffers commandBuffers;
     vkutils::Fences fences;
 
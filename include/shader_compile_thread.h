@@ -0,0 +1,137 @@
+#ifndef SHADER_COMPILE_THREAD_H
+#define SHADER_COMPILE_THREAD_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Persistent thread that compiles shaders for hot reload so the render
+// loop keeps presenting with the current pipeline meanwhile. Only the
+// newest request matters: a request that hasn't started is replaced by a
+// later one, and a compile overtaken by a newer save mid-way is finished
+// (glslang can't be interrupted) but its result is dropped.
+//
+// T is what a compile produces: SPIR-V, or the shader module and pipeline
+// built from it so the render loop only swaps handles. Results that are
+// dropped, or never taken before stop(), go to the discard function.
+template <typename T = std::vector<uint32_t>> class ShaderCompileThread {
+  public:
+    using CompileFn = std::function<T()>;
+    using DiscardFn = std::function<void(T &)>;
+
+    struct Result {
+        uint64_t generation = 0;
+        // Empty if the compile threw; error holds the message.
+        std::optional<T> output;
+        std::string error;
+        double compileMs = 0.0;
+    };
+
+    explicit ShaderCompileThread(DiscardFn discard = nullptr)
+        : discard(std::move(discard)), worker([this] { run(); }) {}
+    ~ShaderCompileThread() { stop(); }
+    ShaderCompileThread(const ShaderCompileThread &) = delete;
+    ShaderCompileThread &operator=(const ShaderCompileThread &) = delete;
+    ShaderCompileThread(ShaderCompileThread &&) = delete;
+    ShaderCompileThread &operator=(ShaderCompileThread &&) = delete;
+
+    // Thread safe (called from file watcher threads). Returns the
+    // request's generation.
+    uint64_t request(CompileFn compile) {
+        uint64_t generation = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = std::move(compile);
+            generation = ++requested;
+        }
+        wake.notify_one();
+        return generation;
+    }
+
+    // Non-blocking. The result of the newest request once it is done;
+    // nullopt while it is still compiling or if it was already taken.
+    [[nodiscard]] std::optional<Result> takeResult() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::exchange(ready, std::nullopt);
+    }
+
+    // Number of finished compiles whose result was dropped as stale.
+    [[nodiscard]] uint64_t droppedCount() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return dropped;
+    }
+
+    // Waits for a compile in progress (there is no way to abort glslang),
+    // then discards the untaken result. Call it before destroying what
+    // the compiles use; later requests are ignored.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            pending = nullptr;
+        }
+        wake.notify_one();
+        if (worker.joinable())
+            worker.join();
+        if (ready && ready->output && discard)
+            discard(*ready->output);
+        ready.reset();
+    }
+
+  private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || pending != nullptr; });
+            if (stopping)
+                return;
+            CompileFn compile = std::exchange(pending, nullptr);
+            Result result;
+            result.generation = requested;
+            lock.unlock();
+
+            const auto start = std::chrono::steady_clock::now();
+            try {
+                result.output = compile();
+            } catch (const std::exception &e) {
+                result.error = e.what();
+            }
+            result.compileMs = std::chrono::duration<double, std::milli>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count();
+
+            lock.lock();
+            if (result.generation == requested) {
+                if (ready && ready->output && discard)
+                    discard(*ready->output);
+                ready = std::move(result);
+            } else {
+                // A newer save arrived while compiling; its compile is
+                // queued.
+                ++dropped;
+                if (result.output && discard)
+                    discard(*result.output);
+            }
+        }
+    }
+
+    const DiscardFn discard;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    CompileFn pending;
+    uint64_t requested = 0;
+    std::optional<Result> ready;
+    uint64_t dropped = 0;
+    bool stopping = false;
+    std::thread worker;
+};
+
+#endif // SHADER_COMPILE_THREAD_H
@@ -1,17 +1,68 @@
 #ifndef SHADER_UTILS_H
 #define SHADER_UTILS_H
+#include "spirv_cache.h"
 #include <filesystem>
 #include <string>
 #include <vector>
 
 namespace shader_utils {
+// Where a fragment shader reads iTime, iFrame and the other per-frame
+// inputs from. UniformBuffer defines VSDF_FRAME_UBO, which switches the
+// toy template (and shaders that check it, see shaders/vulktemplate.frag)
+// to a uniform block at set 0, binding 0 with the push constant layout.
+enum class FrameInputs {
+    PushConstants,
+    UniformBuffer,
+};
+
+// Read a shader file as is (no template).
+std::string readShaderSource(const std::string &filename);
+
 // Take a shader file eg. planet.frag
-// and produce SPIR-V in memory.
-std::vector<uint32_t> compileFileToSpirv(const std::string &shaderFilename,
-                                         bool useToyTemplate = false);
+// and produce SPIR-V in memory. frameLayers > 1 (layered offline renders)
+// also defines VSDF_FRAME_LAYERS: the uniform block then holds one entry
+// per array layer, picked by the layer the fullscreen quad was drawn to.
+std::vector<uint32_t>
+compileFileToSpirv(const std::string &shaderFilename,
+                   bool useToyTemplate = false,
+                   FrameInputs frameInputs = FrameInputs::PushConstants,
+                   uint32_t frameLayers = 1);
+
+// Same as compileFileToSpirv for source already read from shaderFilename,
+// which only names the stage (by extension) and the log line.
+std::vector<uint32_t>
+compileSourceToSpirv(const std::string &source,
+                     const std::string &shaderFilename,
+                     bool useToyTemplate = false,
+                     FrameInputs frameInputs = FrameInputs::PushConstants,
+                     uint32_t frameLayers = 1);
+
+// Every compile below first looks up the content-addressed SPIR-V cache
+// (in memory and under the cache directory, see pipeline_cache.h) and
+// only runs glslang on a miss.
+[[nodiscard]] spirv_cache::Stats spirvCacheStats();
+
+// Whether the module declares a push constant block, i.e. still reads its
+// frame inputs from push constants. Throws on malformed SPIR-V.
+[[nodiscard]] bool usesPushConstants(const std::vector<uint32_t> &spirv);
+
+// Whether a fragment module reads the vsdfLayer input (location 1) that
+// layered renders index their per-layer frame inputs with. Throws on
+// malformed SPIR-V.
+[[nodiscard]] bool readsFrameLayer(const std::vector<uint32_t> &spirv);
 
 // Compile the embedded fullscreen quad vertex shader directly to SPIR-V.
-std::vector<uint32_t> compileFullscreenQuadVertSpirv();
+// With frameLayers > 1 each instance is routed to array layer
+// gl_InstanceIndex (needs the Vulkan 1.2 shaderOutputLayer feature).
+std::vector<uint32_t> compileFullscreenQuadVertSpirv(uint32_t frameLayers = 1);
+
+// Compile the embedded RGBA -> YUV420P/NV12 compute shader used by the
+// offline renderer to convert frames on the GPU before readback.
+std::vector<uint32_t> compileRgbaToYuvCompSpirv();
+
+// Compile the embedded box-filter fragment shader that resolves a
+// supersampled offline render down to the output resolution.
+std::vector<uint32_t> compileBoxDownsampleFragSpirv();
 } // namespace shader_utils
 
 #endif // SHADER_UTILS_H
@@ -0,0 +1,70 @@
+#ifndef SPIRV_CACHE_H
+#define SPIRV_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Content-addressed cache of compiled SPIR-V. The key is a hash of
+// everything that decides the compiler's output (final source after the
+// template, preamble, stage and target settings), so re-saving a file
+// with identical bytes or restarting vsdf skips glslang entirely. Entries
+// live in memory and, when a directory is given, on disk as <key>.spv;
+// both are bounded in bytes and evict the least recently used entry.
+namespace spirv_cache {
+// 64-bit FNV-1a of the input plus its length, as hex.
+[[nodiscard]] std::string makeKey(std::string_view input);
+
+struct Stats {
+    uint64_t memoryHits = 0;
+    uint64_t diskHits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
+class Cache {
+  public:
+    // An empty directory keeps the cache in memory only.
+    Cache(std::filesystem::path directory, size_t maxMemoryBytes,
+          size_t maxDiskBytes);
+
+    // Thread safe. Disk errors are logged and treated as a miss.
+    [[nodiscard]] std::optional<std::vector<uint32_t>>
+    find(const std::string &key);
+    void store(const std::string &key, const std::vector<uint32_t> &spirv);
+
+    [[nodiscard]] Stats stats() const;
+
+  private:
+    struct Entry {
+        std::vector<uint32_t> spirv;
+        std::list<std::string>::iterator lruPosition;
+    };
+
+    [[nodiscard]] std::filesystem::path diskPath(const std::string &key) const;
+    void storeInMemory(const std::string &key, std::vector<uint32_t> spirv);
+    void storeOnDisk(const std::string &key,
+                     const std::vector<uint32_t> &spirv);
+    void trimDisk();
+
+    const std::filesystem::path directory;
+    const size_t maxMemoryBytes;
+    const size_t maxDiskBytes;
+
+    mutable std::mutex mutex;
+    // Most recently used at the front.
+    std::list<std::string> lru;
+    std::unordered_map<std::string, Entry> entries;
+    size_t memoryBytes = 0;
+    Stats counters;
+};
+} // namespace spirv_cache
+
+#endif // SPIRV_CACHE_H
@@ -0,0 +1,143 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free single-producer/single-consumer ring.
+//
+// The fast path is an acquire load, a release store and a fence per side.
+// When a side has to block (ring empty for pop, full for push) it spins briefly,
+// then parks on a C++20 atomic wait (a futex on Linux). The other side
+// only pays for a notify when somebody is actually parked.
+//
+// close() wakes both sides: push() then returns false and pop() drains
+// whatever is left before returning std::nullopt.
+template <typename T> class SpscRing {
+  public:
+    explicit SpscRing(size_t minCapacity)
+        : buffer(roundUpPow2(minCapacity)), mask(buffer.size() - 1) {}
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    [[nodiscard]] size_t capacity() const noexcept { return buffer.size(); }
+
+    [[nodiscard]] bool tryPush(const T &value) noexcept {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == buffer.size())
+            return false;
+        buffer[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        wakeParked();
+        return true;
+    }
+
+    [[nodiscard]] std::optional<T> tryPop() noexcept {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return std::nullopt;
+        T value = std::move(buffer[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        wakeParked();
+        return value;
+    }
+
+    // Blocks while the ring is full. Returns false if the ring was closed.
+    bool push(const T &value) {
+        return blockUntil([&] { return !isClosed() && tryPush(value); });
+    }
+
+    // Blocks while the ring is empty. Returns std::nullopt once the ring
+    // is closed and drained.
+    std::optional<T> pop() {
+        std::optional<T> value;
+        blockUntil([&] {
+            value = tryPop();
+            return value.has_value();
+        });
+        return value;
+    }
+
+    void close() noexcept {
+        closed.store(true, std::memory_order_release);
+        events.fetch_add(1, std::memory_order_release);
+        events.notify_all();
+    }
+
+    [[nodiscard]] bool isClosed() const noexcept {
+        return closed.load(std::memory_order_acquire);
+    }
+
+  private:
+    static constexpr size_t CACHE_LINE = 64;
+    static constexpr int SPIN_ITERATIONS = 256;
+
+    static size_t roundUpPow2(size_t value) noexcept {
+        size_t result = 1;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    void wakeParked() noexcept {
+        // Pairs with the fence in blockUntil: either the parked side sees
+        // our index update, or we see its parked count.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed) != 0) {
+            events.fetch_add(1, std::memory_order_release);
+            events.notify_all();
+        }
+    }
+
+    // Spinning only helps when the other side runs on another core.
+    static int spinIterations() noexcept {
+        static const int iterations =
+            std::thread::hardware_concurrency() > 1 ? SPIN_ITERATIONS : 0;
+        return iterations;
+    }
+
+    template <typename Attempt> bool blockUntil(Attempt &&attempt) {
+        for (int i = 0; i < spinIterations(); ++i) {
+            if (attempt())
+                return true;
+            if (isClosed())
+                return attempt();
+        }
+        while (true) {
+            parked.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const uint32_t epoch = events.load(std::memory_order_acquire);
+            if (attempt()) {
+                parked.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            if (isClosed()) {
+                parked.fetch_sub(1, std::memory_order_relaxed);
+                return attempt();
+            }
+            events.wait(epoch, std::memory_order_acquire);
+            parked.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    std::vector<T> buffer;
+    const size_t mask;
+
+    // Consumer and producer indices on separate cache lines so the two
+    // threads don't false-share.
+    alignas(CACHE_LINE) std::atomic<size_t> head{0};
+    alignas(CACHE_LINE) std::atomic<size_t> tail{0};
+
+    // Futex word for the blocking fallback plus the number of parked
+    // threads (at most one per side).
+    alignas(CACHE_LINE) std::atomic<uint32_t> events{0};
+    std::atomic<uint32_t> parked{0};
+    std::atomic<bool> closed{false};
+};
+
+#endif // SPSC_RING_H
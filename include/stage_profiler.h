@@ -0,0 +1,92 @@
+#ifndef STAGE_PROFILER_H
+#define STAGE_PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// Per-frame timings of the offline pipeline stages, summarised as
+// percentiles at the end of a run so a slow render can be pinned on the
+// shader, readback or encoder. Pure bookkeeping like RingDepthController:
+// the encoder thread adds one sample per output frame.
+class StageProfiler {
+  public:
+    enum class Stage : size_t {
+        // GPU timestamps around the render pass and the readback copy /
+        // conversion.
+        GpuRender,
+        GpuReadback,
+        // CPU time recording the command buffer, and the frame's share of
+        // the (possibly batched) vkQueueSubmit.
+        Record,
+        Submit,
+        // Submit until the encoder saw the frame's timeline value signal.
+        SubmitToDone,
+        // Encoder idle until the frame was handed over.
+        WaitForFrame,
+        // FfmpegEncoder: swscale/copy, avcodec_send_frame,
+        // avcodec_receive_packet and muxing.
+        Convert,
+        Send,
+        Receive,
+        Mux,
+        // Everything done with the finished frame (encode, image or stream
+        // write, checkpoint).
+        Output,
+        // Encoder loop wall time for the frame, waits included.
+        Frame,
+        Count,
+    };
+    static constexpr size_t STAGE_COUNT = static_cast<size_t>(Stage::Count);
+
+    struct Sample {
+        uint32_t frameIndex = 0;
+        std::array<double, STAGE_COUNT> ms{};
+
+        double &operator[](Stage stage) {
+            return ms[static_cast<size_t>(stage)];
+        }
+        double operator[](Stage stage) const {
+            return ms[static_cast<size_t>(stage)];
+        }
+    };
+
+    struct Stats {
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+        double mean = 0.0;
+    };
+
+    [[nodiscard]] static std::string_view stageName(Stage stage);
+
+    void reserve(size_t frames) { samples.reserve(frames); }
+    void add(const Sample &sample) { samples.push_back(sample); }
+    [[nodiscard]] size_t frameCount() const noexcept {
+        return samples.size();
+    }
+    [[nodiscard]] Stats stats(Stage stage) const;
+
+    // Logs p50/p95/p99/max per stage (stages that never ran are left out)
+    // and the overall frame and pixel rate over wallTime.
+    void logReport(std::chrono::nanoseconds wallTime,
+                   uint64_t pixelsPerFrame) const;
+    // One row per frame.
+    void writeCsv(std::ostream &out) const;
+    // Summary per stage plus the per-frame samples.
+    void writeJson(std::ostream &out, std::chrono::nanoseconds wallTime) const;
+    // CSV for a .csv path, JSON otherwise.
+    void writeFile(const std::filesystem::path &path,
+                   std::chrono::nanoseconds wallTime) const;
+
+  private:
+    std::vector<Sample> samples;
+};
+
+#endif // STAGE_PROFILER_H
@@ -4,12 +4,15 @@
 #ifndef VKUTILS_H
 #define VKUTILS_H
 // This is just to put the verbose vulkan stuff in its own place
+#include "pipeline_cache.h"
 #include "readback_frame.h"
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <initializer_list>
 #include <ios>
+#include <optional>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
 #include <string>
@@ -22,6 +25,14 @@
 #include <glm/glm.hpp>
 #include <spdlog/fmt/fmt.h>
 
+// Thrown by VK_CHECK for VK_ERROR_DEVICE_LOST. Unlike other failures it
+// leaves nothing created on the device usable, so callers that recover
+// from errors (e.g. batch jobs) let it through.
+class VulkanDeviceLost : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+};
+
 #define VK_CHECK(x)                                                            \
     do {                                                                       \
         VkResult err = x;                                                      \
@@ -29,6 +40,8 @@
             spdlog::error("Vulkan error: {} (0x{:x})",                         \
                           static_cast<int>(err),                               \
                           static_cast<uint32_t>(err));                         \
+            if (err == VK_ERROR_DEVICE_LOST)                                   \
+                throw VulkanDeviceLost("Vulkan device lost");                  \
             throw std::logic_error("Got a runtime_error");                     \
         }                                                                      \
     } while (0);
@@ -41,6 +54,19 @@ struct PushConstants {
     uint32_t iFrame;
     glm::vec2 iResolution;
     glm::vec2 iMouse;
+    // Pixel offset of the tile being drawn in a tiled offline render
+    // (zero otherwise); added to gl_FragCoord by the toy template.
+    glm::vec2 iTileOffset;
+};
+
+// Push constants for the offline RGBA -> YUV compute pass
+// (see shader_utils::compileRgbaToYuvCompSpirv).
+struct YuvConvertPushConstants {
+    uint32_t width;
+    uint32_t height;
+    uint32_t chromaOffset; // Byte offset of the U (or interleaved UV) plane
+    uint32_t crOffset;     // Byte offset of the V plane (planar only)
+    uint32_t interleaved;  // 1 for NV12, 0 for YUV420P
 };
 
 /* Helper structs so that we can pass around swapchain images
@@ -78,14 +104,17 @@ struct FrameBuffers {
 };
 
 /*
- * Used to readback a buffer from GPU -> CPU.
- * eg. to dump a frame as part of testing
- *     or to encode frames in CPU with ffmpeg
+ * Host-visible buffer the CPU maps, either to read back from the GPU
+ * (eg. to dump a frame as part of testing or to encode frames in CPU
+ * with ffmpeg) or to upload per-frame data.
  */
-struct ReadbackBuffer {
+struct HostBuffer {
     VkBuffer buffer = VK_NULL_HANDLE;
     VkDeviceMemory memory = VK_NULL_HANDLE;
     VkDeviceSize size = 0;
+    // False for HOST_CACHED memory without HOST_COHERENT; GPU writes then
+    // need invalidateReadbackBuffer before the CPU reads the mapping.
+    bool hostCoherent = true;
 };
 
 struct ReadbackFormatInfo {
@@ -400,9 +429,34 @@ createVulkanLogicalDevice(VkPhysicalDevice physicalDevice,
     spdlog::debug("Create a logical device...");
     VkDevice device;
 
+    // Offline rendering tracks frame completion with one timeline semaphore
+    // (core in Vulkan 1.2).
+    // Layered offline renders also route instances to array layers from
+    // the vertex shader, enabled when the device has it.
+    VkPhysicalDeviceVulkan12Features vulkan12Features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .timelineSemaphore = offline ? VK_TRUE : VK_FALSE,
+    };
+    if (offline) {
+        VkPhysicalDeviceVulkan12Features supported12{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        };
+        VkPhysicalDeviceFeatures2 supported{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &supported12,
+        };
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+        if (!supported12.timelineSemaphore) {
+            throw std::runtime_error(
+                "Offline rendering requires timeline semaphore support");
+        }
+        vulkan12Features.shaderOutputLayer = supported12.shaderOutputLayer;
+    }
+
     VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{
         .sType =
             VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+        .pNext = offline ? &vulkan12Features : nullptr,
         .dynamicRendering = VK_TRUE,
     };
 
@@ -713,11 +767,27 @@ findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t typeFilter,
     throw std::runtime_error("Failed to find suitable memory type");
 }
 
-[[nodiscard]] static ReadbackBuffer
-createReadbackBuffer(VkDevice device, VkPhysicalDevice physicalDevice,
-                     VkDeviceSize size, VkBufferUsageFlags usage,
-                     VkMemoryPropertyFlags properties) {
-    ReadbackBuffer buffer{
+/*
+ * Tries each property set in order and returns the first memory type
+ * that has all of them, or throws if none match.
+ */
+[[nodiscard]] static uint32_t
+findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t typeFilter,
+                    std::initializer_list<VkMemoryPropertyFlags> preferred) {
+    for (VkMemoryPropertyFlags properties : preferred) {
+        try {
+            return findMemoryTypeIndex(physicalDevice, typeFilter, properties);
+        } catch (const std::runtime_error &) {
+        }
+    }
+    throw std::runtime_error("Failed to find suitable memory type");
+}
+
+[[nodiscard]] static HostBuffer
+createHostBuffer(VkDevice device, VkPhysicalDevice physicalDevice,
+                 VkDeviceSize size, VkBufferUsageFlags usage,
+                 std::initializer_list<VkMemoryPropertyFlags> preferred) {
+    HostBuffer buffer{
         .size = size,
     };
     VkBufferCreateInfo bufferInfo{
@@ -736,16 +806,90 @@ createReadbackBuffer(VkDevice device, VkPhysicalDevice physicalDevice,
         .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
         .allocationSize = memRequirements.size,
         .memoryTypeIndex = findMemoryTypeIndex(
-            physicalDevice, memRequirements.memoryTypeBits, properties),
+            physicalDevice, memRequirements.memoryTypeBits, preferred),
     };
 
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    buffer.hostCoherent =
+        (memProperties.memoryTypes[allocInfo.memoryTypeIndex].propertyFlags &
+         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
     VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &buffer.memory));
     VK_CHECK(vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0));
 
     return buffer;
 }
 
-static void destroyReadbackBuffer(VkDevice device, ReadbackBuffer &buffer) {
+[[nodiscard]] static HostBuffer
+createHostBuffer(VkDevice device, VkPhysicalDevice physicalDevice,
+                 VkDeviceSize size, VkBufferUsageFlags usage,
+                 VkMemoryPropertyFlags properties) {
+    return createHostBuffer(device, physicalDevice, size, usage, {properties});
+}
+
+/*
+ * Readback buffer the CPU reads a lot from (encoding, PPM dumps).
+ * Coherent memory is often uncached or write-combined, which makes CPU
+ * reads very slow, so HOST_CACHED is preferred when the device has it.
+ * Falls back to plain HOST_COHERENT memory otherwise.
+ */
+[[nodiscard]] static HostBuffer
+createHostReadbackBuffer(VkDevice device, VkPhysicalDevice physicalDevice,
+                         VkDeviceSize size, VkBufferUsageFlags usage) {
+    return createHostBuffer(
+        device, physicalDevice, size, usage,
+        {
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_CACHED_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        });
+}
+
+/*
+ * Small buffer the CPU writes and the GPU reads (per-frame uniforms).
+ * Always coherent so writes only need to land before vkQueueSubmit;
+ * device-local host-visible memory is preferred where the device has it.
+ */
+[[nodiscard]] static HostBuffer
+createHostUploadBuffer(VkDevice device, VkPhysicalDevice physicalDevice,
+                       VkDeviceSize size, VkBufferUsageFlags usage) {
+    return createHostBuffer(
+        device, physicalDevice, size, usage,
+        {
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        });
+}
+
+/*
+ * Makes GPU writes visible to CPU reads of a mapped readback buffer.
+ * Call after waiting for the GPU work that wrote it. No-op for coherent
+ * memory. Invalidates up to the end of the mapping, so the buffer must be
+ * mapped with VK_WHOLE_SIZE: a range ending at the end of the allocation
+ * is valid whatever its nonCoherentAtomSize alignment.
+ */
+static void invalidateReadbackBuffer(VkDevice device,
+                                     const HostBuffer &buffer) {
+    if (buffer.hostCoherent)
+        return;
+    VkMappedMemoryRange range{
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = buffer.memory,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+    VK_CHECK(vkInvalidateMappedMemoryRanges(device, 1, &range));
+}
+
+static void destroyHostBuffer(VkDevice device, HostBuffer &buffer) {
     if (buffer.buffer != VK_NULL_HANDLE) {
         vkDestroyBuffer(device, buffer.buffer, nullptr);
     }
@@ -809,6 +953,57 @@ allocateDescriptorSet(VkDescriptorPool &descriptorPool, VkDevice &device,
     return descriptorSet;
 }
 
+[[nodiscard]] static VkDescriptorSetLayout createDescriptorSetLayout(
+    VkDevice device,
+    const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
+    VkDescriptorSetLayoutCreateInfo layoutInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings = bindings.data(),
+    };
+
+    VkDescriptorSetLayout descriptorSetLayout;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr,
+                                         &descriptorSetLayout));
+    return descriptorSetLayout;
+}
+
+[[nodiscard]] static VkDescriptorPool
+createDescriptorPool(VkDevice device,
+                     const std::vector<VkDescriptorPoolSize> &poolSizes,
+                     uint32_t maxSets) {
+    VkDescriptorPoolCreateInfo poolInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = maxSets,
+        .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+        .pPoolSizes = poolSizes.data(),
+    };
+
+    VkDescriptorPool descriptorPool;
+    VK_CHECK(
+        vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool));
+    return descriptorPool;
+}
+
+[[nodiscard]] static VkSampler createNearestSampler(VkDevice device) {
+    // Only used with texelFetch, so filtering never kicks in; nearest +
+    // clamp just keeps the sampler valid for a combined image sampler.
+    VkSamplerCreateInfo samplerInfo{
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = 0.0f,
+    };
+
+    VkSampler sampler;
+    VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &sampler));
+    return sampler;
+}
+
 [[nodiscard]] static CommandBuffers
 createCommandBuffers(VkDevice device, VkCommandPool commandPool,
                      uint32_t commandBufferCount) {
@@ -827,27 +1022,26 @@ createCommandBuffers(VkDevice device, VkCommandPool commandPool,
     return commandBuffers;
 }
 
-static void transitionImageLayout(VkDevice logicalDevice,
-                                  VkCommandPool commandPool, VkQueue queue,
-                                  VkImage image, VkImageLayout oldLayout,
-                                  VkImageLayout newLayout) {
-    VkCommandBufferAllocateInfo allocInfo{
+[[nodiscard]] static VkCommandBuffer
+allocateCommandBuffer(VkDevice device, VkCommandPool commandPool) {
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo{
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .commandPool = commandPool,
         .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
         .commandBufferCount = 1,
     };
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo,
+                                      &commandBuffer));
+    return commandBuffer;
+}
 
-    VkCommandBuffer commandBuffer;
-    VK_CHECK(
-        vkAllocateCommandBuffers(logicalDevice, &allocInfo, &commandBuffer));
-
-    VkCommandBufferBeginInfo beginInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-    };
-    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
-
+// Records a layout transition into commandBuffer, so a new image can be
+// prepared by the first command buffer that uses it instead of a separate
+// submit and queue wait.
+static void recordImageLayoutTransition(VkCommandBuffer commandBuffer,
+                                        VkImage image, VkImageLayout oldLayout,
+                                        VkImageLayout newLayout) {
     VkImageMemoryBarrier barrier{
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
         .oldLayout = oldLayout,
@@ -861,7 +1055,7 @@ static void transitionImageLayout(VkDevice logicalDevice,
                 .baseMipLevel = 0,
                 .levelCount = 1,
                 .baseArrayLayer = 0,
-                .layerCount = 1,
+                .layerCount = VK_REMAINING_ARRAY_LAYERS,
             },
     };
 
@@ -880,19 +1074,6 @@ static void transitionImageLayout(VkDevice logicalDevice,
 
     vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0,
                          nullptr, 1, &barrier);
-
-    VK_CHECK(vkEndCommandBuffer(commandBuffer));
-
-    VkSubmitInfo submitInfo{
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &commandBuffer,
-    };
-
-    // Submit and wait so the image is ready before further use.
-    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-    VK_CHECK(vkQueueWaitIdle(queue));
-    vkFreeCommandBuffers(logicalDevice, commandPool, 1, &commandBuffer);
 }
 
 [[nodiscard]] static Fences createFences(VkDevice device, uint32_t count) {
@@ -920,6 +1101,36 @@ static void transitionImageLayout(VkDevice logicalDevice,
     return semaphore;
 }
 
+// Timeline semaphore starting at initialValue (Vulkan 1.2).
+[[nodiscard]] static VkSemaphore createTimelineSemaphore(VkDevice device,
+                                                         uint64_t initialValue) {
+    VkSemaphoreTypeCreateInfo typeCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = initialValue,
+    };
+    VkSemaphoreCreateInfo semaphoreCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &typeCreateInfo,
+    };
+    VkSemaphore semaphore;
+    VK_CHECK(
+        vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+    return semaphore;
+}
+
+// Host wait until the timeline semaphore reaches at least value.
+static void waitTimelineSemaphore(VkDevice device, VkSemaphore semaphore,
+                                  uint64_t value) {
+    VkSemaphoreWaitInfo waitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &semaphore,
+        .pValues = &value,
+    };
+    VK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+}
+
 [[nodiscard]] static Semaphores createSemaphores(VkDevice device,
                                                  uint32_t count) {
     Semaphores semaphores;
@@ -974,6 +1185,81 @@ createRenderPass(VkDevice device, VkFormat format, bool offline = false) {
     return renderPass;
 }
 
+// Offline intermediate target (motion blur accumulation and/or
+// supersampled render): cleared at the start of every frame, then drawn
+// into. Ends in finalLayout, either TRANSFER_SRC_OPTIMAL for the resolve
+// blit or SHADER_READ_ONLY_OPTIMAL for the downsample pass, both of which
+// write the ring slot image.
+[[nodiscard]] static VkRenderPass
+createIntermediateRenderPass(VkDevice device, VkFormat format,
+                             VkImageLayout finalLayout) {
+    spdlog::debug("Create intermediate render pass");
+    VkAttachmentDescription colorAttachment{
+        .format = format,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = finalLayout,
+    };
+
+    VkAttachmentReference colorAttachmentRef{
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    };
+
+    VkSubpassDescription subpass{
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorAttachmentRef,
+    };
+
+    // The previous frame's resolve reads the image before we clear it, and
+    // this frame's resolve reads what the draws wrote.
+    const bool sampled =
+        finalLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    const VkPipelineStageFlags resolveStage =
+        sampled ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+                : VK_PIPELINE_STAGE_TRANSFER_BIT;
+    const std::array<VkSubpassDependency, 2> dependencies = {{
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = resolveStage,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        },
+        {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = resolveStage,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = sampled ? VK_ACCESS_SHADER_READ_BIT
+                                     : VK_ACCESS_TRANSFER_READ_BIT,
+        },
+    }};
+
+    VkRenderPassCreateInfo renderPassInfo{
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &colorAttachment,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = static_cast<uint32_t>(dependencies.size()),
+        .pDependencies = dependencies.data(),
+    };
+
+    VkRenderPass renderPass;
+    VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
+
+    return renderPass;
+}
+
 [[nodiscard]] static FrameBuffers
 createFrameBuffers(VkDevice device, VkRenderPass renderPass, VkExtent2D extent,
                    const SwapchainImageViews &swapchainImageViews) {
@@ -1017,6 +1303,23 @@ createFrameBuffers(VkDevice device, VkRenderPass renderPass, VkExtent2D extent,
     return pipelineLayout;
 }
 
+[[nodiscard]] static VkPipelineLayout
+createPipelineLayout(VkDevice device, VkDescriptorSetLayout setLayout,
+                     const VkPushConstantRange &pushConstantRange) {
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
+    };
+
+    VkPipelineLayout pipelineLayout;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr,
+                                    &pipelineLayout));
+    return pipelineLayout;
+}
+
 [[nodiscard]] static VkShaderModule
 createShaderModule(VkDevice device, const std::string &filename) {
     spdlog::info("Create shader module");
@@ -1046,11 +1349,78 @@ createShaderModule(VkDevice device, const std::vector<uint32_t> &spirv) {
     return shaderModule;
 }
 
+[[nodiscard]] static pipeline_cache::DeviceKey
+pipelineCacheKey(const VkPhysicalDeviceProperties &deviceProperties) {
+    static_assert(VK_UUID_SIZE == sizeof(pipeline_cache::DeviceKey::uuid));
+    pipeline_cache::DeviceKey key;
+    key.vendorID = deviceProperties.vendorID;
+    key.deviceID = deviceProperties.deviceID;
+    key.driverVersion = deviceProperties.driverVersion;
+    std::memcpy(key.uuid.data(), deviceProperties.pipelineCacheUUID,
+                key.uuid.size());
+    return key;
+}
+
+// Creates a pipeline cache seeded from this device's cache file, so
+// pipelines built by an earlier run skip the driver's shader compile.
+[[nodiscard]] static VkPipelineCache
+loadPipelineCache(VkDevice device,
+                  const VkPhysicalDeviceProperties &deviceProperties) {
+    std::vector<uint8_t> initialData;
+    const auto dir = pipeline_cache::defaultDirectory();
+    if (!dir.empty()) {
+        const auto key = pipelineCacheKey(deviceProperties);
+        const auto path = pipeline_cache::cachePath(dir, key);
+        initialData = pipeline_cache::load(path, key);
+        spdlog::info("Pipeline cache {}: {} bytes", path.string(),
+                     initialData.size());
+    }
+    VkPipelineCacheCreateInfo createInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .initialDataSize = initialData.size(),
+        .pInitialData = initialData.empty() ? nullptr : initialData.data(),
+    };
+    VkPipelineCache pipelineCache;
+    VK_CHECK(
+        vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache));
+    return pipelineCache;
+}
+
+// Writes the cache back for the next run. Failing to save only costs the
+// next startup a cold compile, so it warns instead of throwing.
+static void
+savePipelineCache(VkDevice device,
+                  const VkPhysicalDeviceProperties &deviceProperties,
+                  VkPipelineCache pipelineCache) {
+    const auto dir = pipeline_cache::defaultDirectory();
+    if (dir.empty() || pipelineCache == VK_NULL_HANDLE)
+        return;
+    size_t size = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, pipelineCache, &size, nullptr));
+    std::vector<uint8_t> data(size);
+    VK_CHECK(
+        vkGetPipelineCacheData(device, pipelineCache, &size, data.data()));
+    data.resize(size);
+    const auto path =
+        pipeline_cache::cachePath(dir, pipelineCacheKey(deviceProperties));
+    try {
+        pipeline_cache::saveAtomic(path, data);
+        spdlog::debug("Saved pipeline cache {}: {} bytes", path.string(),
+                      size);
+    } catch (const std::exception &e) {
+        spdlog::warn("Failed to save pipeline cache: {}", e.what());
+    }
+}
+
 [[nodiscard]] static VkPipeline
 createGraphicsPipeline(VkDevice device, VkRenderPass renderPass,
                        VkPipelineLayout pipelineLayout, VkExtent2D extent,
                        VkShaderModule vertShaderModule,
-                       VkShaderModule fragShaderModule) {
+                       VkShaderModule fragShaderModule,
+                       std::optional<float> accumulateWeight = std::nullopt,
+                       VkPipelineCache pipelineCache = VK_NULL_HANDLE) {
     spdlog::info("Create graphics pipeline");
     VkPipeline pipeline;
 
@@ -1134,6 +1504,19 @@ createGraphicsPipeline(VkDevice device, VkRenderPass renderPass,
         .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
                           VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
     };
+    // Accumulation: dst += weight * src, so K draws with weight 1/K
+    // average into a float attachment.
+    if (accumulateWeight) {
+        colorBlendAttachment.blendEnable = VK_TRUE;
+        colorBlendAttachment.srcColorBlendFactor =
+            VK_BLEND_FACTOR_CONSTANT_COLOR;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor =
+            VK_BLEND_FACTOR_CONSTANT_ALPHA;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
 
     VkPipelineColorBlendStateCreateInfo colorBlending{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
@@ -1142,6 +1525,10 @@ createGraphicsPipeline(VkDevice device, VkRenderPass renderPass,
         .attachmentCount = 1,
         .pAttachments = &colorBlendAttachment,
     };
+    if (accumulateWeight) {
+        for (float &constant : colorBlending.blendConstants)
+            constant = *accumulateWeight;
+    }
 
     VkGraphicsPipelineCreateInfo pipelineInfo = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
@@ -1158,19 +1545,44 @@ createGraphicsPipeline(VkDevice device, VkRenderPass renderPass,
         .renderPass = renderPass,
         .subpass = 0,
     };
-    VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo,
+    VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo,
                                        nullptr, &pipeline));
     spdlog::info("Created graphics pipeline");
     return pipeline;
 }
 
-[[nodiscard]] static VkQueryPool createQueryPool(VkDevice device,
-                                                 uint32_t numSwapchainImages) {
+[[nodiscard]] static VkPipeline
+createComputePipeline(VkDevice device, VkPipelineLayout pipelineLayout,
+                      VkShaderModule computeShaderModule,
+                      VkPipelineCache pipelineCache = VK_NULL_HANDLE) {
+    spdlog::info("Create compute pipeline");
+    VkComputePipelineCreateInfo pipelineInfo{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage =
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = computeShaderModule,
+                .pName = "main",
+            },
+        .layout = pipelineLayout,
+    };
+
+    VkPipeline pipeline;
+    VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo,
+                                      nullptr, &pipeline));
+    return pipeline;
+}
+
+[[nodiscard]] static VkQueryPool
+createQueryPool(VkDevice device, uint32_t numSwapchainImages,
+                uint32_t queriesPerFrame = 2) {
     // Query pool used for calculating frame processing duration
     VkQueryPoolCreateInfo queryPooolCreateInfo{
         .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
         .queryType = VK_QUERY_TYPE_TIMESTAMP,
-        .queryCount = 2 * numSwapchainImages, // 2 per frame, start and end
+        // Default 2 per frame, start and end
+        .queryCount = queriesPerFrame * numSwapchainImages,
     };
 
     VkQueryPool queryPool;
@@ -1275,11 +1687,9 @@ debugReadbackSwapchainImage(const ReadbackContext &context, VkImage srcImage,
                              static_cast<VkDeviceSize>(extent.height) *
                              formatInfo.bytesPerPixel;
 
-    ReadbackBuffer stagingBuffer =
-        createReadbackBuffer(context.device, context.physicalDevice, imageSize,
-                             VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    HostBuffer stagingBuffer = createHostReadbackBuffer(
+        context.device, context.physicalDevice, imageSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT);
 
     VkCommandBufferAllocateInfo allocInfo{
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -1365,9 +1775,23 @@ debugReadbackSwapchainImage(const ReadbackContext &context, VkImage srcImage,
             },
     };
 
-    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
-                         nullptr, 1, &barrierToPresent);
+    // Copy results must be made available to the host before mapping,
+    // which matters for non-coherent (cached) staging memory.
+    VkBufferMemoryBarrier copyToHost{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = stagingBuffer.buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0,
+        nullptr, 1, &copyToHost, 1, &barrierToPresent);
 
     VK_CHECK(vkEndCommandBuffer(commandBuffer));
 
@@ -1381,8 +1805,9 @@ debugReadbackSwapchainImage(const ReadbackContext &context, VkImage srcImage,
     VK_CHECK(vkQueueWaitIdle(context.queue));
 
     void *data = nullptr;
-    VK_CHECK(vkMapMemory(context.device, stagingBuffer.memory, 0, imageSize, 0,
-                         &data));
+    VK_CHECK(vkMapMemory(context.device, stagingBuffer.memory, 0,
+                         VK_WHOLE_SIZE, 0, &data));
+    invalidateReadbackBuffer(context.device, stagingBuffer);
 
     PPMDebugFrame frame;
     frame.allocateRGB(extent.width, extent.height);
@@ -1412,7 +1837,7 @@ debugReadbackSwapchainImage(const ReadbackContext &context, VkImage srcImage,
     vkUnmapMemory(context.device, stagingBuffer.memory);
     vkFreeCommandBuffers(context.device, context.commandPool, 1,
                          &commandBuffer);
-    destroyReadbackBuffer(context.device, stagingBuffer);
+    destroyHostBuffer(context.device, stagingBuffer);
 
     return frame;
 }
@@ -1,11 +1,36 @@
 #version 450
 
+// Offline renders define VSDF_FRAME_UBO and read the inputs from a uniform
+// buffer so their command buffers can be recorded once; keep both lines to
+// run under vsdf and offline alike. Layered offline renders
+// (--ffmpeg-frame-layers) define VSDF_FRAME_LAYERS and need one entry per
+// layer, picked by the layer the vertex shader routed this fragment to.
+#if defined(VSDF_FRAME_LAYERS)
+struct VsdfFrameInputs {
+    float iTime;
+    int iFrame;
+    vec2 iResolution;
+    vec2 iMouse;
+    vec2 iTileOffset;
+};
+layout (set = 0, binding = 0) uniform FrameInputs {
+    VsdfFrameInputs layers[VSDF_FRAME_LAYERS];
+} frameInputs;
+layout (location = 1) flat in int vsdfLayer;
+#define pc frameInputs.layers[vsdfLayer]
+#else
+#ifdef VSDF_FRAME_UBO
+layout (set = 0, binding = 0) uniform FrameInputs {
+#else
 layout (push_constant) uniform PushConstants {
+#endif
     float iTime;
     int iFrame;
     vec2 iResolution;
     vec2 iMouse;
+    vec2 iTileOffset; // add to gl_FragCoord.xy for tiled offline renders
 } pc;
+#endif
 
 layout (location = 0) in vec2 TexCoord;
 layout (location = 0) out vec4 color;
@@ -0,0 +1,140 @@
+#include "batch_render.h"
+
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <exception>
+#include <future>
+#include <memory>
+
+namespace batch_render {
+namespace {
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+std::future<std::vector<uint32_t>> compileAsync(const job_manifest::Job &job,
+                                                uint32_t frameLayers) {
+    return std::async(std::launch::async, [&job, frameLayers]() {
+        return OfflineSDFRenderer::compileFragment(job.shader.string(),
+                                                   job.toy, frameLayers);
+    });
+}
+
+void logReport(const std::vector<JobResult> &results, double wallSeconds) {
+    spdlog::info("Batch report, per job: frames, s, frames/s, Mpixel/s, "
+                 "compile wait s");
+    uint64_t frames = 0;
+    double megapixels = 0.0;
+    size_t failed = 0;
+    for (const JobResult &result : results) {
+        if (!result.error.empty()) {
+            spdlog::error("  {:<24} failed: {}", result.name, result.error);
+            ++failed;
+            continue;
+        }
+        const double jobMegapixels =
+            static_cast<double>(result.frames) *
+            static_cast<double>(result.pixelsPerFrame) / 1e6;
+        const double fps =
+            result.seconds > 0.0
+                ? static_cast<double>(result.frames) / result.seconds
+                : 0.0;
+        spdlog::info("  {:<24} {:7} {:8.2f} {:8.1f} {:8.1f} {:8.2f}",
+                     result.name, result.frames, result.seconds, fps,
+                     result.seconds > 0.0 ? jobMegapixels / result.seconds
+                                          : 0.0,
+                     result.compileWaitSeconds);
+        frames += result.frames;
+        megapixels += jobMegapixels;
+    }
+    if (wallSeconds > 0.0) {
+        spdlog::info("Batch throughput: {} job(s), {} frames in {:.2f} s, "
+                     "{:.1f} frames/s, {:.1f} Mpixel/s",
+                     results.size() - failed, frames, wallSeconds,
+                     static_cast<double>(frames) / wallSeconds,
+                     megapixels / wallSeconds);
+    }
+    if (failed > 0)
+        spdlog::error("{} of {} job(s) failed", failed, results.size());
+}
+} // namespace
+
+std::vector<JobResult> runJobs(const std::vector<job_manifest::Job> &jobs,
+                               const OfflineRenderOptions &base) {
+    std::vector<JobResult> results;
+    if (jobs.empty())
+        return results;
+    results.reserve(jobs.size());
+
+    const auto batchStart = Clock::now();
+    auto context = std::make_shared<OfflineVulkanContext>();
+    spdlog::info("Batch render: {} job(s) on {}", jobs.size(),
+                 context->deviceProperties.deviceName);
+
+    // Compiles run on a worker while the main thread renders, never while
+    // it sets up a renderer (which compiles its own helper shaders).
+    auto nextSpirv = compileAsync(jobs.front(), base.frameLayers);
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const job_manifest::Job &job = jobs[i];
+        const bool hasNext = i + 1 < jobs.size();
+        JobResult &result = results.emplace_back();
+        result.name = job.name;
+        result.pixelsPerFrame = static_cast<uint64_t>(job.width) * job.height;
+        spdlog::info("Job {}/{}: {} ({}x{}, {} frames) -> {}", i + 1,
+                     jobs.size(), job.name, job.width, job.height, job.frames,
+                     job.encode.outputPath);
+
+        const auto waitStart = Clock::now();
+        std::vector<uint32_t> spirv;
+        try {
+            spirv = nextSpirv.get();
+        } catch (const std::exception &e) {
+            result.error = e.what();
+        }
+        result.compileWaitSeconds = Seconds(Clock::now() - waitStart).count();
+        if (!result.error.empty()) {
+            spdlog::error("Job {} skipped: {}", job.name, result.error);
+            if (hasNext)
+                nextSpirv = compileAsync(jobs[i + 1], base.frameLayers);
+            continue;
+        }
+
+        OfflineRenderOptions options = base;
+        options.frameStart = 0;
+        options.maxFrames = job.frames;
+        options.width = job.width;
+        options.height = job.height;
+        options.encodeSettings = job.encode;
+        options.vulkanContext = context;
+        options.fragSpirv = std::move(spirv);
+
+        const auto jobStart = Clock::now();
+        bool nextStarted = false;
+        try {
+            OfflineSDFRenderer renderer(job.shader.string(), job.toy,
+                                        std::move(options));
+            renderer.setup();
+            if (hasNext) {
+                nextSpirv = compileAsync(jobs[i + 1], base.frameLayers);
+                nextStarted = true;
+            }
+            renderer.renderFrames();
+            result.frames = job.frames;
+            result.seconds = Seconds(Clock::now() - jobStart).count();
+        } catch (const VulkanDeviceLost &) {
+            // Every later job would fail on the same device.
+            throw;
+        } catch (const std::exception &e) {
+            // The renderer has released its resources by now, so the
+            // next job starts from a clean shared context.
+            result.error = e.what();
+            spdlog::error("Job {} failed: {}", job.name, result.error);
+            if (hasNext && !nextStarted)
+                nextSpirv = compileAsync(jobs[i + 1], base.frameLayers);
+        }
+    }
+
+    logReport(results, Seconds(Clock::now() - batchStart).count());
+    return results;
+}
+} // namespace batch_render
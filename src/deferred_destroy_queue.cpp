@@ -0,0 +1,28 @@
+#include "deferred_destroy_queue.h"
+
+#include <utility>
+
+void DeferredDestroyQueue::retire(uint64_t lastUseSerial,
+                                  std::function<void()> destroy) {
+    pending.push_back({lastUseSerial, std::move(destroy)});
+}
+
+size_t DeferredDestroyQueue::collect(uint64_t completedSerial) {
+    size_t destroyed = 0;
+    while (!pending.empty() &&
+           pending.front().lastUseSerial <= completedSerial) {
+        Retired retired = std::move(pending.front());
+        pending.pop_front();
+        retired.destroy();
+        ++destroyed;
+    }
+    return destroyed;
+}
+
+void DeferredDestroyQueue::flush() {
+    while (!pending.empty()) {
+        Retired retired = std::move(pending.front());
+        pending.pop_front();
+        retired.destroy();
+    }
+}
@@ -1,11 +1,19 @@
 #include "ffmpeg_encoder.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <spdlog/fmt/fmt.h>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
+#include <thread>
 
 extern "C" {
+#include <libavutil/dict.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
 }
 
 namespace ffmpeg_utils {
@@ -15,6 +23,151 @@ std::string ffmpegErrStr(int err) {
     av_strerror(err, buf, sizeof(buf));
     return std::string(buf);
 }
+
+// AV_PIX_FMT_NONE-terminated list, or null if the encoder accepts any
+// format.
+const AVPixelFormat *supportedPixelFormats(const AVCodecContext *codecContext,
+                                           const AVCodec *codec) {
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(61, 13, 100)
+    const void *configs = nullptr;
+    if (avcodec_get_supported_config(codecContext, codec,
+                                     AV_CODEC_CONFIG_PIX_FORMAT, 0, &configs,
+                                     nullptr) < 0)
+        return nullptr;
+    return static_cast<const AVPixelFormat *>(configs);
+#else
+    (void)codecContext;
+    return codec->pix_fmts;
+#endif
+}
+
+bool codecSupportsPixelFormat(const AVPixelFormat *formats,
+                              AVPixelFormat format) {
+    if (!formats)
+        return true;
+    for (; *formats != AV_PIX_FMT_NONE; ++formats) {
+        if (*formats == format)
+            return true;
+    }
+    return false;
+}
+
+// Encoder format the source can be fed as without conversion, or
+// AV_PIX_FMT_NONE. The alpha channel is never encoded, so BGRA/RGBA also
+// match the same layout with a padding byte (e.g. libx264rgb takes BGR0).
+AVPixelFormat matchSourcePixelFormat(const AVPixelFormat *formats,
+                                     AVPixelFormat srcFormat) {
+    AVPixelFormat noAlpha = AV_PIX_FMT_NONE;
+    if (srcFormat == AV_PIX_FMT_BGRA)
+        noAlpha = AV_PIX_FMT_BGR0;
+    else if (srcFormat == AV_PIX_FMT_RGBA)
+        noAlpha = AV_PIX_FMT_RGB0;
+
+    for (AVPixelFormat candidate : {srcFormat, noAlpha}) {
+        if (candidate != AV_PIX_FMT_NONE &&
+            codecSupportsPixelFormat(formats, candidate))
+            return candidate;
+    }
+    return AV_PIX_FMT_NONE;
+}
+
+// Conversion target when the source can't be passed through: YUV420P for
+// the usual delivery codecs, otherwise the closest format the codec takes
+// (e.g. GBRP for utvideo).
+AVPixelFormat pickConvertPixelFormat(const AVPixelFormat *formats,
+                                     AVPixelFormat srcFormat) {
+    if (codecSupportsPixelFormat(formats, AV_PIX_FMT_YUV420P))
+        return AV_PIX_FMT_YUV420P;
+    return avcodec_find_best_pix_fmt_of_list(formats, srcFormat, 0, nullptr);
+}
+
+// Whether the encoder still references a frame's buffer after its packets
+// have been drained, as delayed and frame-threaded encoders may.
+bool encoderHoldsFrame(const AVFrame *frame) {
+    return frame->buf[0] && av_buffer_get_ref_count(frame->buf[0]) > 1;
+}
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+// Wrapped frames borrow the caller's memory, which it frees itself.
+void releaseBorrowedBuffer(void *, uint8_t *) {}
+
+// Refcounted view of the caller's memory, so FFmpeg can reference the
+// frame rather than copy it. Dropping the reference frees nothing.
+AVBufferRef *borrowBuffer(const uint8_t *data, size_t size) {
+    return av_buffer_create(const_cast<uint8_t *>(data),
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+                            size,
+#else
+                            static_cast<int>(size),
+#endif
+                            releaseBorrowedBuffer, nullptr,
+                            AV_BUFFER_FLAG_READONLY);
+}
+
+// Below this many rows per slice the thread handoff costs more than the
+// conversion it saves.
+constexpr int MIN_SLICE_ROWS = 64;
+constexpr int MAX_AUTO_CONVERT_THREADS = 8;
+
+int resolveConvertThreads(int requested, int height) {
+    int threads = requested;
+    if (threads <= 0) {
+        const unsigned cores = std::thread::hardware_concurrency();
+        threads = std::clamp(static_cast<int>(cores), 1,
+                             MAX_AUTO_CONVERT_THREADS);
+    }
+    return std::clamp(height / MIN_SLICE_ROWS, 1, threads);
+}
+
+// Muxer for the mode, or null to infer it from the output extension.
+const char *muxerName(MuxMode mux) {
+    switch (mux) {
+    case MuxMode::HLS:
+        return "hls";
+    case MuxMode::Segments:
+        return "segment";
+    case MuxMode::Standard:
+    case MuxMode::Fragmented:
+        break;
+    }
+    return nullptr;
+}
+
+// Muxer options that cut the output into independently usable pieces as
+// the render goes. Segments are cut on keyframes, which the GOP length
+// places every segmentSeconds.
+AVDictionary *muxerOptions(const EncodeSettings &settings) {
+    AVDictionary *options = nullptr;
+    const std::string seconds = fmt::format("{}", settings.segmentSeconds);
+    switch (settings.mux) {
+    case MuxMode::Fragmented:
+        av_dict_set(&options, "movflags",
+                    "frag_keyframe+empty_moov+default_base_moof", 0);
+        break;
+    case MuxMode::HLS:
+        av_dict_set(&options, "hls_time", seconds.c_str(), 0);
+        // Keep every segment in the playlist; it gets its end tag in the
+        // trailer.
+        av_dict_set(&options, "hls_list_size", "0", 0);
+        av_dict_set(&options, "hls_playlist_type", "event", 0);
+        av_dict_set(&options, "hls_flags", "independent_segments", 0);
+        break;
+    case MuxMode::Segments:
+        av_dict_set(&options, "segment_time", seconds.c_str(), 0);
+        // Every file starts at timestamp 0 so it plays on its own.
+        av_dict_set(&options, "reset_timestamps", "1", 0);
+        break;
+    case MuxMode::Standard:
+        break;
+    }
+    return options;
+}
 } // namespace
 
 FfmpegEncoder::FfmpegEncoder(const EncodeSettings &settings, int width,
@@ -35,9 +188,18 @@ void FfmpegEncoder::open() {
     if (!codec)
         throw std::runtime_error("Failed to find encoder: " + settings.codec);
 
-    // Let FFmpeg infer container format from output path (extension).
-    int err = avformat_alloc_output_context2(&formatContext, nullptr, nullptr,
-                                             settings.outputPath.c_str());
+    if (settings.mux == MuxMode::Segments &&
+        settings.outputPath.find('%') == std::string::npos)
+        throw std::runtime_error("Segmented output needs a numbered path "
+                                 "pattern such as out_%05d.mp4");
+    if (!(settings.segmentSeconds > 0.0f))
+        throw std::runtime_error("Segment length must be positive");
+
+    // Let FFmpeg infer container format from output path (extension),
+    // unless the mux mode needs a specific muxer.
+    int err = avformat_alloc_output_context2(
+        &formatContext, nullptr, muxerName(settings.mux),
+        settings.outputPath.c_str());
     if (err < 0 || !formatContext)
         throw std::runtime_error("Failed to create output context: " +
                                  ffmpegErrStr(err));
@@ -57,8 +219,23 @@ void FfmpegEncoder::open() {
     // Encoder timestamps are in 1/fps timebase for frame-accurate PTS.
     codecContext->time_base = AVRational{1, settings.fps};
     codecContext->framerate = AVRational{settings.fps, 1};
-    codecContext->pix_fmt = AV_PIX_FMT_YUV420P;
-    codecContext->gop_size = settings.fps;
+    // Input the encoder accepts as-is (GPU-converted YUV, or packed RGB for
+    // codecs like ffv1/qtrle/libx264rgb) is passed straight through.
+    const AVPixelFormat *formats = supportedPixelFormats(codecContext, codec);
+    const AVPixelFormat matchedFormat =
+        matchSourcePixelFormat(formats, srcFormat);
+    passthrough = matchedFormat != AV_PIX_FMT_NONE;
+    codecContext->pix_fmt = passthrough
+                                ? matchedFormat
+                                : pickConvertPixelFormat(formats, srcFormat);
+    if (codecContext->pix_fmt == AV_PIX_FMT_NONE)
+        throw std::runtime_error("No usable pixel format for encoder: " +
+                                 settings.codec);
+    codecContext->gop_size = std::max(
+        1, static_cast<int>(std::lround(settings.segmentSeconds *
+                                        static_cast<float>(settings.fps))));
+    if (settings.closedGop)
+        codecContext->flags |= AV_CODEC_FLAG_CLOSED_GOP;
 
     // Some containers require extradata in the stream header instead of
     // packets.
@@ -99,7 +276,7 @@ void FfmpegEncoder::open() {
     // Set the nominal frame rate used by muxers/readers.
     stream->r_frame_rate = codecContext->framerate;
 
-    // We always write to a file, but just keep this anyway...
+    // The HLS and segment muxers open (and close) their own files.
     if (!(formatContext->oformat->flags & AVFMT_NOFILE)) {
         err = avio_open(&formatContext->pb, settings.outputPath.c_str(),
                         AVIO_FLAG_WRITE);
@@ -108,10 +285,24 @@ void FfmpegEncoder::open() {
                                      ffmpegErrStr(err));
     }
 
+    // Fragments go to disk as soon as the muxer emits them rather than
+    // sitting in the IO buffer.
+    if (settings.mux == MuxMode::Fragmented)
+        formatContext->flags |= AVFMT_FLAG_FLUSH_PACKETS;
+
     // Write container header and muxer metadata to the output sink.
     // MP4: writes ftyp + moov boxes (initial container metadata) before mdat.
-    //      [ ftyp ][ moov ][ mdat ] ... (unless fragmented MP4)
-    err = avformat_write_header(formatContext, nullptr);
+    //      [ ftyp ][ moov ][ mdat ] ... (unless fragmented MP4:
+    //      [ ftyp ][ empty moov ][ moof ][ mdat ][ moof ][ mdat ] ...)
+    AVDictionary *options = muxerOptions(settings);
+    err = avformat_write_header(formatContext, &options);
+    // Whatever is left wasn't recognised by the chosen muxer (e.g. movflags
+    // on a .mkv output).
+    const AVDictionaryEntry *unused = nullptr;
+    while ((unused = av_dict_get(options, "", unused, AV_DICT_IGNORE_SUFFIX)))
+        spdlog::warn("FFmpeg muxer ignored option {}={}", unused->key,
+                     unused->value);
+    av_dict_free(&options);
     if (err < 0)
         throw std::runtime_error("Failed to write header: " +
                                  ffmpegErrStr(err));
@@ -156,16 +347,28 @@ void FfmpegEncoder::open() {
     srcFrame = av_frame_alloc();
     if (!srcFrame)
         throw std::runtime_error("Failed to allocate source frame");
-    srcFrame->format = srcFormat;
+    // Passthrough frames may go to the encoder as-is (zero-copy), so carry
+    // its format (same memory layout, possibly without alpha).
+    srcFrame->format = passthrough ? codecContext->pix_fmt : srcFormat;
     srcFrame->width = width;
     srcFrame->height = height;
-
-    // Create a colorspace/format conversion context for src -> encoder format.
-    swsContext = sws_getContext(width, height, srcFormat, width, height,
-                                codecContext->pix_fmt, SWS_BICUBIC, nullptr,
-                                nullptr, nullptr);
-    if (!swsContext)
-        throw std::runtime_error("Failed to create sws context");
+    srcFrameBytes =
+        av_pix_fmt_count_planes(srcFormat) > 1
+            ? static_cast<size_t>(av_image_get_buffer_size(srcFormat, width,
+                                                           height, 1))
+            : static_cast<size_t>(srcStride) * static_cast<size_t>(height);
+
+    // Create the colorspace/format conversion for src -> encoder format.
+    if (!passthrough) {
+        const int threads =
+            resolveConvertThreads(settings.convertThreads, height);
+        converter = std::make_unique<FrameConverter>(
+            width, height, srcFormat, codecContext->pix_fmt, threads);
+        spdlog::debug("FFmpeg color conversion on {} thread(s)", threads);
+    }
+    spdlog::info("FFmpeg input {} -> {} ({})", av_get_pix_fmt_name(srcFormat),
+                 av_get_pix_fmt_name(codecContext->pix_fmt),
+                 passthrough ? "passed through" : "converted");
 
     packet = av_packet_alloc();
     if (!packet)
@@ -177,24 +380,102 @@ void FfmpegEncoder::open() {
 void FfmpegEncoder::encodeFrame(const uint8_t *srcData, int64_t frameIndex) {
     if (!opened)
         throw std::runtime_error("FFmpeg encoder not opened");
+    frameTimings = {};
+
+    if (av_pix_fmt_count_planes(srcFormat) > 1) {
+        // Tightly packed planes back to back (Y, then U/V or UV).
+        int err = av_image_fill_arrays(srcFrame->data, srcFrame->linesize,
+                                       srcData, srcFormat, width, height, 1);
+        if (err < 0)
+            throw std::runtime_error("Failed to map source planes: " +
+                                     ffmpegErrStr(err));
+    } else {
+        srcFrame->data[0] = const_cast<uint8_t *>(srcData);
+        srcFrame->linesize[0] = srcStride;
+    }
+
+    if (zeroCopy) {
+        // Hand the encoder the caller's memory directly. The buffer must be
+        // refcounted for avcodec_send_frame to reference rather than copy
+        // it; dropping our reference afterwards frees nothing.
+        srcFrame->buf[0] = borrowBuffer(srcData, srcFrameBytes);
+        if (!srcFrame->buf[0])
+            throw std::runtime_error("Failed to wrap source frame");
+        srcFrame->pts = frameIndex;
+        srcFrame->duration = 1;
+        try {
+            sendFrame(srcFrame);
+        } catch (...) {
+            av_buffer_unref(&srcFrame->buf[0]);
+            throw;
+        }
+        // The probe frame said the encoder lets go of its input, so this
+        // shouldn't happen; stop lending memory the caller will reuse.
+        if (encoderHoldsFrame(srcFrame)) {
+            spdlog::warn("FFmpeg encoder kept a reference to frame {}; "
+                         "copying frames from now on",
+                         frameIndex);
+            zeroCopy = false;
+        }
+        av_buffer_unref(&srcFrame->buf[0]);
+        return;
+    }
 
-    srcFrame->data[0] = const_cast<uint8_t *>(srcData);
-    srcFrame->linesize[0] = srcStride;
+    const auto convertStart = Clock::now();
+    // The encoder may still hold a reference to the previous frame buffer.
+    int err = av_frame_make_writable(dstFrame);
+    if (err < 0)
+        throw std::runtime_error("Failed to make frame writable: " +
+                                 ffmpegErrStr(err));
 
     // Convert/copy into the destination frame in the encoder's pixel format.
-    sws_scale(swsContext, srcFrame->data, srcFrame->linesize, 0, height,
-              dstFrame->data, dstFrame->linesize);
+    if (passthrough) {
+        av_image_copy(dstFrame->data, dstFrame->linesize,
+                      const_cast<const uint8_t **>(srcFrame->data),
+                      srcFrame->linesize, srcFormat, width, height);
+    } else {
+        // swscale copies a source it can't reference before converting.
+        srcFrame->buf[0] = borrowBuffer(srcData, srcFrameBytes);
+        if (!srcFrame->buf[0])
+            throw std::runtime_error("Failed to wrap source frame");
+        try {
+            converter->convert(srcFrame, dstFrame);
+        } catch (...) {
+            av_buffer_unref(&srcFrame->buf[0]);
+            throw;
+        }
+        av_buffer_unref(&srcFrame->buf[0]);
+    }
+    frameTimings.convertMs = elapsedMs(convertStart);
 
     // PTS in stream timebase units; duration set to one frame.
     dstFrame->pts = frameIndex;
     dstFrame->duration = 1;
+    sendFrame(dstFrame);
+
+    // The first passthrough frame is copied to see whether the encoder
+    // keeps input frames. One that is done with them once its packets are
+    // drained can read later frames straight from the caller's memory.
+    if (passthrough && !zeroCopyProbed) {
+        zeroCopyProbed = true;
+        zeroCopy = !encoderHoldsFrame(dstFrame);
+        if (zeroCopy)
+            spdlog::info("FFmpeg encoder releases its input; passing frames "
+                         "through zero-copy");
+    }
+}
 
+void FfmpegEncoder::sendFrame(AVFrame *frame) {
     // Push one frame into the encoder; it may output 0..N packets.
-    int err = avcodec_send_frame(codecContext, dstFrame);
+    const auto sendStart = Clock::now();
+    int err = avcodec_send_frame(codecContext, frame);
+    frameTimings.sendMs = elapsedMs(sendStart);
     if (err < 0)
         throw std::runtime_error("Failed to send frame: " + ffmpegErrStr(err));
 
     // Drain all packets produced for the submitted frame.
+    const auto receiveStart = Clock::now();
+    const double muxMsBefore = frameTimings.muxMs;
     while (true) {
         err = avcodec_receive_packet(codecContext, packet);
         if (err == AVERROR(EAGAIN) || err == AVERROR_EOF)
@@ -206,6 +487,9 @@ void FfmpegEncoder::encodeFrame(const uint8_t *srcData, int64_t frameIndex) {
         writePacket(packet);
         av_packet_unref(packet);
     }
+    // Muxing happens inside the drain loop but is reported on its own.
+    frameTimings.receiveMs =
+        elapsedMs(receiveStart) - (frameTimings.muxMs - muxMsBefore);
 }
 
 void FfmpegEncoder::flush() {
@@ -246,10 +530,7 @@ void FfmpegEncoder::close() noexcept {
         av_frame_free(&srcFrame);
     if (packet)
         av_packet_free(&packet);
-    if (swsContext) {
-        sws_freeContext(swsContext);
-        swsContext = nullptr;
-    }
+    converter.reset();
     if (codecContext)
         avcodec_free_context(&codecContext);
     if (formatContext) {
@@ -266,7 +547,9 @@ void FfmpegEncoder::writePacket(AVPacket *packet) {
     // Rescale from codec timebase to stream timebase before muxing.
     av_packet_rescale_ts(packet, codecContext->time_base, stream->time_base);
     packet->stream_index = stream->index;
+    const auto muxStart = Clock::now();
     int err = av_interleaved_write_frame(formatContext, packet);
+    frameTimings.muxMs += elapsedMs(muxStart);
     if (err < 0)
         throw std::runtime_error("Failed to write packet: " +
                                  ffmpegErrStr(err));
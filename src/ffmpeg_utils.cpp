@@ -2,12 +2,65 @@
 
 #include <spdlog/fmt/fmt.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavutil/version.h>
 }
 
 namespace ffmpeg_utils {
+namespace {
+std::string ffmpegErrStr(int err) {
+    char buf[AV_ERROR_MAX_STRING_SIZE];
+    av_strerror(err, buf, sizeof(buf));
+    return std::string(buf);
+}
+
+struct InputGuard {
+    AVFormatContext *ctx = nullptr;
+    ~InputGuard() { avformat_close_input(&ctx); }
+};
+
+struct OutputGuard {
+    AVFormatContext *ctx = nullptr;
+    ~OutputGuard() {
+        if (!ctx)
+            return;
+        if (!(ctx->oformat->flags & AVFMT_NOFILE))
+            avio_closep(&ctx->pb);
+        avformat_free_context(ctx);
+    }
+};
+
+struct PacketGuard {
+    AVPacket *packet = av_packet_alloc();
+    ~PacketGuard() { av_packet_free(&packet); }
+};
+
+int findVideoStream(AVFormatContext *ctx, const std::string &path) {
+    const int index =
+        av_find_best_stream(ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (index < 0)
+        throw std::runtime_error("No video stream in segment: " + path);
+    return index;
+}
+
+void openInput(InputGuard &input, const std::string &path) {
+    int err =
+        avformat_open_input(&input.ctx, path.c_str(), nullptr, nullptr);
+    if (err < 0)
+        throw std::runtime_error("Failed to open segment " + path + ": " +
+                                 ffmpegErrStr(err));
+    err = avformat_find_stream_info(input.ctx, nullptr);
+    if (err < 0)
+        throw std::runtime_error("Failed to read segment " + path + ": " +
+                                 ffmpegErrStr(err));
+}
+} // namespace
+
 std::string getLibavformatVersion() {
     unsigned ver = avformat_version();
     unsigned major = AV_VERSION_MAJOR(ver);
@@ -15,4 +68,128 @@ std::string getLibavformatVersion() {
     unsigned micro = AV_VERSION_MICRO(ver);
     return fmt::format("libavformat {}.{}.{}", major, minor, micro);
 }
+
+void concatSegments(const std::vector<std::string> &segmentPaths,
+                    const std::string &outputPath) {
+    if (segmentPaths.empty())
+        throw std::runtime_error("No segments to join");
+
+    OutputGuard output;
+    int err = avformat_alloc_output_context2(&output.ctx, nullptr, nullptr,
+                                             outputPath.c_str());
+    if (err < 0 || !output.ctx)
+        throw std::runtime_error("Failed to create output context: " +
+                                 ffmpegErrStr(err));
+    PacketGuard packet;
+    if (!packet.packet)
+        throw std::runtime_error("Failed to allocate packet");
+
+    AVStream *outStream = nullptr;
+    // Shift applied to the current segment, in the output time base.
+    int64_t offset = 0;
+    int64_t lastDts = AV_NOPTS_VALUE;
+
+    for (const std::string &path : segmentPaths) {
+        InputGuard input;
+        openInput(input, path);
+        const int streamIndex = findVideoStream(input.ctx, path);
+        AVStream *inStream = input.ctx->streams[streamIndex];
+
+        if (!outStream) {
+            // The first segment defines the output stream; the others
+            // were encoded with the same settings.
+            outStream = avformat_new_stream(output.ctx, nullptr);
+            if (!outStream)
+                throw std::runtime_error("Failed to create output stream");
+            err = avcodec_parameters_copy(outStream->codecpar,
+                                          inStream->codecpar);
+            if (err < 0)
+                throw std::runtime_error("Failed to copy stream params: " +
+                                         ffmpegErrStr(err));
+            // Let the muxer pick a tag valid for its container.
+            outStream->codecpar->codec_tag = 0;
+            outStream->time_base = inStream->time_base;
+            outStream->avg_frame_rate = inStream->avg_frame_rate;
+            outStream->r_frame_rate = inStream->r_frame_rate;
+
+            if (!(output.ctx->oformat->flags & AVFMT_NOFILE)) {
+                err = avio_open(&output.ctx->pb, outputPath.c_str(),
+                                AVIO_FLAG_WRITE);
+                if (err < 0)
+                    throw std::runtime_error("Failed to open output: " +
+                                             ffmpegErrStr(err));
+            }
+            err = avformat_write_header(output.ctx, nullptr);
+            if (err < 0)
+                throw std::runtime_error("Failed to write header: " +
+                                         ffmpegErrStr(err));
+        } else if (inStream->codecpar->codec_id !=
+                       outStream->codecpar->codec_id ||
+                   inStream->codecpar->width != outStream->codecpar->width ||
+                   inStream->codecpar->height !=
+                       outStream->codecpar->height) {
+            throw std::runtime_error("Segment does not match the first "
+                                     "segment's stream: " +
+                                     path);
+        }
+
+        // The muxer may have changed the time base in write_header.
+        const AVRational outTimeBase = outStream->time_base;
+        // Fallback for containers that don't store packet durations.
+        const int64_t frameDuration =
+            inStream->avg_frame_rate.num > 0
+                ? av_rescale_q(1, av_inv_q(inStream->avg_frame_rate),
+                               outTimeBase)
+                : 1;
+        int64_t segmentStart = AV_NOPTS_VALUE;
+        int64_t segmentEnd = 0;
+        while ((err = av_read_frame(input.ctx, packet.packet)) >= 0) {
+            if (packet.packet->stream_index != streamIndex) {
+                av_packet_unref(packet.packet);
+                continue;
+            }
+            av_packet_rescale_ts(packet.packet, inStream->time_base,
+                                 outTimeBase);
+            // Segments normally start at 0, but rebase in case a muxer
+            // shifted them (e.g. negative DTS with B-frames).
+            if (segmentStart == AV_NOPTS_VALUE)
+                segmentStart = packet.packet->pts != AV_NOPTS_VALUE
+                                   ? std::min<int64_t>(packet.packet->pts, 0)
+                                   : 0;
+            if (packet.packet->pts != AV_NOPTS_VALUE) {
+                const int64_t duration = packet.packet->duration > 0
+                                             ? packet.packet->duration
+                                             : frameDuration;
+                segmentEnd = std::max(segmentEnd, packet.packet->pts -
+                                                      segmentStart + duration);
+                packet.packet->pts += offset - segmentStart;
+            }
+            if (packet.packet->dts != AV_NOPTS_VALUE) {
+                packet.packet->dts += offset - segmentStart;
+                if (lastDts != AV_NOPTS_VALUE && packet.packet->dts <= lastDts)
+                    packet.packet->dts = lastDts + 1;
+                if (packet.packet->pts != AV_NOPTS_VALUE &&
+                    packet.packet->dts > packet.packet->pts)
+                    throw std::runtime_error(
+                        "Segments overlap in time, cannot join: " + path);
+                lastDts = packet.packet->dts;
+            }
+            packet.packet->stream_index = outStream->index;
+            packet.packet->pos = -1;
+            err = av_interleaved_write_frame(output.ctx, packet.packet);
+            if (err < 0)
+                throw std::runtime_error("Failed to write packet: " +
+                                         ffmpegErrStr(err));
+        }
+        if (err != AVERROR_EOF)
+            throw std::runtime_error("Failed to read segment " + path + ": " +
+                                     ffmpegErrStr(err));
+        offset += segmentEnd;
+    }
+
+    err = av_write_trailer(output.ctx);
+    if (err < 0)
+        throw std::runtime_error("Failed to write trailer: " +
+                                 ffmpegErrStr(err));
+}
 } // namespace ffmpeg_utils
@@ -0,0 +1,71 @@
+#include "frame_converter.h"
+
+#include <stdexcept>
+#include <string>
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/opt.h>
+}
+
+// sws_scale_frame and the threads option came with FFmpeg 5.0; older
+// builds convert on the calling thread.
+#if LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 1, 100)
+#define VSDF_SWS_SLICE_THREADS 1
+#else
+#define VSDF_SWS_SLICE_THREADS 0
+#endif
+
+namespace ffmpeg_utils {
+namespace {
+std::string ffmpegErrStr(int err) {
+    char buf[AV_ERROR_MAX_STRING_SIZE];
+    av_strerror(err, buf, sizeof(buf));
+    return std::string(buf);
+}
+} // namespace
+
+FrameConverter::FrameConverter(int width, int height, AVPixelFormat srcFormat,
+                               AVPixelFormat dstFormat, int threads) {
+#if VSDF_SWS_SLICE_THREADS
+    swsContext = sws_alloc_context();
+    if (!swsContext)
+        throw std::runtime_error("Failed to allocate sws context");
+    av_opt_set_int(swsContext, "srcw", width, 0);
+    av_opt_set_int(swsContext, "srch", height, 0);
+    av_opt_set_int(swsContext, "src_format", srcFormat, 0);
+    av_opt_set_int(swsContext, "dstw", width, 0);
+    av_opt_set_int(swsContext, "dsth", height, 0);
+    av_opt_set_int(swsContext, "dst_format", dstFormat, 0);
+    av_opt_set_int(swsContext, "sws_flags", SWS_BICUBIC, 0);
+    av_opt_set_int(swsContext, "threads", threads, 0);
+    const int err = sws_init_context(swsContext, nullptr, nullptr);
+    if (err < 0) {
+        sws_freeContext(swsContext);
+        throw std::runtime_error("Failed to create sws context: " +
+                                 ffmpegErrStr(err));
+    }
+#else
+    (void)threads;
+    swsContext = sws_getContext(width, height, srcFormat, width, height,
+                                dstFormat, SWS_BICUBIC, nullptr, nullptr,
+                                nullptr);
+    if (!swsContext)
+        throw std::runtime_error("Failed to create sws context");
+#endif
+}
+
+FrameConverter::~FrameConverter() { sws_freeContext(swsContext); }
+
+void FrameConverter::convert(const AVFrame *src, AVFrame *dst) {
+#if VSDF_SWS_SLICE_THREADS
+    const int err = sws_scale_frame(swsContext, dst, src);
+#else
+    const int err = sws_scale(swsContext, src->data, src->linesize, 0,
+                              src->height, dst->data, dst->linesize);
+#endif
+    if (err < 0)
+        throw std::runtime_error("Failed to convert frame: " +
+                                 ffmpegErrStr(err));
+}
+} // namespace ffmpeg_utils
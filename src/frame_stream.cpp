@@ -0,0 +1,150 @@
+#include "frame_stream.h"
+
+#include <spdlog/fmt/fmt.h>
+
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(_WIN32)
+#include <algorithm>
+#include <fcntl.h>
+#include <io.h>
+#include <stdio.h>
+#else
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace frame_stream {
+namespace {
+constexpr char Y4M_FRAME[] = "FRAME\n";
+
+[[noreturn]] void throwWriteError(int err) {
+    if (err == EPIPE)
+        throw std::runtime_error("Frame stream reader closed the pipe");
+    throw std::runtime_error(fmt::format("Frame stream write failed: {}",
+                                         std::generic_category().message(err)));
+}
+} // namespace
+
+std::optional<Format> parseFormat(std::string_view name) {
+    if (name == "y4m")
+        return Format::Y4M;
+    if (name == "raw")
+        return Format::Raw;
+    return std::nullopt;
+}
+
+std::string y4mHeader(uint32_t width, uint32_t height, int fps) {
+    return fmt::format("YUV4MPEG2 W{} H{} F{}:1 Ip A1:1 C420jpeg "
+                       "XCOLORRANGE=LIMITED\n",
+                       width, height, fps);
+}
+
+FrameStreamWriter::FrameStreamWriter(const Settings &settings,
+                                     uint32_t width, uint32_t height, int fps)
+    : format(settings.format) {
+#if defined(_WIN32)
+    if (settings.path == "-") {
+        fd = _fileno(stdout);
+        _setmode(fd, _O_BINARY);
+    } else {
+        fd = _open(settings.path.c_str(),
+                   _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+        ownsFd = true;
+    }
+#else
+    if (settings.path == "-") {
+        fd = STDOUT_FILENO;
+    } else {
+        // Blocks until the other end of a FIFO is opened for reading.
+        fd = ::open(settings.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                    0644);
+        ownsFd = true;
+    }
+#endif
+    if (fd < 0) {
+        throw std::runtime_error(
+            fmt::format("Failed to open frame stream {}: {}", settings.path,
+                        std::generic_category().message(errno)));
+    }
+
+    if (format == Format::Y4M) {
+        const std::string header = y4mHeader(width, height, fps);
+        writeAll(reinterpret_cast<const uint8_t *>(header.data()),
+                 header.size(), nullptr, 0);
+    }
+}
+
+FrameStreamWriter::~FrameStreamWriter() {
+    if (ownsFd && fd >= 0) {
+#if defined(_WIN32)
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+    }
+}
+
+void FrameStreamWriter::writeFrame(const uint8_t *data, size_t size) {
+    if (format == Format::Y4M) {
+        writeAll(reinterpret_cast<const uint8_t *>(Y4M_FRAME),
+                 sizeof(Y4M_FRAME) - 1, data, size);
+    } else {
+        writeAll(nullptr, 0, data, size);
+    }
+}
+
+void FrameStreamWriter::writeAll(const uint8_t *header, size_t headerSize,
+                                 const uint8_t *data, size_t size) {
+#if defined(_WIN32)
+    const auto writeBuffer = [this](const uint8_t *buffer, size_t bytes) {
+        while (bytes > 0) {
+            const unsigned int chunk = static_cast<unsigned int>(
+                std::min<size_t>(bytes, 1u << 30));
+            const int written = _write(fd, buffer, chunk);
+            if (written < 0)
+                throwWriteError(errno);
+            buffer += written;
+            bytes -= static_cast<size_t>(written);
+        }
+    };
+    writeBuffer(header, headerSize);
+    writeBuffer(data, size);
+#else
+    // One writev for marker + frame; pipes accept partial writes, so
+    // advance through the iovecs until everything is out.
+    iovec iov[2] = {
+        {const_cast<uint8_t *>(header), headerSize},
+        {const_cast<uint8_t *>(data), size},
+    };
+    iovec *next = iov;
+    int count = 2;
+    while (count > 0) {
+        if (next->iov_len == 0) {
+            ++next;
+            --count;
+            continue;
+        }
+        const ssize_t written = ::writev(fd, next, count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            throwWriteError(errno);
+        }
+        size_t remaining = static_cast<size_t>(written);
+        while (count > 0 && remaining >= next->iov_len) {
+            remaining -= next->iov_len;
+            ++next;
+            --count;
+        }
+        if (count > 0) {
+            next->iov_base = static_cast<uint8_t *>(next->iov_base) + remaining;
+            next->iov_len -= remaining;
+        }
+    }
+#endif
+}
+} // namespace frame_stream
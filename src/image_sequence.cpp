@@ -0,0 +1,361 @@
+#include "image_sequence.h"
+
+#include <spdlog/fmt/fmt.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace image_sequence {
+namespace {
+constexpr uint32_t BYTES_PER_PIXEL = 4;
+// zlib's fast deflate levels (1-3) keep PNG compression from becoming the
+// bottleneck; smooth SDF renders still compress well with the Sub filter.
+constexpr int PNG_DEFLATE_LEVEL = 3;
+
+void appendBE32(std::vector<uint8_t> &out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void patchBE32(std::vector<uint8_t> &out, size_t offset, uint32_t value) {
+    out[offset] = static_cast<uint8_t>(value >> 24);
+    out[offset + 1] = static_cast<uint8_t>(value >> 16);
+    out[offset + 2] = static_cast<uint8_t>(value >> 8);
+    out[offset + 3] = static_cast<uint8_t>(value);
+}
+
+// Appends the length placeholder and type of a PNG chunk and returns the
+// offset of its length field for endChunk.
+size_t beginChunk(std::vector<uint8_t> &out, const char (&type)[5]) {
+    const size_t offset = out.size();
+    appendBE32(out, 0);
+    out.insert(out.end(), type, type + 4);
+    return offset;
+}
+
+// Patches the chunk length and appends the CRC of its type and data.
+void endChunk(std::vector<uint8_t> &out, size_t offset) {
+    const size_t dataStart = offset + 8;
+    const size_t length = out.size() - dataStart;
+    if (length > 0x7fffffffu)
+        throw std::runtime_error("PNG chunk is too large");
+    patchBE32(out, offset, static_cast<uint32_t>(length));
+    const uLong crc = crc32(crc32(0, Z_NULL, 0), out.data() + offset + 4,
+                            static_cast<uInt>(length + 4));
+    appendBE32(out, static_cast<uint32_t>(crc));
+}
+} // namespace
+
+std::optional<Format> parseFormat(std::string_view name) {
+    if (name == "png")
+        return Format::PNG;
+    if (name == "qoi")
+        return Format::QOI;
+    if (name == "raw")
+        return Format::Raw;
+    return std::nullopt;
+}
+
+std::string_view extension(Format format) {
+    switch (format) {
+    case Format::PNG:
+        return ".png";
+    case Format::QOI:
+        return ".qoi";
+    case Format::Raw:
+        return ".rgba";
+    }
+    return "";
+}
+
+std::filesystem::path framePath(const std::filesystem::path &outputDir,
+                                uint32_t frameIndex, Format format) {
+    return outputDir /
+           fmt::format("frame_{:06}{}", frameIndex, extension(format));
+}
+
+void encodePNG(const uint8_t *rgba, uint32_t width, uint32_t height,
+               std::vector<uint8_t> &out) {
+    static constexpr std::array<uint8_t, 8> SIGNATURE = {
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    out.assign(SIGNATURE.begin(), SIGNATURE.end());
+
+    size_t chunk = beginChunk(out, "IHDR");
+    appendBE32(out, width);
+    appendBE32(out, height);
+    // 8-bit RGBA, deflate, adaptive filtering, no interlace.
+    out.insert(out.end(), {8, 6, 0, 0, 0});
+    endChunk(out, chunk);
+
+    // One IDAT holding the whole zlib stream. Every row uses the Sub
+    // filter (each byte minus the same channel of the pixel to its left).
+    const size_t rowBytes = static_cast<size_t>(width) * BYTES_PER_PIXEL;
+    const size_t filteredBytes = (rowBytes + 1) * height;
+    z_stream stream{};
+    if (deflateInit(&stream, PNG_DEFLATE_LEVEL) != Z_OK)
+        throw std::runtime_error("deflateInit failed");
+    chunk = beginChunk(out, "IDAT");
+    const size_t idatStart = out.size();
+    out.resize(idatStart + deflateBound(&stream, static_cast<uLong>(
+                                                     filteredBytes)));
+    stream.next_out = out.data() + idatStart;
+    stream.avail_out = static_cast<uInt>(out.size() - idatStart);
+
+    std::vector<uint8_t> filtered(rowBytes + 1);
+    filtered[0] = 1; // Sub
+    int rc = Z_OK;
+    for (uint32_t y = 0; y < height && rc == Z_OK; ++y) {
+        const uint8_t *row = rgba + y * rowBytes;
+        std::memcpy(filtered.data() + 1, row,
+                    std::min<size_t>(rowBytes, BYTES_PER_PIXEL));
+        for (size_t i = BYTES_PER_PIXEL; i < rowBytes; ++i) {
+            filtered[i + 1] =
+                static_cast<uint8_t>(row[i] - row[i - BYTES_PER_PIXEL]);
+        }
+        stream.next_in = filtered.data();
+        stream.avail_in = static_cast<uInt>(filtered.size());
+        rc = deflate(&stream, y + 1 == height ? Z_FINISH : Z_NO_FLUSH);
+    }
+    if (height == 0)
+        rc = deflate(&stream, Z_FINISH);
+    const size_t compressed = stream.total_out;
+    deflateEnd(&stream);
+    if (rc != Z_STREAM_END)
+        throw std::runtime_error("PNG deflate failed");
+    out.resize(idatStart + compressed);
+    endChunk(out, chunk);
+
+    chunk = beginChunk(out, "IEND");
+    endChunk(out, chunk);
+}
+
+void encodeQOI(const uint8_t *rgba, uint32_t width, uint32_t height,
+               std::vector<uint8_t> &out) {
+    // https://qoiformat.org/qoi-specification.pdf
+    constexpr uint8_t OP_INDEX = 0x00;
+    constexpr uint8_t OP_DIFF = 0x40;
+    constexpr uint8_t OP_LUMA = 0x80;
+    constexpr uint8_t OP_RUN = 0xc0;
+    constexpr uint8_t OP_RGB = 0xfe;
+    constexpr uint8_t OP_RGBA = 0xff;
+    struct Pixel {
+        uint8_t r = 0, g = 0, b = 0, a = 0;
+        bool operator==(const Pixel &) const = default;
+    };
+
+    out.clear();
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    // Worst case is OP_RGBA for every pixel.
+    out.reserve(14 + pixelCount * 5 + 8);
+    out.insert(out.end(), {'q', 'o', 'i', 'f'});
+    appendBE32(out, width);
+    appendBE32(out, height);
+    out.push_back(4); // RGBA
+    out.push_back(0); // sRGB with linear alpha
+
+    std::array<Pixel, 64> seen{};
+    Pixel prev{0, 0, 0, 255};
+    uint8_t run = 0;
+    for (size_t i = 0; i < pixelCount; ++i) {
+        const uint8_t *p = rgba + i * BYTES_PER_PIXEL;
+        const Pixel px{p[0], p[1], p[2], p[3]};
+        if (px == prev) {
+            ++run;
+            if (run == 62 || i + 1 == pixelCount) {
+                out.push_back(static_cast<uint8_t>(OP_RUN | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            out.push_back(static_cast<uint8_t>(OP_RUN | (run - 1)));
+            run = 0;
+        }
+
+        const uint8_t hash = static_cast<uint8_t>(
+            (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64);
+        if (seen[hash] == px) {
+            out.push_back(static_cast<uint8_t>(OP_INDEX | hash));
+        } else {
+            seen[hash] = px;
+            if (px.a == prev.a) {
+                // Channel differences wrap around, as in the spec.
+                const auto dr = static_cast<int8_t>(px.r - prev.r);
+                const auto dg = static_cast<int8_t>(px.g - prev.g);
+                const auto db = static_cast<int8_t>(px.b - prev.b);
+                const int drg = dr - dg;
+                const int dbg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 &&
+                    db <= 1) {
+                    out.push_back(static_cast<uint8_t>(
+                        OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                } else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 &&
+                           dbg >= -8 && dbg <= 7) {
+                    out.push_back(static_cast<uint8_t>(OP_LUMA | (dg + 32)));
+                    out.push_back(
+                        static_cast<uint8_t>((drg + 8) << 4 | (dbg + 8)));
+                } else {
+                    out.insert(out.end(), {OP_RGB, px.r, px.g, px.b});
+                }
+            } else {
+                out.insert(out.end(), {OP_RGBA, px.r, px.g, px.b, px.a});
+            }
+        }
+        prev = px;
+    }
+    out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+}
+
+ImageSequenceWriter::ImageSequenceWriter(Settings writerSettings,
+                                         uint32_t frameWidth,
+                                         uint32_t frameHeight, bool bgra)
+    : settings(std::move(writerSettings)), width(frameWidth),
+      height(frameHeight), swapRB(bgra) {
+    if (width == 0 || height == 0)
+        throw std::runtime_error("Invalid image sequence frame size");
+    std::filesystem::create_directories(settings.outputDir);
+
+    const uint32_t threads =
+        settings.threads > 0
+            ? settings.threads
+            : std::max(1u, std::thread::hardware_concurrency());
+    const uint32_t maxInFlight =
+        settings.maxInFlight > 0 ? settings.maxInFlight : threads * 2;
+    // Frame buffers are sized on first use.
+    buffers.resize(maxInFlight);
+    for (size_t i = maxInFlight; i > 0; --i)
+        freeBuffers.push_back(i - 1);
+
+    workers.reserve(threads);
+    for (uint32_t i = 0; i < threads; ++i)
+        workers.emplace_back([this] { workerLoop(); });
+}
+
+ImageSequenceWriter::~ImageSequenceWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobCv.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+}
+
+void ImageSequenceWriter::write(const uint8_t *src, uint32_t stride,
+                                uint32_t frameIndex) {
+    size_t index = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        bufferCv.wait(lock,
+                      [this] { return error || !freeBuffers.empty(); });
+        rethrowError();
+        index = freeBuffers.back();
+        freeBuffers.pop_back();
+    }
+
+    // The buffer is ours until its job finishes, so copy without the lock.
+    const size_t rowBytes = static_cast<size_t>(width) * BYTES_PER_PIXEL;
+    std::vector<uint8_t> &buffer = buffers[index];
+    buffer.resize(rowBytes * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        std::memcpy(buffer.data() + y * rowBytes,
+                    src + static_cast<size_t>(y) * stride, rowBytes);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(Job{index, frameIndex});
+    }
+    jobCv.notify_one();
+}
+
+void ImageSequenceWriter::finish() {
+    std::unique_lock<std::mutex> lock(mutex);
+    bufferCv.wait(lock, [this] { return jobs.empty() && busyJobs == 0; });
+    rethrowError();
+}
+
+void ImageSequenceWriter::rethrowError() {
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void ImageSequenceWriter::workerLoop() {
+    // Reused across frames so steady state doesn't allocate.
+    std::vector<uint8_t> encoded;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        jobCv.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty())
+            return;
+        const Job job = jobs.front();
+        jobs.pop_front();
+        ++busyJobs;
+        lock.unlock();
+
+        std::exception_ptr jobError;
+        try {
+            writeFrame(buffers[job.buffer], job.frameIndex, encoded);
+        } catch (...) {
+            jobError = std::current_exception();
+        }
+
+        lock.lock();
+        if (jobError && !error)
+            error = jobError;
+        --busyJobs;
+        freeBuffers.push_back(job.buffer);
+        bufferCv.notify_all();
+    }
+}
+
+void ImageSequenceWriter::writeFrame(std::vector<uint8_t> &pixels,
+                                     uint32_t frameIndex,
+                                     std::vector<uint8_t> &encoded) const {
+    if (swapRB) {
+        for (size_t i = 0; i < pixels.size(); i += BYTES_PER_PIXEL)
+            std::swap(pixels[i], pixels[i + 2]);
+    }
+
+    const std::vector<uint8_t> *data = &pixels;
+    switch (settings.format) {
+    case Format::PNG:
+        encodePNG(pixels.data(), width, height, encoded);
+        data = &encoded;
+        break;
+    case Format::QOI:
+        encodeQOI(pixels.data(), width, height, encoded);
+        data = &encoded;
+        break;
+    case Format::Raw:
+        break;
+    }
+
+    // Write then rename so readers never see a partial frame.
+    const std::filesystem::path path =
+        framePath(settings.outputDir, frameIndex, settings.format);
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Failed to open image output: " +
+                                     tmpPath.string());
+        }
+        out.write(reinterpret_cast<const char *>(data->data()),
+                  static_cast<std::streamsize>(data->size()));
+        if (!out) {
+            throw std::runtime_error("Failed to write image output: " +
+                                     tmpPath.string());
+        }
+    }
+    std::filesystem::rename(tmpPath, path);
+}
+} // namespace image_sequence
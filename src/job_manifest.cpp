@@ -0,0 +1,276 @@
+#include "job_manifest.h"
+
+#include <spdlog/fmt/fmt.h>
+
+#include <cctype>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+namespace job_manifest {
+namespace {
+struct Value {
+    enum class Kind { String, Integer, Bool };
+    Kind kind = Kind::String;
+    std::string text;
+    long long integer = 0;
+};
+
+class Parser {
+  public:
+    Parser(const std::filesystem::path &baseDir, const std::string &sourceName,
+           const ffmpeg_utils::EncodeSettings &encodeDefaults)
+        : baseDir(baseDir), sourceName(sourceName),
+          encodeDefaults(encodeDefaults) {}
+
+    std::vector<Job> parse(std::istream &in);
+
+  private:
+    [[noreturn]] void fail(const std::string &message) const {
+        throw std::runtime_error(
+            fmt::format("{}:{}: {}", sourceName, lineNumber, message));
+    }
+
+    Value parseValue(const std::string &text) const;
+    void apply(Job &job, const std::string &key, const Value &value) const;
+
+    std::string expectString(const std::string &key, const Value &value) const;
+    uint32_t expectPositive(const std::string &key, const Value &value) const;
+    int expectInt(const std::string &key, const Value &value) const;
+    bool expectBool(const std::string &key, const Value &value) const;
+
+    const std::filesystem::path &baseDir;
+    const std::string &sourceName;
+    const ffmpeg_utils::EncodeSettings &encodeDefaults;
+    size_t lineNumber = 0;
+};
+
+std::string trim(const std::string &text) {
+    const size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+        return {};
+    const size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+// Drops a # comment that isn't inside a quoted string.
+std::string stripComment(const std::string &text) {
+    bool quoted = false;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (quoted && text[i] == '\\') {
+            ++i;
+        } else if (text[i] == '"') {
+            quoted = !quoted;
+        } else if (!quoted && text[i] == '#') {
+            return text.substr(0, i);
+        }
+    }
+    return text;
+}
+
+bool isBareKey(const std::string &key) {
+    if (key.empty())
+        return false;
+    for (const char c : key) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' &&
+            c != '-')
+            return false;
+    }
+    return true;
+}
+
+Value Parser::parseValue(const std::string &text) const {
+    Value value;
+    if (text.empty())
+        fail("missing value");
+    if (text.front() == '"') {
+        value.kind = Value::Kind::String;
+        size_t i = 1;
+        for (; i < text.size() && text[i] != '"'; ++i) {
+            if (text[i] != '\\') {
+                value.text += text[i];
+                continue;
+            }
+            if (++i == text.size())
+                break;
+            switch (text[i]) {
+            case '"':
+            case '\\':
+                value.text += text[i];
+                break;
+            case 'n':
+                value.text += '\n';
+                break;
+            case 't':
+                value.text += '\t';
+                break;
+            default:
+                fail(fmt::format("unsupported escape \\{}", text[i]));
+            }
+        }
+        if (i >= text.size())
+            fail("unterminated string");
+        if (i + 1 != text.size())
+            fail("unexpected text after string");
+        return value;
+    }
+    if (text == "true" || text == "false") {
+        value.kind = Value::Kind::Bool;
+        value.integer = text == "true";
+        return value;
+    }
+    value.kind = Value::Kind::Integer;
+    try {
+        size_t used = 0;
+        value.integer = std::stoll(text, &used);
+        if (used != text.size())
+            throw std::invalid_argument(text);
+    } catch (const std::exception &) {
+        fail(fmt::format("invalid value {}", text));
+    }
+    return value;
+}
+
+std::string Parser::expectString(const std::string &key,
+                                 const Value &value) const {
+    if (value.kind != Value::Kind::String)
+        fail(fmt::format("{} must be a string", key));
+    if (value.text.empty())
+        fail(fmt::format("{} must not be empty", key));
+    return value.text;
+}
+
+uint32_t Parser::expectPositive(const std::string &key,
+                                const Value &value) const {
+    if (value.kind != Value::Kind::Integer || value.integer <= 0 ||
+        value.integer > std::numeric_limits<int>::max())
+        fail(fmt::format("{} must be a positive integer", key));
+    return static_cast<uint32_t>(value.integer);
+}
+
+int Parser::expectInt(const std::string &key, const Value &value) const {
+    if (value.kind != Value::Kind::Integer || value.integer < 0 ||
+        value.integer > std::numeric_limits<int>::max())
+        fail(fmt::format("{} must be a non-negative integer", key));
+    return static_cast<int>(value.integer);
+}
+
+bool Parser::expectBool(const std::string &key, const Value &value) const {
+    if (value.kind != Value::Kind::Bool)
+        fail(fmt::format("{} must be true or false", key));
+    return value.integer != 0;
+}
+
+void Parser::apply(Job &job, const std::string &key,
+                   const Value &value) const {
+    if (key == "name") {
+        job.name = expectString(key, value);
+    } else if (key == "shader") {
+        job.shader = baseDir / expectString(key, value);
+    } else if (key == "toy") {
+        job.toy = expectBool(key, value);
+    } else if (key == "width") {
+        job.width = expectPositive(key, value);
+    } else if (key == "height") {
+        job.height = expectPositive(key, value);
+    } else if (key == "frames") {
+        job.frames = expectPositive(key, value);
+    } else if (key == "output") {
+        job.encode.outputPath = (baseDir / expectString(key, value)).string();
+    } else if (key == "codec") {
+        job.encode.codec = expectString(key, value);
+    } else if (key == "fps") {
+        job.encode.fps = static_cast<int>(expectPositive(key, value));
+    } else if (key == "crf") {
+        job.encode.crf = expectInt(key, value);
+    } else if (key == "preset") {
+        job.encode.preset = expectString(key, value);
+    } else {
+        fail(fmt::format("unknown key {}", key));
+    }
+}
+
+std::vector<Job> Parser::parse(std::istream &in) {
+    Job defaults;
+    defaults.encode = encodeDefaults;
+    std::vector<Job> jobs;
+    // Line each job starts on, for the validation errors below.
+    std::vector<size_t> jobLines;
+    std::set<std::string> seenKeys;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        const std::string text = trim(stripComment(line));
+        if (text.empty())
+            continue;
+
+        if (text.front() == '[') {
+            if (text != "[[job]]")
+                fail(fmt::format("unknown table {}", text));
+            jobs.push_back(defaults);
+            jobLines.push_back(lineNumber);
+            seenKeys.clear();
+            continue;
+        }
+
+        const size_t equals = text.find('=');
+        if (equals == std::string::npos)
+            fail("expected key = value");
+        const std::string key = trim(text.substr(0, equals));
+        if (!isBareKey(key))
+            fail(fmt::format("invalid key {}", key));
+        if (!seenKeys.insert(key).second)
+            fail(fmt::format("duplicate key {}", key));
+        const Value value = parseValue(trim(text.substr(equals + 1)));
+        apply(jobs.empty() ? defaults : jobs.back(), key, value);
+    }
+    if (in.bad())
+        throw std::runtime_error("Failed to read job file " + sourceName);
+
+    if (jobs.empty())
+        throw std::runtime_error(
+            fmt::format("{}: no [[job]] entries", sourceName));
+
+    std::map<std::string, size_t> outputs;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        Job &job = jobs[i];
+        lineNumber = jobLines[i];
+        if (job.shader.empty())
+            fail("job has no shader");
+        if (job.encode.outputPath.empty())
+            fail("job has no output");
+        if (job.frames == 0)
+            fail("job has no frames");
+        if (job.name.empty())
+            job.name = job.shader.filename().string();
+        const auto [it, inserted] =
+            outputs.emplace(job.encode.outputPath, jobLines[i]);
+        if (!inserted) {
+            fail(fmt::format("output {} is already written by the job on "
+                             "line {}",
+                             job.encode.outputPath, it->second));
+        }
+    }
+    return jobs;
+}
+} // namespace
+
+std::vector<Job> parseJobs(std::istream &in,
+                           const std::filesystem::path &baseDir,
+                           const std::string &sourceName,
+                           const ffmpeg_utils::EncodeSettings &encodeDefaults) {
+    return Parser(baseDir, sourceName, encodeDefaults).parse(in);
+}
+
+std::vector<Job>
+readJobFile(const std::filesystem::path &path,
+            const ffmpeg_utils::EncodeSettings &encodeDefaults) {
+    std::ifstream in(path);
+    if (!in.is_open())
+        throw std::runtime_error("Failed to open job file: " + path.string());
+    return parseJobs(in, path.parent_path(), path.string(), encodeDefaults);
+}
+} // namespace job_manifest
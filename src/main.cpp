@@ -2,19 +2,28 @@
 #include "online_sdf_renderer.h"
 #include "shader_templates.h"
 #if defined(VSDF_ENABLE_FFMPEG)
+#include "batch_render.h"
+#include "job_manifest.h"
 #include "offline_sdf_renderer.h"
+#include "render_checkpoint.h"
+#include "render_daemon.h"
+#include "render_shards.h"
 #endif
 #include <algorithm>
 #include <cctype>
+#include <csignal>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <optional>
 #include <random>
 #include <spdlog/fmt/fmt.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 #include <string>
+#include <system_error>
 #include <unordered_map>
+#include <vector>
 
 namespace {
 constexpr const char kVersion[] = "vsdf dev";
@@ -57,10 +66,55 @@ void printHelp(const char *exe) {
         "higher quality)\n"
         "  --ffmpeg-preset <name>  libx264 preset (default: slow)\n"
         "  --ffmpeg-codec <name>   FFmpeg codec (default: libx264)\n"
+        "  --ffmpeg-mux <standard|fragmented|hls|segments> Output layout; "
+        "all but standard are usable while rendering (default: standard)\n"
+        "  --ffmpeg-segment-seconds <S> Fragment/segment and GOP length "
+        "(default: 1)\n"
         "  --ffmpeg-width <N>      Output width (default: 1280)\n"
         "  --ffmpeg-height <N>     Output height (default: 720)\n"
-        "  --ffmpeg-ring-buffer-size <N> Ring buffer size for offline render "
-        "(default: 2)\n",
+        "  --ffmpeg-ring-buffer-size <N|auto> Ring buffer size for offline "
+        "render (default: 2; auto sizes it from measured stage times)\n"
+        "  --ffmpeg-ring-memory-budget <MiB> Memory cap for auto ring slots "
+        "(default: 512)\n"
+        "  --ffmpeg-submit-batch <N> Ring slots recorded and submitted per "
+        "vkQueueSubmit (default: 0 = whatever is free)\n"
+        "  --ffmpeg-tile-size <N>  Render offline frames as NxN tiles "
+        "(default: 0 = whole frames, tiled only past device limits)\n"
+        "  --ffmpeg-motion-blur <K> Average K jittered sub-frames per output "
+        "frame on the GPU (default: 1 = off)\n"
+        "  --ffmpeg-shutter <F>    Fraction of the frame interval the shutter "
+        "is open for motion blur (default: 0.5)\n"
+        "  --ssaa <N>              Render offline frames at NxN samples per "
+        "pixel and box-filter down on the GPU (default: 1 = off)\n"
+        "  --ffmpeg-frame-layers <L> Render L consecutive frames per draw "
+        "into one layered image (default: 1 = off)\n"
+        "  --ffmpeg-convert-threads <N> Threads for RGB to YUV conversion "
+        "(default: 0 = auto)\n"
+        "  --ffmpeg-gpu-convert <yuv420p|nv12> Convert to YUV on the GPU "
+        "before readback (width must be a multiple of 8, height even)\n"
+        "  --frame-start <N>       First frame to render offline (default: 0)\n"
+        "  --frame-end <N>         Stop before frame N (default: --frames)\n"
+        "  --ffmpeg-shards <N>     Split the frame range across N local vsdf "
+        "processes and join their segments without re-encoding\n"
+        "  --ffmpeg-checkpoint <N> Write the output as N-frame segments with "
+        "a resumable checkpoint\n"
+        "  --resume                Continue an interrupted checkpointed render "
+        "(default segment length: 300)\n"
+        "  --image-output <dir>    Render offline to numbered image files "
+        "instead of a video (requires --frames)\n"
+        "  --image-format <png|qoi|raw> Image sequence format (default: png)\n"
+        "  --image-threads <N>     Image compression threads (default: 0 = "
+        "one per core)\n"
+        "  --stream-output <path|-> Stream offline frames to a file, named "
+        "pipe or stdout (-) instead of a video (requires --frames)\n"
+        "  --stream-format <y4m|raw> Streamed frame format (default: y4m, "
+        "which uses --ffmpeg-gpu-convert yuv420p)\n"
+        "  --profile-output <file> Write per-frame offline stage timings as "
+        "CSV (.csv) or JSON\n"
+        "  --jobs <file>           Render every job in a TOML job file on one "
+        "GPU device instead of a single shader\n"
+        "  --daemon <socket>       Serve image render requests over a Unix "
+        "socket, keeping the device and shader pipelines warm\n",
         exe, exe, exe);
 }
 
@@ -113,6 +167,18 @@ std::filesystem::path createNewToyShader(const std::string &name,
     return shaderPath;
 }
 
+#if defined(VSDF_ENABLE_FFMPEG)
+// argv[0] may be a bare name resolved through PATH; prefer the kernel's
+// view of the running binary where there is one.
+std::filesystem::path currentExecutablePath(const char *argv0) {
+    std::error_code ec;
+    const auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+    if (!ec)
+        return self;
+    return argv0;
+}
+#endif
+
 spdlog::level::level_enum parseLogLevel(const std::string &levelStr) {
     static const std::unordered_map<std::string, spdlog::level::level_enum>
         kLevels = {{"trace", spdlog::level::trace},
@@ -148,9 +214,30 @@ int run(int argc, char **argv) {
     std::optional<uint32_t> ciResizeHeight;
 #if defined(VSDF_ENABLE_FFMPEG)
     uint32_t offlineRingSize = OFFSCREEN_DEFAULT_RING_SIZE;
+    uint64_t offlineRingMemoryBudget = OFFSCREEN_DEFAULT_RING_MEMORY_BUDGET;
+    uint32_t submitBatch = 0;
+    uint32_t offlineTileSize = 0;
+    uint32_t motionBlurSamples = 1;
+    float shutter = OFFSCREEN_DEFAULT_SHUTTER;
+    uint32_t ssaa = 1;
+    uint32_t frameLayers = 1;
+    std::optional<std::filesystem::path> imageOutputDir;
+    image_sequence::Format imageFormat = image_sequence::Format::PNG;
+    uint32_t imageThreads = 0;
+    std::optional<std::string> streamOutput;
+    frame_stream::Format streamFormat = frame_stream::Format::Y4M;
+    std::optional<std::filesystem::path> profileOutput;
     uint32_t offlineWidth = OFFSCREEN_DEFAULT_WIDTH;
     uint32_t offlineHeight = OFFSCREEN_DEFAULT_HEIGHT;
+    GpuColorConversion gpuColorConversion = GpuColorConversion::None;
     ffmpeg_utils::EncodeSettings encodeSettings{};
+    std::optional<uint32_t> frameStart;
+    std::optional<uint32_t> frameEnd;
+    uint32_t shardCount = 1;
+    uint32_t checkpointFrames = 0;
+    bool resume = false;
+    std::optional<std::filesystem::path> jobFile;
+    std::optional<std::filesystem::path> daemonSocket;
 #endif
     auto logLevel = spdlog::level::info;
     std::filesystem::path shaderFile;
@@ -266,7 +353,12 @@ int run(int argc, char **argv) {
         } else if (arg == "--ffmpeg-ring-buffer-size") {
             if (i + 1 >= argc) {
                 throw CLIError("--ffmpeg-ring-buffer-size requires a "
-                               "positive integer value");
+                               "positive integer value or auto");
+            }
+            if (std::string(argv[i + 1]) == "auto") {
+                offlineRingSize = OFFSCREEN_AUTO_RING_SIZE;
+                ++i;
+                continue;
             }
             try {
                 offlineRingSize = static_cast<uint32_t>(std::stoul(argv[++i]));
@@ -282,6 +374,189 @@ int run(int argc, char **argv) {
                                "positive integer value");
             }
             continue;
+        } else if (arg == "--ffmpeg-ring-memory-budget") {
+            if (i + 1 >= argc) {
+                throw CLIError("--ffmpeg-ring-memory-budget requires a "
+                               "positive integer value (MiB)");
+            }
+            uint64_t budgetMiB = 0;
+            try {
+                budgetMiB = std::stoull(argv[++i]);
+            } catch (const std::invalid_argument &) {
+                throw CLIError("--ffmpeg-ring-memory-budget requires a "
+                               "valid positive integer value");
+            } catch (const std::out_of_range &) {
+                throw CLIError("--ffmpeg-ring-memory-budget value is "
+                               "out of range for a positive integer");
+            }
+            if (budgetMiB == 0 || budgetMiB > (UINT64_MAX >> 20)) {
+                throw CLIError("--ffmpeg-ring-memory-budget requires a "
+                               "positive integer value (MiB)");
+            }
+            offlineRingMemoryBudget = budgetMiB << 20;
+            continue;
+        } else if (arg == "--ffmpeg-submit-batch") {
+            if (i + 1 >= argc) {
+                throw CLIError("--ffmpeg-submit-batch requires an integer "
+                               "value");
+            }
+            try {
+                submitBatch = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } catch (const std::invalid_argument &) {
+                throw CLIError("--ffmpeg-submit-batch requires a valid "
+                               "integer value");
+            } catch (const std::out_of_range &) {
+                throw CLIError("--ffmpeg-submit-batch value is out of range");
+            }
+            if (submitBatch > OFFSCREEN_MAX_RING_SIZE) {
+                throw CLIError(fmt::format("--ffmpeg-submit-batch must be "
+                                           "0..{}",
+                                           OFFSCREEN_MAX_RING_SIZE));
+            }
+            continue;
+        } else if (arg == "--ffmpeg-tile-size") {
+            if (i + 1 >= argc) {
+                throw CLIError(
+                    "--ffmpeg-tile-size requires a positive integer value");
+            }
+            try {
+                offlineTileSize = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } catch (const std::invalid_argument &) {
+                throw CLIError("--ffmpeg-tile-size requires a valid "
+                               "positive integer value");
+            } catch (const std::out_of_range &) {
+                throw CLIError("--ffmpeg-tile-size value is out of range "
+                               "for a positive integer");
+            }
+            if (offlineTileSize == 0) {
+                throw CLIError(
+                    "--ffmpeg-tile-size requires a positive integer value");
+            }
+            continue;
+        } else if (arg == "--ffmpeg-motion-blur") {
+            if (i + 1 >= argc) {
+                throw CLIError(
+                    "--ffmpeg-motion-blur requires a positive integer value");
+            }
+            try {
+                motionBlurSamples =
+                    static_cast<uint32_t>(std::stoul(argv[++i]));
+            } catch (const std::invalid_argument &) {
+                throw CLIError("--ffmpeg-motion-blur requires a valid "
+                               "positive integer value");
+            } catch (const std::out_of_range &) {
+                throw CLIError("--ffmpeg-motion-blur value is out of range "
+                               "for a positive integer");
+            }
+            if (motionBlurSamples == 0 ||
+                motionBlurSamples > OFFSCREEN_MAX_MOTION_BLUR_SAMPLES) {
+                throw CLIError(
+                    fmt::format("--ffmpeg-motion-blur must be 1..{}",
+                                OFFSCREEN_MAX_MOTION_BLUR_SAMPLES));
+            }
+            continue;
+        } else if (arg == "--ffmpeg-shutter") {
+            if (i + 1 >= argc) {
+                throw CLIError("--ffmpeg-shutter requires a value in (0, 1]");
+            }
+            try {
+                shutter = std::stof(argv[++i]);
+            } catch (const std::exception &) {
+                throw CLIError("--ffmpeg-shutter requires a valid number");
+            }
+            if (!(shutter > 0.0f && shutter <= 1.0f)) {
+                throw CLIError("--ffmpeg-shutter requires a value in (0, 1]");
+            }
+            continue;
+        } else if (arg == "--ssaa") {
+            if (i + 1 >= argc) {
+                throw CLIError("--ssaa requires a positive integer value");
+            }
+            try {
+                ssaa = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } catch (const std::invalid_argument &) {
+                throw CLIError(
+                    "--ssaa requires a valid positive integer value");
+            } catch (const std::out_of_range &) {
+                throw CLIError(
+                    "--ssaa value is out of range for a positive integer");
+            }
+            if (ssaa == 0 || ssaa > OFFSCREEN_MAX_SSAA) {
+                throw CLIError(
+                    fmt::format("--ssaa must be 1..{}", OFFSCREEN_MAX_SSAA));
+            }
+            continue;
+        } else if (arg == "--ffmpeg-frame-layers") {
+            if (i + 1 >= argc) {
+                throw CLIError(
+                    "--ffmpeg-frame-layers requires a positive integer value");
+            }
+            try {
+                frameLayers = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } catch (const std::invalid_argument &) {
+                throw CLIError("--ffmpeg-frame-layers requires a valid "
+                               "positive integer value");
+            } catch (const std::out_of_range &) {
+                throw CLIError("--ffmpeg-frame-layers value is out of range "
+                               "for a positive integer");
+            }
+            if (frameLayers == 0 || frameLayers > OFFSCREEN_MAX_FRAME_LAYERS) {
+                throw CLIError(
+                    fmt::format("--ffmpeg-frame-layers must be 1..{}",
+                                OFFSCREEN_MAX_FRAME_LAYERS));
+            }
+            continue;
+        } else if (arg == "--image-output") {
+            if (i + 1 >= argc) {
+                throw CLIError("--image-output requires a directory path");
+            }
+            imageOutputDir = argv[++i];
+            continue;
+        } else if (arg == "--image-format") {
+            if (i + 1 >= argc) {
+                throw CLIError("--image-format requires png, qoi or raw");
+            }
+            const auto format = image_sequence::parseFormat(argv[++i]);
+            if (!format) {
+                throw CLIError("--image-format requires png, qoi or raw");
+            }
+            imageFormat = *format;
+            continue;
+        } else if (arg == "--image-threads") {
+            if (i + 1 >= argc) {
+                throw CLIError("--image-threads requires an integer value");
+            }
+            try {
+                imageThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } catch (const std::invalid_argument &) {
+                throw CLIError(
+                    "--image-threads requires a valid integer value");
+            } catch (const std::out_of_range &) {
+                throw CLIError("--image-threads value is out of range");
+            }
+            continue;
+        } else if (arg == "--stream-output") {
+            if (i + 1 >= argc) {
+                throw CLIError("--stream-output requires a path or -");
+            }
+            streamOutput = argv[++i];
+            continue;
+        } else if (arg == "--stream-format") {
+            if (i + 1 >= argc) {
+                throw CLIError("--stream-format requires y4m or raw");
+            }
+            const auto format = frame_stream::parseFormat(argv[++i]);
+            if (!format) {
+                throw CLIError("--stream-format requires y4m or raw");
+            }
+            streamFormat = *format;
+            continue;
+        } else if (arg == "--profile-output") {
+            if (i + 1 >= argc) {
+                throw CLIError("--profile-output requires a file path");
+            }
+            profileOutput = argv[++i];
+            continue;
         } else if (arg == "--ffmpeg-output") {
             if (i + 1 >= argc) {
                 throw CLIError("--ffmpeg-output requires a file path");
@@ -309,6 +584,40 @@ int run(int argc, char **argv) {
             }
             encodeSettings.codec = argv[++i];
             continue;
+        } else if (arg == "--ffmpeg-mux") {
+            if (i + 1 >= argc) {
+                throw CLIError("--ffmpeg-mux requires a value "
+                               "(standard|fragmented|hls|segments)");
+            }
+            const std::string value = argv[++i];
+            if (value == "standard") {
+                encodeSettings.mux = ffmpeg_utils::MuxMode::Standard;
+            } else if (value == "fragmented") {
+                encodeSettings.mux = ffmpeg_utils::MuxMode::Fragmented;
+            } else if (value == "hls") {
+                encodeSettings.mux = ffmpeg_utils::MuxMode::HLS;
+            } else if (value == "segments") {
+                encodeSettings.mux = ffmpeg_utils::MuxMode::Segments;
+            } else {
+                throw CLIError("Invalid --ffmpeg-mux value: " + value);
+            }
+            continue;
+        } else if (arg == "--ffmpeg-segment-seconds") {
+            if (i + 1 >= argc) {
+                throw CLIError(
+                    "--ffmpeg-segment-seconds requires a positive number");
+            }
+            try {
+                encodeSettings.segmentSeconds = std::stof(argv[++i]);
+            } catch (const std::exception &) {
+                throw CLIError(
+                    "--ffmpeg-segment-seconds requires a valid number");
+            }
+            if (!(encodeSettings.segmentSeconds > 0.0f)) {
+                throw CLIError(
+                    "--ffmpeg-segment-seconds requires a positive number");
+            }
+            continue;
         } else if (arg == "--ffmpeg-crf") {
             if (i + 1 >= argc) {
                 throw CLIError("--ffmpeg-crf requires an integer value");
@@ -325,6 +634,106 @@ int run(int argc, char **argv) {
             }
             encodeSettings.preset = argv[++i];
             continue;
+        } else if (arg == "--ffmpeg-convert-threads") {
+            if (i + 1 >= argc) {
+                throw CLIError("--ffmpeg-convert-threads requires a "
+                               "non-negative integer value");
+            }
+            try {
+                encodeSettings.convertThreads = std::stoi(argv[++i]);
+            } catch (const std::exception &) {
+                throw CLIError("--ffmpeg-convert-threads requires a valid "
+                               "integer value");
+            }
+            if (encodeSettings.convertThreads < 0) {
+                throw CLIError("--ffmpeg-convert-threads requires a "
+                               "non-negative integer value");
+            }
+            continue;
+        } else if (arg == "--ffmpeg-gpu-convert") {
+            if (i + 1 >= argc) {
+                throw CLIError(
+                    "--ffmpeg-gpu-convert requires a value (yuv420p|nv12)");
+            }
+            const std::string value = argv[++i];
+            if (value == "yuv420p") {
+                gpuColorConversion = GpuColorConversion::YUV420P;
+            } else if (value == "nv12") {
+                gpuColorConversion = GpuColorConversion::NV12;
+            } else {
+                throw CLIError("Invalid --ffmpeg-gpu-convert value: " + value);
+            }
+            continue;
+        } else if (arg == "--frame-start" || arg == "--frame-end") {
+            if (i + 1 >= argc) {
+                throw CLIError(arg + " requires a non-negative integer value");
+            }
+            uint32_t value = 0;
+            try {
+                value = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } catch (const std::invalid_argument &) {
+                throw CLIError(arg +
+                               " requires a valid non-negative integer value");
+            } catch (const std::out_of_range &) {
+                throw CLIError(arg + " value is out of range for a "
+                                     "non-negative integer");
+            }
+            (arg == "--frame-start" ? frameStart : frameEnd) = value;
+            continue;
+        } else if (arg == "--ffmpeg-shards") {
+            if (i + 1 >= argc) {
+                throw CLIError(
+                    "--ffmpeg-shards requires a positive integer value");
+            }
+            try {
+                shardCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } catch (const std::invalid_argument &) {
+                throw CLIError("--ffmpeg-shards requires a valid positive "
+                               "integer value");
+            } catch (const std::out_of_range &) {
+                throw CLIError("--ffmpeg-shards value is out of range "
+                               "for a positive integer");
+            }
+            if (shardCount == 0) {
+                throw CLIError(
+                    "--ffmpeg-shards requires a positive integer value");
+            }
+            continue;
+        } else if (arg == "--ffmpeg-checkpoint") {
+            if (i + 1 >= argc) {
+                throw CLIError(
+                    "--ffmpeg-checkpoint requires a positive integer value");
+            }
+            try {
+                checkpointFrames =
+                    static_cast<uint32_t>(std::stoul(argv[++i]));
+            } catch (const std::invalid_argument &) {
+                throw CLIError("--ffmpeg-checkpoint requires a valid "
+                               "positive integer value");
+            } catch (const std::out_of_range &) {
+                throw CLIError("--ffmpeg-checkpoint value is out of range "
+                               "for a positive integer");
+            }
+            if (checkpointFrames == 0) {
+                throw CLIError(
+                    "--ffmpeg-checkpoint requires a positive integer value");
+            }
+            continue;
+        } else if (arg == "--resume") {
+            resume = true;
+            continue;
+        } else if (arg == "--jobs") {
+            if (i + 1 >= argc) {
+                throw CLIError("--jobs requires a job file path");
+            }
+            jobFile = argv[++i];
+            continue;
+        } else if (arg == "--daemon") {
+            if (i + 1 >= argc) {
+                throw CLIError("--daemon requires a socket path");
+            }
+            daemonSocket = argv[++i];
+            continue;
         }
 #endif
 
@@ -399,35 +808,269 @@ int run(int argc, char **argv) {
         return 0;
     }
 
-    if (!std::filesystem::exists(shaderFile))
+#if defined(VSDF_ENABLE_FFMPEG)
+    const bool useJobs = jobFile.has_value();
+    const bool useDaemon = daemonSocket.has_value();
+#else
+    const bool useJobs = false;
+    const bool useDaemon = false;
+#endif
+    // Job files and daemon requests name their own shaders.
+    const bool shaderFromArgs = !useJobs && !useDaemon;
+    if (!shaderFromArgs && !shaderFile.empty())
+        throw CLIError("--jobs and --daemon take shaders from their jobs or "
+                       "requests, not the command line");
+    if (shaderFromArgs && !std::filesystem::exists(shaderFile))
         throw CLIError("Shader file does not exist: " + shaderFile.string());
-    if (shaderFile.extension() != ".frag")
+    if (shaderFromArgs && shaderFile.extension() != ".frag")
         throw CLIError("Shader file is not a .frag file: " +
                        shaderFile.string());
 
 #if defined(VSDF_ENABLE_FFMPEG)
     const bool useFfmpeg = !encodeSettings.outputPath.empty();
-    if (!encodeSettings.outputPath.empty() && !maxFrames) {
-        throw CLIError("--frames must be set when using --ffmpeg-output");
+    const bool useImages = imageOutputDir.has_value();
+    const bool useStream = streamOutput.has_value();
+    const bool renderOffline = useFfmpeg || useImages || useStream;
+    const int offlineOutputs = static_cast<int>(useFfmpeg) +
+                               static_cast<int>(useImages) +
+                               static_cast<int>(useStream);
+    if (offlineOutputs > 1) {
+        throw CLIError("Only one of --ffmpeg-output, --image-output and "
+                       "--stream-output can be used");
+    }
+    if (useJobs && useDaemon) {
+        throw CLIError("--jobs and --daemon can't be used together");
+    }
+    if (!shaderFromArgs &&
+        (renderOffline || maxFrames || frameStart || frameEnd ||
+         shardCount > 1 || checkpointFrames > 0 || resume || profileOutput ||
+         debugDumpPPMDir)) {
+        // Each job or request names its own output and frames.
+        throw CLIError("--jobs and --daemon can't be used with "
+                       "--ffmpeg-output, --image-output, --stream-output, "
+                       "--frames, --frame-start/--frame-end, "
+                       "--ffmpeg-shards, --ffmpeg-checkpoint, --resume, "
+                       "--profile-output or --debug-dump-ppm");
+    }
+    if (useDaemon && gpuColorConversion != GpuColorConversion::None) {
+        throw CLIError("--ffmpeg-gpu-convert can't be used with --daemon "
+                       "(requests write images)");
     }
+    if (renderOffline && !maxFrames && !frameEnd) {
+        throw CLIError("--frames must be set when using --ffmpeg-output, "
+                       "--image-output or --stream-output");
+    }
+    if (!renderOffline && (frameStart || frameEnd)) {
+        throw CLIError("--frame-start and --frame-end require --ffmpeg-output, "
+                       "--image-output or --stream-output");
+    }
+    if (!renderOffline && profileOutput) {
+        throw CLIError("--profile-output requires an offline output");
+    }
+    if (!useFfmpeg && shardCount > 1) {
+        throw CLIError("--ffmpeg-shards requires --ffmpeg-output");
+    }
+    if (useImages && gpuColorConversion != GpuColorConversion::None) {
+        throw CLIError("--ffmpeg-gpu-convert can't be used with "
+                       "--image-output");
+    }
+    if (useStream && streamFormat == frame_stream::Format::Y4M) {
+        // Y4M carries the GPU-converted planes as they are.
+        if (gpuColorConversion == GpuColorConversion::NV12) {
+            throw CLIError("--stream-format y4m needs --ffmpeg-gpu-convert "
+                           "yuv420p");
+        }
+        gpuColorConversion = GpuColorConversion::YUV420P;
+    }
+    if (frameLayers > 1 &&
+        (motionBlurSamples > 1 || ssaa > 1 || offlineTileSize != 0 ||
+         gpuColorConversion != GpuColorConversion::None)) {
+        throw CLIError("--ffmpeg-frame-layers can't be used with motion blur, "
+                       "--ssaa, --ffmpeg-tile-size, --ffmpeg-gpu-convert or "
+                       "y4m streaming");
+    }
+    render_shards::FrameRange frameRange{};
+    if (renderOffline) {
+        frameRange.start = frameStart.value_or(0);
+        frameRange.end = frameEnd.value_or(maxFrames.value_or(0));
+        if (maxFrames && frameRange.end > *maxFrames) {
+            throw CLIError("--frame-end must not be past --frames");
+        }
+        if ((frameStart || frameEnd) && frameRange.start >= frameRange.end) {
+            throw CLIError("--frame-start must be before --frame-end");
+        }
+    }
+    if (shardCount > 1 && debugDumpPPMDir) {
+        throw CLIError("--debug-dump-ppm can't be used with --ffmpeg-shards");
+    }
+    const bool useCheckpoint = checkpointFrames > 0 || resume;
+    if (useCheckpoint && !useFfmpeg) {
+        throw CLIError("--ffmpeg-checkpoint and --resume require "
+                       "--ffmpeg-output");
+    }
+    // Checkpoints and shards join their pieces into a single output file.
+    const bool multiFileMux =
+        encodeSettings.mux == ffmpeg_utils::MuxMode::HLS ||
+        encodeSettings.mux == ffmpeg_utils::MuxMode::Segments;
+    if (multiFileMux && (useCheckpoint || shardCount > 1)) {
+        throw CLIError("--ffmpeg-mux hls/segments can't be used with "
+                       "--ffmpeg-checkpoint, --resume or --ffmpeg-shards");
+    }
+    if (encodeSettings.mux == ffmpeg_utils::MuxMode::Segments && useFfmpeg &&
+        encodeSettings.outputPath.find('%') == std::string::npos) {
+        throw CLIError("--ffmpeg-mux segments needs a numbered "
+                       "--ffmpeg-output pattern such as out_%05d.mp4");
+    }
+    if (useCheckpoint && shardCount > 1) {
+        throw CLIError("--ffmpeg-checkpoint and --resume can't be used with "
+                       "--ffmpeg-shards");
+    }
+    // Partial ranges are segments of a longer render; keep them joinable.
+    encodeSettings.closedGop = frameStart || frameEnd || shardCount > 1;
 #endif
 
+#if defined(VSDF_ENABLE_FFMPEG)
+    if (streamOutput == "-") {
+        // stdout carries the frames; keep the logs out of the stream.
+        spdlog::set_default_logger(spdlog::stderr_color_mt("vsdf"));
+    }
+#endif
     spdlog::set_level(logLevel);
     spdlog::info("Setting things up...");
     spdlog::default_logger()->set_pattern("[%H:%M:%S] [%l] %v");
 
     bool shouldRunOnline = true;
 #if defined(VSDF_ENABLE_FFMPEG)
-    if (useFfmpeg) {
+    if (useJobs || useDaemon) {
         shouldRunOnline = false;
+        // The flags set what jobs and requests don't: ring, batching,
+        // blur, ssaa, layers, GPU conversion and the encode settings.
+        OfflineRenderOptions baseOptions;
+        baseOptions.ringSize = offlineRingSize;
+        baseOptions.ringMemoryBudget = offlineRingMemoryBudget;
+        baseOptions.submitBatch = submitBatch;
+        baseOptions.tileSize = offlineTileSize;
+        baseOptions.motionBlurSamples = motionBlurSamples;
+        baseOptions.shutter = shutter;
+        baseOptions.ssaa = ssaa;
+        baseOptions.frameLayers = frameLayers;
+        baseOptions.gpuColorConversion = gpuColorConversion;
+        baseOptions.encodeSettings = encodeSettings;
+        if (useDaemon) {
+            render_daemon::Settings daemonSettings;
+            daemonSettings.socketPath = *daemonSocket;
+            render_daemon::serve(daemonSettings, baseOptions);
+            return 0;
+        }
+        // --ffmpeg-codec/-crf/-preset/-fps apply unless the job file
+        // sets them.
+        const auto jobs = job_manifest::readJobFile(*jobFile, encodeSettings);
+        const auto results = batch_render::runJobs(jobs, baseOptions);
+        const auto failed = std::count_if(
+            results.begin(), results.end(),
+            [](const batch_render::JobResult &r) { return !r.error.empty(); });
+        if (failed > 0) {
+            throw std::runtime_error(fmt::format("{} of {} job(s) failed",
+                                                 failed, results.size()));
+        }
+    } else if (useFfmpeg && shardCount > 1) {
+        shouldRunOnline = false;
+        // Workers re-run this binary with the same flags on a sub-range.
+        const std::vector<std::string> args(argv + 1, argv + argc);
+        render_shards::runShardedRender(currentExecutablePath(argv[0]), args,
+                                        frameRange, shardCount,
+                                        encodeSettings.outputPath);
+    } else if (renderOffline) {
+        shouldRunOnline = false;
+        std::optional<render_checkpoint::Manifest> checkpoint;
+        if (useCheckpoint) {
+            checkpoint = render_checkpoint::Manifest{
+                .shaderHash = render_checkpoint::hashFile(shaderFile),
+                // Everything that changes the encoded pixels; ring/tile/
+                // thread settings don't, so they may differ on resume.
+                .settings = fmt::format(
+                    "{}x{} fps={} codec={} crf={} preset={} toy={} gpu={} "
+                    "blur={}@{} ssaa={} gop={}s",
+                    offlineWidth, offlineHeight, encodeSettings.fps,
+                    encodeSettings.codec, encodeSettings.crf,
+                    encodeSettings.preset, useToyTemplate,
+                    static_cast<int>(gpuColorConversion), motionBlurSamples,
+                    shutter, ssaa, encodeSettings.segmentSeconds),
+                .frameStart = frameRange.start,
+                .frameEnd = frameRange.end,
+                .segmentFrames = checkpointFrames > 0
+                                     ? checkpointFrames
+                                     : OFFSCREEN_DEFAULT_CHECKPOINT_FRAMES,
+                .nextFrame = frameRange.start,
+                .segments = {},
+            };
+            const auto manifestPath =
+                render_checkpoint::manifestPath(encodeSettings.outputPath);
+            const auto saved = render_checkpoint::readManifest(manifestPath);
+            if (resume && saved) {
+                render_checkpoint::validateResume(*saved, *checkpoint);
+                checkpoint->nextFrame = saved->nextFrame;
+                checkpoint->segments = saved->segments;
+                spdlog::info("Resuming at frame {} ({} segment(s) done)",
+                             checkpoint->nextFrame,
+                             checkpoint->segments.size());
+            } else if (resume) {
+                spdlog::info("No checkpoint at {}, starting from frame {}",
+                             manifestPath.string(), frameRange.start);
+            }
+            encodeSettings.closedGop = true;
+            frameRange.start = checkpoint->nextFrame;
+        }
+        if (checkpoint && frameRange.start >= frameRange.end) {
+            // Killed between the last segment and the join.
+            render_checkpoint::finishRender(*checkpoint,
+                                            encodeSettings.outputPath);
+            return 0;
+        }
         OfflineRenderOptions offlineOptions{
-            .maxFrames = *maxFrames,
+            .frameStart = frameRange.start,
+            .maxFrames = frameRange.end,
             .debugDumpPPMDir = debugDumpPPMDir,
             .width = offlineWidth,
             .height = offlineHeight,
             .ringSize = offlineRingSize,
+            .ringMemoryBudget = offlineRingMemoryBudget,
+            .submitBatch = submitBatch,
+            .tileSize = offlineTileSize,
+            .motionBlurSamples = motionBlurSamples,
+            .shutter = shutter,
+            .ssaa = ssaa,
+            .frameLayers = frameLayers,
+            .gpuColorConversion = gpuColorConversion,
             .encodeSettings = encodeSettings,
+            .checkpoint = std::move(checkpoint),
+            .imageSequence = std::nullopt,
+            .frameStream = std::nullopt,
+            .profileOutput = profileOutput,
+            .vulkanContext = nullptr,
+            .fragSpirv = std::nullopt,
+            .pipelineKey = {},
+            .frameTimes = {},
         };
+        if (useImages) {
+            offlineOptions.imageSequence = image_sequence::Settings{
+                .outputDir = *imageOutputDir,
+                .format = imageFormat,
+                .threads = imageThreads,
+                .maxInFlight = 0,
+            };
+        }
+        if (useStream) {
+            offlineOptions.frameStream = frame_stream::Settings{
+                .path = *streamOutput,
+                .format = streamFormat,
+            };
+#if !defined(_WIN32)
+            // A reader exiting early should fail the stream write with
+            // EPIPE rather than kill us. Pipes have no MSG_NOSIGNAL.
+            std::signal(SIGPIPE, SIG_IGN);
+#endif
+        }
         OfflineSDFRenderer renderer{shaderFile.string(), useToyTemplate,
                                     std::move(offlineOptions)};
         renderer.setup();
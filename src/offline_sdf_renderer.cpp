@@ -1,211 +1,1013 @@
 #include "offline_sdf_renderer.h"
 #include "ffmpeg_encoder.h"
+#include "frame_stream.h"
+#include "motion_blur.h"
 #include "shader_utils.h"
 #include "vkutils.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <spdlog/fmt/fmt.h>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
+#include <vector>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+namespace {
+// One dynamic uniform buffer of frame inputs at set 0.
+VkDescriptorSetLayout createFrameInputSetLayout(VkDevice device) {
+    const std::vector<VkDescriptorSetLayoutBinding> bindings = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+    };
+    return vkutils::createDescriptorSetLayout(device, bindings);
+}
+
+// Frame inputs come from set 0 or push constants depending on the shader,
+// so the layout has both.
+VkPipelineLayout createFramePipelineLayout(VkDevice device,
+                                           VkDescriptorSetLayout setLayout) {
+    const VkPushConstantRange pushConstantRange{
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .offset = 0,
+        .size = sizeof(vkutils::PushConstants),
+    };
+    return vkutils::createPipelineLayout(device, setLayout,
+                                         pushConstantRange);
+}
+} // namespace
+
+OfflineVulkanContext::OfflineVulkanContext() {
+    instance = vkutils::setupVulkanInstance(true);
+    physicalDevice = vkutils::findGPU(instance);
+    deviceProperties = vkutils::getDeviceProperties(physicalDevice);
+    graphicsQueueIndex = vkutils::getVulkanGraphicsQueueIndex(physicalDevice);
+    logicalDevice = vkutils::createVulkanLogicalDevice(
+        physicalDevice, graphicsQueueIndex, true);
+    vkGetDeviceQueue(logicalDevice, graphicsQueueIndex, 0, &queue);
+    pipelineCache = vkutils::loadPipelineCache(logicalDevice, deviceProperties);
+    renderPass = vkutils::createRenderPass(
+        logicalDevice, VK_FORMAT_B8G8R8A8_UNORM, true);
+    auto vertSpirv = shader_utils::compileFullscreenQuadVertSpirv();
+    vertShaderModule = vkutils::createShaderModule(logicalDevice, vertSpirv);
+    frameInputSetLayout = createFrameInputSetLayout(logicalDevice);
+    pipelineLayout =
+        createFramePipelineLayout(logicalDevice, frameInputSetLayout);
+}
+
+OfflineVulkanContext::~OfflineVulkanContext() {
+    if (logicalDevice != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(logicalDevice);
+        trimPipelines(0);
+        vkutils::savePipelineCache(logicalDevice, deviceProperties,
+                                   pipelineCache);
+        vkDestroyPipelineCache(logicalDevice, pipelineCache, nullptr);
+        vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(logicalDevice, frameInputSetLayout,
+                                     nullptr);
+        vkDestroyShaderModule(logicalDevice, vertShaderModule, nullptr);
+        vkDestroyRenderPass(logicalDevice, renderPass, nullptr);
+        vkDestroyDevice(logicalDevice, nullptr);
+    }
+    if (instance != VK_NULL_HANDLE)
+        vkDestroyInstance(instance, nullptr);
+}
+
+const OfflineVulkanContext::WarmPipeline *
+OfflineVulkanContext::findPipeline(const std::string &key) {
+    const auto it = pipelines.find(key);
+    if (it == pipelines.end())
+        return nullptr;
+    it->second.lastUsed = ++useCounter;
+    return &it->second;
+}
+
+void OfflineVulkanContext::addPipeline(const std::string &key,
+                                       const WarmPipeline &pipeline) {
+    WarmPipeline &entry = pipelines[key];
+    entry = pipeline;
+    entry.lastUsed = ++useCounter;
+}
+
+void OfflineVulkanContext::trimPipelines(size_t keep) {
+    while (pipelines.size() > keep) {
+        const auto oldest = std::min_element(
+            pipelines.begin(), pipelines.end(),
+            [](const auto &a, const auto &b) {
+                return a.second.lastUsed < b.second.lastUsed;
+            });
+        vkDestroyPipeline(logicalDevice, oldest->second.pipeline, nullptr);
+        vkDestroyShaderModule(logicalDevice, oldest->second.fragShaderModule,
+                              nullptr);
+        pipelines.erase(oldest);
+    }
+}
 
 OfflineSDFRenderer::OfflineSDFRenderer(
     const std::string &fragShaderPath, bool useToyTemplate,
     OfflineRenderOptions options)
     : SDFRenderer(fragShaderPath, useToyTemplate, options.debugDumpPPMDir),
       imageSize({options.width, options.height}),
-      ringSize(validateRingSize(options.ringSize)),
-      maxFrames(options.maxFrames),
-      encodeSettings(std::move(options.encodeSettings)) {}
+      adaptiveRing(options.ringSize == OFFSCREEN_AUTO_RING_SIZE),
+      ringMemoryBudget(options.ringMemoryBudget),
+      ringSize(adaptiveRing ? OFFSCREEN_DEFAULT_RING_SIZE
+                            : validateRingSize(options.ringSize)),
+      frameStart(options.frameStart), maxFrames(options.maxFrames),
+      submitBatch(options.submitBatch),
+      requestedTileSize(options.tileSize),
+      motionBlurSamples(options.motionBlurSamples), shutter(options.shutter),
+      ssaa(options.ssaa), frameLayers(options.frameLayers),
+      gpuColorConversion(validateGpuColorConversion(
+          options.gpuColorConversion, options.width, options.height)),
+      encodeSettings(std::move(options.encodeSettings)),
+      checkpoint(std::move(options.checkpoint)),
+      imageSequence(std::move(options.imageSequence)),
+      frameStream(std::move(options.frameStream)),
+      profileOutput(std::move(options.profileOutput)),
+      vulkanContext(std::move(options.vulkanContext)),
+      precompiledFragSpirv(std::move(options.fragSpirv)),
+      pipelineKey(std::move(options.pipelineKey)),
+      frameTimes(std::move(options.frameTimes)) {
+    if (gpuColorConversion != GpuColorConversion::None && debugDumpPPMDir) {
+        throw std::runtime_error(
+            "Debug PPM dump needs BGRA readback; disable GPU color "
+            "conversion to use it");
+    }
+    if (motionBlurSamples == 0 ||
+        motionBlurSamples > OFFSCREEN_MAX_MOTION_BLUR_SAMPLES) {
+        throw std::runtime_error(
+            fmt::format("motionBlurSamples must be 1..{}",
+                        OFFSCREEN_MAX_MOTION_BLUR_SAMPLES));
+    }
+    if (!(shutter > 0.0f && shutter <= 1.0f)) {
+        throw std::runtime_error("shutter must be in (0, 1]");
+    }
+    if (ssaa == 0 || ssaa > OFFSCREEN_MAX_SSAA) {
+        throw std::runtime_error(
+            fmt::format("ssaa must be 1..{}", OFFSCREEN_MAX_SSAA));
+    }
+    if (frameLayers == 0 || frameLayers > OFFSCREEN_MAX_FRAME_LAYERS) {
+        throw std::runtime_error(fmt::format("frameLayers must be 1..{}",
+                                             OFFSCREEN_MAX_FRAME_LAYERS));
+    }
+    if (layered() &&
+        (motionBlurSamples > 1 || ssaa > 1 || requestedTileSize != 0 ||
+         gpuColorConversion != GpuColorConversion::None)) {
+        throw std::runtime_error(
+            "Layered frames can't be combined with motion blur, "
+            "supersampling, tiling or GPU color conversion");
+    }
+    if (!frameTimes.empty() &&
+        (frameStart != 0 || maxFrames != frameTimes.size())) {
+        throw std::runtime_error(
+            "frameTimes needs one entry per frame, starting at frame 0");
+    }
+    if (checkpoint && checkpoint->segmentFrames == 0) {
+        throw std::runtime_error("Checkpoint segments need at least 1 frame");
+    }
+    if (imageSequence && gpuColorConversion != GpuColorConversion::None) {
+        throw std::runtime_error(
+            "Image sequence output needs RGBA readback; disable GPU color "
+            "conversion to use it");
+    }
+    if (imageSequence && checkpoint) {
+        throw std::runtime_error(
+            "Image sequence output can't be checkpointed (every frame is "
+            "already its own file)");
+    }
+    if (frameStream && (imageSequence || checkpoint)) {
+        throw std::runtime_error("Frame streaming can't be combined with "
+                                 "image sequence or checkpointed output");
+    }
+    if (frameStream && frameStream->format == frame_stream::Format::Y4M &&
+        gpuColorConversion != GpuColorConversion::YUV420P) {
+        throw std::runtime_error(
+            "Y4M streaming needs YUV420P GPU color conversion");
+    }
+}
+
+OfflineSDFRenderer::~OfflineSDFRenderer() {
+    // renderFrames() tears down on success; this is for a throw out of
+    // setup() or the render loop, which must not leave the encoder thread
+    // joinable or the GPU objects behind (the daemon keeps serving).
+    if (freeSlots)
+        freeSlots->close();
+    if (readyFrames)
+        readyFrames->close();
+    if (encoderThread.joinable())
+        encoderThread.join();
+    if (logicalDevice == VK_NULL_HANDLE && instance == VK_NULL_HANDLE)
+        return;
+    try {
+        destroy();
+    } catch (const std::exception &e) {
+        spdlog::error("Failed to tear down the offline renderer: {}",
+                      e.what());
+    }
+}
 
 uint32_t OfflineSDFRenderer::validateRingSize(uint32_t value) {
-    if (value == 0 || value > MAX_FRAME_SLOTS) {
-        throw std::runtime_error("ringSize must be 1..MAX_FRAME_SLOTS");
+    if (value == 0 || value > OFFSCREEN_MAX_RING_SIZE) {
+        throw std::runtime_error(
+            fmt::format("ringSize must be 1..{}", OFFSCREEN_MAX_RING_SIZE));
     }
     return value;
 }
 
+uint32_t OfflineSDFRenderer::computeMaxRingSize() const {
+    if (!adaptiveRing)
+        return ringSize;
+
+    // Device-local image (+ intermediate image for motion blur or
+    // supersampling, ssaa^2 times the pixels) + host-visible staging
+    // buffer per slot.
+    const uint64_t pixels =
+        static_cast<uint64_t>(renderExtent.width) * renderExtent.height;
+    uint64_t intermediatePixelBytes = readbackFormatInfo.bytesPerPixel;
+    if (accumulating())
+        intermediatePixelBytes =
+            intermediateFormat == ACCUM_FORMAT_WIDE ? 16 : 8;
+    const uint64_t intermediateBytes =
+        usesIntermediate() ? pixels * ssaa * ssaa * intermediatePixelBytes : 0;
+    const uint64_t slotBytes =
+        (pixels * readbackFormatInfo.bytesPerPixel + intermediateBytes +
+         readbackBytes()) *
+        frameLayers;
+    const uint64_t budgetSlots = ringMemoryBudget / slotBytes;
+    if (budgetSlots < OFFSCREEN_DEFAULT_RING_SIZE) {
+        spdlog::warn("Ring memory budget {} MiB fits {} slot(s) of {} MiB",
+                     ringMemoryBudget >> 20, budgetSlots, slotBytes >> 20);
+    }
+    return static_cast<uint32_t>(std::clamp<uint64_t>(
+        budgetSlots, 1, OFFSCREEN_MAX_RING_SIZE));
+}
+
+GpuColorConversion OfflineSDFRenderer::validateGpuColorConversion(
+    GpuColorConversion conversion, uint32_t width, uint32_t height) {
+    // The compute pass writes whole 32-bit words for 8x2 pixel blocks.
+    if (conversion != GpuColorConversion::None &&
+        (width % 8 != 0 || height % 2 != 0)) {
+        throw std::runtime_error(
+            fmt::format("GPU YUV conversion needs width divisible by 8 and "
+                        "even height (got {}x{})",
+                        width, height));
+    }
+    return conversion;
+}
+
 void OfflineSDFRenderer::setup() {
     vulkanSetup();
     setupRenderContext();
+    setupColorConversion();
+    setupSupersampling();
+    setupFrameInputs();
+    for (uint32_t i = 0; i < ringSize; ++i) {
+        createRingSlot(i);
+    }
     createPipeline();
-    createCommandBuffers();
 }
 
 void OfflineSDFRenderer::vulkanSetup() {
-    instance = vkutils::setupVulkanInstance(true);
-    physicalDevice = vkutils::findGPU(instance);
-    deviceProperties = vkutils::getDeviceProperties(physicalDevice);
-    logDeviceLimits();
-    graphicsQueueIndex = vkutils::getVulkanGraphicsQueueIndex(physicalDevice);
-    logicalDevice = vkutils::createVulkanLogicalDevice(
-        physicalDevice, graphicsQueueIndex, true);
-    initDeviceQueue();
-    renderPass = vkutils::createRenderPass(logicalDevice, imageFormat, true);
+    if (vulkanContext) {
+        instance = vulkanContext->instance;
+        physicalDevice = vulkanContext->physicalDevice;
+        deviceProperties = vulkanContext->deviceProperties;
+        graphicsQueueIndex = vulkanContext->graphicsQueueIndex;
+        logicalDevice = vulkanContext->logicalDevice;
+        queue = vulkanContext->queue;
+        renderPass = vulkanContext->renderPass;
+        pipelineCache = vulkanContext->pipelineCache;
+    } else {
+        instance = vkutils::setupVulkanInstance(true);
+        physicalDevice = vkutils::findGPU(instance);
+        deviceProperties = vkutils::getDeviceProperties(physicalDevice);
+        logDeviceLimits();
+        graphicsQueueIndex =
+            vkutils::getVulkanGraphicsQueueIndex(physicalDevice);
+        logicalDevice = vkutils::createVulkanLogicalDevice(
+            physicalDevice, graphicsQueueIndex, true);
+        initDeviceQueue();
+        pipelineCache =
+            vkutils::loadPipelineCache(logicalDevice, deviceProperties);
+        renderPass =
+            vkutils::createRenderPass(logicalDevice, imageFormat, true);
+    }
+    // Zero disables the per-stage GPU timings (they read as 0 ms).
+    timestampPeriodNs = deviceProperties.limits.timestampComputeAndGraphics
+                            ? deviceProperties.limits.timestampPeriod
+                            : 0.0f;
+    if (usesIntermediate()) {
+        // Motion blur blends in float; plain supersampling renders in the
+        // slot format to halve the intermediate image's memory.
+        intermediateFormat = accumulating() ? ACCUM_FORMAT : imageFormat;
+        if (motionBlurSamples > ACCUM_HALF_MAX_SAMPLES) {
+            // fp32 blending is optional in the spec, unlike fp16.
+            VkFormatProperties wideProps;
+            vkGetPhysicalDeviceFormatProperties(
+                physicalDevice, ACCUM_FORMAT_WIDE, &wideProps);
+            const VkFormatFeatureFlags wideNeeds =
+                VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT |
+                (supersampling() ? VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+                                 : VK_FORMAT_FEATURE_BLIT_SRC_BIT);
+            if ((wideProps.optimalTilingFeatures & wideNeeds) == wideNeeds) {
+                intermediateFormat = ACCUM_FORMAT_WIDE;
+            } else {
+                spdlog::warn("Device can't blend in fp32; accumulating {} "
+                             "sub-frames in fp16 may band",
+                             motionBlurSamples);
+            }
+        }
+        VkFormatProperties intermediateProps;
+        vkGetPhysicalDeviceFormatProperties(
+            physicalDevice, intermediateFormat, &intermediateProps);
+        VkFormatProperties slotProps;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat,
+                                            &slotProps);
+        const VkFormatFeatureFlags features =
+            intermediateProps.optimalTilingFeatures;
+        // All of these are required for R16G16B16A16_SFLOAT and
+        // B8G8R8A8_UNORM by the spec, but check rather than fault.
+        if (accumulating() &&
+            !(features & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT)) {
+            throw std::runtime_error(
+                "Device can't blend into the motion blur accumulation image");
+        }
+        if (supersampling()
+                ? !(features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)
+                : (!(features & VK_FORMAT_FEATURE_BLIT_SRC_BIT) ||
+                   !(slotProps.optimalTilingFeatures &
+                     VK_FORMAT_FEATURE_BLIT_DST_BIT))) {
+            throw std::runtime_error(
+                "Device can't resolve the intermediate render image");
+        }
+        intermediateRenderPass = vkutils::createIntermediateRenderPass(
+            logicalDevice, intermediateFormat,
+            supersampling() ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                            : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    }
+    if (accumulating()) {
+        spdlog::info("Motion blur: {} sub-frames per frame, shutter {:.2f}",
+                     motionBlurSamples, shutter);
+    }
+    if (supersampling()) {
+        spdlog::info("Supersampling: rendering {}x{} per output pixel", ssaa,
+                     ssaa);
+    }
+    if (layered()) {
+        VkPhysicalDeviceVulkan12Features features12{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        };
+        VkPhysicalDeviceFeatures2 features{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &features12,
+        };
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+        if (!features12.shaderOutputLayer) {
+            throw std::runtime_error(
+                "Layered frames need the shaderOutputLayer device feature");
+        }
+        spdlog::info("Layered frames: {} frames per draw", frameLayers);
+    }
     commandPool = vkutils::createCommandPool(logicalDevice, graphicsQueueIndex);
 
-    auto vertSpirv = shader_utils::compileFullscreenQuadVertSpirv();
+    if (vulkanContext && !layered()) {
+        vertShaderModule = vulkanContext->vertShaderModule;
+        return;
+    }
+    auto vertSpirv = shader_utils::compileFullscreenQuadVertSpirv(frameLayers);
     vertShaderModule = vkutils::createShaderModule(logicalDevice, vertSpirv);
 }
 
+VkDeviceSize OfflineSDFRenderer::readbackBytes() const noexcept {
+    const VkDeviceSize pixelCount =
+        static_cast<VkDeviceSize>(renderExtent.width) *
+        static_cast<VkDeviceSize>(renderExtent.height);
+    if (gpuColorConversion != GpuColorConversion::None) {
+        // Full-res Y plane + quarter-res U and V (or interleaved UV).
+        return pixelCount + pixelCount / 2;
+    }
+    return pixelCount * readbackFormatInfo.bytesPerPixel;
+}
+
+void OfflineSDFRenderer::resolveTiling() {
+    // Supersampled tiles are rendered at ssaa x their size, which is what
+    // has to fit in an image.
+    const uint32_t maxDimension =
+        deviceProperties.limits.maxImageDimension2D / ssaa;
+    uint32_t tileSize = requestedTileSize;
+    if (tileSize == 0 &&
+        (imageSize.width > maxDimension || imageSize.height > maxDimension)) {
+        tileSize = maxDimension;
+        spdlog::info("{}x{} exceeds maxImageDimension2D ({}) / ssaa ({}); "
+                     "rendering in tiles",
+                     imageSize.width, imageSize.height,
+                     deviceProperties.limits.maxImageDimension2D, ssaa);
+    }
+    if (tileSize > maxDimension) {
+        throw std::runtime_error(
+            fmt::format("Tile size {} exceeds maxImageDimension2D ({}) / "
+                        "ssaa ({})",
+                        tileSize, deviceProperties.limits.maxImageDimension2D,
+                        ssaa));
+    }
+
+    renderExtent = imageSize;
+    if (tileSize != 0) {
+        renderExtent.width = std::min(tileSize, imageSize.width);
+        renderExtent.height = std::min(tileSize, imageSize.height);
+    }
+    tilesX = (imageSize.width + renderExtent.width - 1) / renderExtent.width;
+    tilesY = (imageSize.height + renderExtent.height - 1) / renderExtent.height;
+    if (tileCount() == 1)
+        return;
+
+    if (layered()) {
+        throw std::runtime_error(fmt::format(
+            "Layered frames need whole frames, but {}x{} has to be tiled",
+            imageSize.width, imageSize.height));
+    }
+    if (gpuColorConversion != GpuColorConversion::None) {
+        throw std::runtime_error(
+            "GPU color conversion needs whole frames; it can't be combined "
+            "with tiled rendering");
+    }
+    if (!useToyTemplate) {
+        spdlog::warn("Tiled render: non-toy shaders must add "
+                     "pc.iTileOffset to gl_FragCoord to place each tile");
+    }
+    stitchedFrame.resize(static_cast<size_t>(imageSize.width) *
+                         imageSize.height * readbackFormatInfo.bytesPerPixel);
+    spdlog::info("Rendering {}x{} tiles of {}x{}", tilesX, tilesY,
+                 renderExtent.width, renderExtent.height);
+}
+
+VkRect2D OfflineSDFRenderer::tileRect(uint32_t tileIndex) const noexcept {
+    // Row-major from the top-left; edge tiles are clipped to the frame.
+    const uint32_t x = (tileIndex % tilesX) * renderExtent.width;
+    const uint32_t y = (tileIndex / tilesX) * renderExtent.height;
+    return VkRect2D{
+        .offset = {static_cast<int32_t>(x), static_cast<int32_t>(y)},
+        .extent = {std::min(renderExtent.width, imageSize.width - x),
+                   std::min(renderExtent.height, imageSize.height - y)},
+    };
+}
+
 void OfflineSDFRenderer::setupRenderContext() {
-    const auto formatInfo = vkutils::getReadbackFormatInfo(imageFormat);
-    readbackFormatInfo = formatInfo;
-    VkDeviceSize imageBytes = static_cast<VkDeviceSize>(imageSize.width) *
-                              static_cast<VkDeviceSize>(imageSize.height) *
-                              formatInfo.bytesPerPixel;
+    readbackFormatInfo = vkutils::getReadbackFormatInfo(imageFormat);
+    resolveTiling();
+
+    maxRingSize = computeMaxRingSize();
+    ringSize = std::min(ringSize, maxRingSize);
+    targetRingSize = ringSize;
+    ringSlots.resize(maxRingSize);
+    // Unused slot indices, handed out lowest first when the ring grows.
+    retiredSlots.clear();
+    for (uint32_t i = maxRingSize; i > ringSize; --i) {
+        retiredSlots.push_back(i - 1);
+    }
+    if (adaptiveRing) {
+        spdlog::info("Adaptive ring: starting at {} slot(s), up to {}",
+                     ringSize, maxRingSize);
+    }
+
+    if (queryPool == VK_NULL_HANDLE) {
+        queryPool = vkutils::createQueryPool(logicalDevice, maxRingSize,
+                                             QUERIES_PER_SLOT);
+    }
+    if (frameTimeline == VK_NULL_HANDLE) {
+        frameTimeline = vkutils::createTimelineSemaphore(logicalDevice, 0);
+    }
+}
+
+void OfflineSDFRenderer::createRingSlot(uint32_t slotIndex) {
+    // Layers are read back one after the other.
+    const VkDeviceSize imageBytes = readbackBytes() * frameLayers;
+    const bool convertOnGpu = gpuColorConversion != GpuColorConversion::None;
+    RingSlot &slot = ringSlots[slotIndex];
 
     VkImageCreateInfo imageCreateInfo{
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .imageType = VK_IMAGE_TYPE_2D,
         .format = imageFormat,
-        .extent = {imageSize.width, imageSize.height, 1},
+        .extent = {renderExtent.width, renderExtent.height, 1},
         .mipLevels = 1,
-        .arrayLayers = 1,
+        .arrayLayers = frameLayers,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
         .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                 (convertOnGpu ? VK_IMAGE_USAGE_SAMPLED_BIT
+                               : VK_IMAGE_USAGE_TRANSFER_SRC_BIT) |
+                 (accumulating() && !supersampling()
+                      ? VK_IMAGE_USAGE_TRANSFER_DST_BIT
+                      : 0u),
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
     };
+    VK_CHECK(
+        vkCreateImage(logicalDevice, &imageCreateInfo, nullptr, &slot.image));
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(logicalDevice, slot.image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = vkutils::findMemoryTypeIndex(
+            physicalDevice, memRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    };
+
+    VK_CHECK(vkAllocateMemory(logicalDevice, &allocInfo, nullptr,
+                              &slot.imageMemory));
+    VK_CHECK(vkBindImageMemory(logicalDevice, slot.image, slot.imageMemory, 0));
 
-    VkImageViewCreateInfo imageViewCreateInfoTemplate{
+    VkImageViewCreateInfo imageViewCreateInfo{
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .image = slot.image,
+        .viewType =
+            layered() ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D,
         .format = imageFormat,
-        // Image will be filled in later to be offscreen image
-        // .image = ... ring slot image ...
         .subresourceRange =
             {
                 .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
                 .baseMipLevel = 0,
                 .levelCount = 1,
                 .baseArrayLayer = 0,
-                .layerCount = 1,
+                .layerCount = frameLayers,
             },
     };
+    VK_CHECK(vkCreateImageView(logicalDevice, &imageViewCreateInfo, nullptr,
+                               &slot.imageView));
 
-    VkFramebufferCreateInfo framebufferInfoTemplate{
+    VkFramebufferCreateInfo framebufferInfo{
         .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
         .renderPass = renderPass,
         .attachmentCount = 1,
-        // Attachment will be filled later to be offscreen image view
-        // .pAttachments = ... ring slot image view ...
-        .width = imageSize.width,
-        .height = imageSize.height,
-        .layers = 1,
+        .pAttachments = &slot.imageView,
+        .width = renderExtent.width,
+        .height = renderExtent.height,
+        .layers = frameLayers,
     };
+    VK_CHECK(vkCreateFramebuffer(logicalDevice, &framebufferInfo, nullptr,
+                                 &slot.framebuffer));
+
+    // With GPU conversion the compute pass writes the YUV planes
+    // straight into this buffer instead of a transfer copy.
+    slot.stagingBuffer = vkutils::createHostReadbackBuffer(
+        logicalDevice, physicalDevice, imageBytes,
+        convertOnGpu ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                     : VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    slot.rowStride = convertOnGpu ? renderExtent.width
+                                  : renderExtent.width *
+                                        readbackFormatInfo.bytesPerPixel;
+
+    // Whole allocation, so invalidating VK_WHOLE_SIZE is a valid range on
+    // non-coherent memory.
+    VK_CHECK(vkMapMemory(logicalDevice, slot.stagingBuffer.memory, 0,
+                         VK_WHOLE_SIZE, 0, &slot.mappedData));
+    if (slotIndex == 0) {
+        spdlog::debug("Readback staging memory is {}",
+                      slot.stagingBuffer.hostCoherent
+                          ? "host coherent"
+                          : "host cached (invalidated per frame)");
+    }
 
-    for (uint32_t i = 0; i < ringSize; ++i) {
-        RingSlot &slot = ringSlots[i];
-        VK_CHECK(vkCreateImage(logicalDevice, &imageCreateInfo, nullptr,
-                               &slot.image));
-
-        VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(logicalDevice, slot.image,
-                                     &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo{
-            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-            .allocationSize = memRequirements.size,
-            .memoryTypeIndex = vkutils::findMemoryTypeIndex(
-                physicalDevice, memRequirements.memoryTypeBits,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
-        };
+    slot.commandBuffer =
+        vkutils::allocateCommandBuffer(logicalDevice, commandPool);
+    if (convertOnGpu)
+        writeConvertDescriptorSet(slot);
+    if (usesIntermediate())
+        createIntermediateTarget(slot);
+
+    // The slot's first command buffer moves the image out of UNDEFINED,
+    // so growing the ring mid-render doesn't drain the queue.
+    slot.recordedExtent = {};
+    slot.needsInitialLayout = true;
+}
 
-        VK_CHECK(vkAllocateMemory(logicalDevice, &allocInfo, nullptr,
-                                  &slot.imageMemory));
-        VK_CHECK(
-            vkBindImageMemory(logicalDevice, slot.image, slot.imageMemory, 0));
+void OfflineSDFRenderer::createIntermediateTarget(RingSlot &slot) {
+    const VkExtent2D extent = scaled(renderExtent);
+    VkImageCreateInfo imageCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = intermediateFormat,
+        .extent = {extent.width, extent.height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                 (supersampling() ? VK_IMAGE_USAGE_SAMPLED_BIT
+                                  : VK_IMAGE_USAGE_TRANSFER_SRC_BIT),
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    VK_CHECK(vkCreateImage(logicalDevice, &imageCreateInfo, nullptr,
+                           &slot.intermediateImage));
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(logicalDevice, slot.intermediateImage,
+                                 &memRequirements);
+    VkMemoryAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = vkutils::findMemoryTypeIndex(
+            physicalDevice, memRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    };
+    VK_CHECK(vkAllocateMemory(logicalDevice, &allocInfo, nullptr,
+                              &slot.intermediateImageMemory));
+    VK_CHECK(vkBindImageMemory(logicalDevice, slot.intermediateImage,
+                               slot.intermediateImageMemory, 0));
 
-        imageViewCreateInfoTemplate.image = slot.image;
-        VK_CHECK(vkCreateImageView(logicalDevice, &imageViewCreateInfoTemplate,
-                                   nullptr, &slot.imageView));
+    VkImageViewCreateInfo imageViewCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = slot.intermediateImage,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = intermediateFormat,
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+    };
+    VK_CHECK(vkCreateImageView(logicalDevice, &imageViewCreateInfo, nullptr,
+                               &slot.intermediateImageView));
 
-        framebufferInfoTemplate.pAttachments = &slot.imageView;
-        VK_CHECK(vkCreateFramebuffer(logicalDevice, &framebufferInfoTemplate,
-                                     nullptr, &slot.framebuffer));
+    VkFramebufferCreateInfo framebufferInfo{
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = intermediateRenderPass,
+        .attachmentCount = 1,
+        .pAttachments = &slot.intermediateImageView,
+        .width = extent.width,
+        .height = extent.height,
+        .layers = 1,
+    };
+    VK_CHECK(vkCreateFramebuffer(logicalDevice, &framebufferInfo, nullptr,
+                                 &slot.intermediateFramebuffer));
+
+    if (!supersampling())
+        return;
+    // The downsample pass samples this image into the slot image.
+    VkDescriptorImageInfo imageInfo{
+        .sampler = downsampleSampler,
+        .imageView = slot.intermediateImageView,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = slot.downsampleDescriptorSet,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &imageInfo,
+    };
+    vkUpdateDescriptorSets(logicalDevice, 1, &write, 0, nullptr);
+}
 
-        slot.stagingBuffer = vkutils::createReadbackBuffer(
-            logicalDevice, physicalDevice, imageBytes,
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        slot.rowStride = imageSize.width * formatInfo.bytesPerPixel;
+void OfflineSDFRenderer::setupColorConversion() {
+    if (gpuColorConversion == GpuColorConversion::None) {
+        return;
+    }
 
-        VK_CHECK(vkMapMemory(logicalDevice, slot.stagingBuffer.memory, 0,
-                             imageBytes, 0, &slot.mappedData));
+    convertSampler = vkutils::createNearestSampler(logicalDevice);
 
-        vkutils::transitionImageLayout(
-            logicalDevice, commandPool, queue, slot.image,
-            VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    const std::vector<VkDescriptorSetLayoutBinding> bindings = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+    };
+    convertDescriptorSetLayout =
+        vkutils::createDescriptorSetLayout(logicalDevice, bindings);
+
+    const std::vector<VkDescriptorPoolSize> poolSizes = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxRingSize},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxRingSize},
+    };
+    convertDescriptorPool =
+        vkutils::createDescriptorPool(logicalDevice, poolSizes, maxRingSize);
+
+    // One descriptor set per potential ring slot, written once the slot's
+    // image and readback buffer exist (see writeConvertDescriptorSet).
+    for (RingSlot &slot : ringSlots) {
+        slot.convertDescriptorSet = vkutils::allocateDescriptorSet(
+            convertDescriptorPool, logicalDevice, convertDescriptorSetLayout);
     }
 
-    if (queryPool == VK_NULL_HANDLE) {
-        queryPool = vkutils::createQueryPool(logicalDevice, ringSize);
+    const VkPushConstantRange pushConstantRange{
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(vkutils::YuvConvertPushConstants),
+    };
+    convertPipelineLayout = vkutils::createPipelineLayout(
+        logicalDevice, convertDescriptorSetLayout, pushConstantRange);
+    auto compSpirv = shader_utils::compileRgbaToYuvCompSpirv();
+    convertShaderModule = vkutils::createShaderModule(logicalDevice, compSpirv);
+    convertPipeline = vkutils::createComputePipeline(
+        logicalDevice, convertPipelineLayout, convertShaderModule,
+        pipelineCache);
+}
+
+void OfflineSDFRenderer::setupSupersampling() {
+    if (!supersampling()) {
+        return;
     }
-    if (fences.count == 0) {
-        fences = vkutils::createFences(logicalDevice, ringSize);
+
+    // texelFetch ignores filtering, but a combined sampler is still needed.
+    downsampleSampler = vkutils::createNearestSampler(logicalDevice);
+
+    const std::vector<VkDescriptorSetLayoutBinding> bindings = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+    };
+    downsampleDescriptorSetLayout =
+        vkutils::createDescriptorSetLayout(logicalDevice, bindings);
+
+    const std::vector<VkDescriptorPoolSize> poolSizes = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxRingSize},
+    };
+    downsampleDescriptorPool =
+        vkutils::createDescriptorPool(logicalDevice, poolSizes, maxRingSize);
+    // Written once the slot's intermediate image exists (see
+    // createIntermediateTarget).
+    for (RingSlot &slot : ringSlots) {
+        slot.downsampleDescriptorSet = vkutils::allocateDescriptorSet(
+            downsampleDescriptorPool, logicalDevice,
+            downsampleDescriptorSetLayout);
     }
+
+    const VkPushConstantRange pushConstantRange{
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .offset = 0,
+        .size = sizeof(uint32_t),
+    };
+    downsamplePipelineLayout = vkutils::createPipelineLayout(
+        logicalDevice, downsampleDescriptorSetLayout, pushConstantRange);
+    auto fragSpirv = shader_utils::compileBoxDownsampleFragSpirv();
+    downsampleShaderModule =
+        vkutils::createShaderModule(logicalDevice, fragSpirv);
+    downsamplePipeline = vkutils::createGraphicsPipeline(
+        logicalDevice, renderPass, downsamplePipelineLayout, renderExtent,
+        vertShaderModule, downsampleShaderModule, std::nullopt, pipelineCache);
+}
+
+void OfflineSDFRenderer::setupFrameInputs() {
+    frameInputSetLayout = vulkanContext
+                              ? vulkanContext->frameInputSetLayout
+                              : createFrameInputSetLayout(logicalDevice);
+    const std::vector<VkDescriptorPoolSize> poolSizes = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+    };
+    frameInputPool =
+        vkutils::createDescriptorPool(logicalDevice, poolSizes, 1);
+    frameInputSet = vkutils::allocateDescriptorSet(
+        frameInputPool, logicalDevice, frameInputSetLayout);
+
+    // Entries sit at dynamic offsets, which must be multiples of the
+    // device's alignment (a power of two).
+    const VkDeviceSize alignment = std::max<VkDeviceSize>(
+        deviceProperties.limits.minUniformBufferOffsetAlignment, 1);
+    const VkDeviceSize entryBytes =
+        sizeof(vkutils::PushConstants) * frameLayers;
+    frameInputStride = (entryBytes + alignment - 1) & ~(alignment - 1);
+    const VkDeviceSize bufferBytes =
+        frameInputStride * maxRingSize * motionBlurSamples;
+    frameInputBuffer = vkutils::createHostUploadBuffer(
+        logicalDevice, physicalDevice, bufferBytes,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    void *mapped = nullptr;
+    VK_CHECK(vkMapMemory(logicalDevice, frameInputBuffer.memory, 0,
+                         bufferBytes, 0, &mapped));
+    frameInputData = static_cast<uint8_t *>(mapped);
+
+    VkDescriptorBufferInfo bufferInfo{
+        .buffer = frameInputBuffer.buffer,
+        .offset = 0,
+        .range = entryBytes,
+    };
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = frameInputSet,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        .pBufferInfo = &bufferInfo,
+    };
+    vkUpdateDescriptorSets(logicalDevice, 1, &write, 0, nullptr);
+}
+
+void OfflineSDFRenderer::writeConvertDescriptorSet(const RingSlot &slot) {
+    // The slot's image as input and its readback buffer as plane output.
+    VkDescriptorImageInfo imageInfo{
+        .sampler = convertSampler,
+        .imageView = slot.imageView,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    VkDescriptorBufferInfo bufferInfo{
+        .buffer = slot.stagingBuffer.buffer,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    const std::array<VkWriteDescriptorSet, 2> writes = {{
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = slot.convertDescriptorSet,
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &imageInfo,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = slot.convertDescriptorSet,
+            .dstBinding = 1,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &bufferInfo,
+        },
+    }};
+    vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(writes.size()),
+                           writes.data(), 0, nullptr);
 }
 
 void OfflineSDFRenderer::createPipeline() {
-    createPipelineLayoutCommon();
-    auto fragSpirv =
-        shader_utils::compileFileToSpirv(fragShaderPath, useToyTemplate);
+    pipelineLayout =
+        vulkanContext
+            ? vulkanContext->pipelineLayout
+            : createFramePipelineLayout(logicalDevice, frameInputSetLayout);
+    // Warm pipelines draw straight into the shared render pass with the
+    // shared vertex module.
+    const bool warm = vulkanContext && !pipelineKey.empty() &&
+                      !usesIntermediate() && !layered();
+    if (warm) {
+        if (const auto *cached = vulkanContext->findPipeline(pipelineKey)) {
+            spdlog::info("Reusing warm pipeline {}", pipelineKey);
+            fragShaderModule = cached->fragShaderModule;
+            pipeline = cached->pipeline;
+            frameInputsInBuffer = cached->frameInputsInBuffer;
+            ownsPipeline = false;
+            return;
+        }
+    }
+    const std::vector<uint32_t> fragSpirv =
+        precompiledFragSpirv
+            ? std::move(*precompiledFragSpirv)
+            : compileFragment(fragShaderPath, useToyTemplate, frameLayers);
+    precompiledFragSpirv.reset();
+    frameInputsInBuffer = !shader_utils::usesPushConstants(fragSpirv);
+    if (layered() && !frameInputsInBuffer) {
+        throw std::runtime_error(
+            "Layered frames need the shader to read VSDF_FRAME_LAYERS "
+            "inputs, not push constants (see shaders/vulktemplate.frag)");
+    }
+    if (layered() && !shader_utils::readsFrameLayer(fragSpirv)) {
+        // Every layer would draw layer 0's frame.
+        throw std::runtime_error(
+            "Layered frames need the shader to index its inputs by the "
+            "vsdfLayer input under VSDF_FRAME_LAYERS (see "
+            "shaders/vulktemplate.frag)");
+    }
+    if (!frameInputsInBuffer) {
+        spdlog::info("Shader reads push constants; recording command "
+                     "buffers every frame (see shaders/vulktemplate.frag "
+                     "for the VSDF_FRAME_UBO block)");
+    }
     fragShaderModule = vkutils::createShaderModule(logicalDevice, fragSpirv);
+    if (usesIntermediate()) {
+        std::optional<float> accumulateWeight;
+        if (accumulating())
+            accumulateWeight = 1.0f / static_cast<float>(motionBlurSamples);
+        pipeline = vkutils::createGraphicsPipeline(
+            logicalDevice, intermediateRenderPass, pipelineLayout,
+            scaled(renderExtent), vertShaderModule, fragShaderModule,
+            accumulateWeight, pipelineCache);
+        return;
+    }
     pipeline = vkutils::createGraphicsPipeline(
-        logicalDevice, renderPass, pipelineLayout, imageSize, vertShaderModule,
-        fragShaderModule);
+        logicalDevice, renderPass, pipelineLayout, renderExtent, vertShaderModule,
+        fragShaderModule, std::nullopt, pipelineCache);
+    if (warm) {
+        vulkanContext->addPipeline(
+            pipelineKey, {.fragShaderModule = fragShaderModule,
+                          .pipeline = pipeline,
+                          .frameInputsInBuffer = frameInputsInBuffer,
+                          .lastUsed = 0});
+        ownsPipeline = false;
+    }
+}
+
+std::vector<uint32_t>
+OfflineSDFRenderer::compileFragment(const std::string &fragShaderPath,
+                                    bool useToyTemplate,
+                                    uint32_t frameLayers) {
+    return shader_utils::compileFileToSpirv(
+        fragShaderPath, useToyTemplate,
+        shader_utils::FrameInputs::UniformBuffer, frameLayers);
 }
 
-void OfflineSDFRenderer::createCommandBuffers() {
-    commandBuffers =
-        vkutils::createCommandBuffers(logicalDevice, commandPool, ringSize);
+std::vector<uint32_t>
+OfflineSDFRenderer::compileFragmentSource(const std::string &source,
+                                          const std::string &fragShaderPath,
+                                          bool useToyTemplate,
+                                          uint32_t frameLayers) {
+    return shader_utils::compileSourceToSpirv(
+        source, fragShaderPath, useToyTemplate,
+        shader_utils::FrameInputs::UniformBuffer, frameLayers);
 }
 
-void OfflineSDFRenderer::recordCommandBuffer(uint32_t slotIndex,
-                                             uint32_t currentFrame) {
+void OfflineSDFRenderer::recordCommandBuffer(const EncodeItem &item) {
+    const uint32_t slotIndex = item.slotIndex;
     RingSlot &slot = ringSlots[slotIndex];
-    VkCommandBuffer commandBuffer = commandBuffers.commandBuffers[slotIndex];
+    // The tile's part of the frame, drawn at the image origin (and at
+    // ssaa x its size when supersampling).
+    const VkRect2D tile = tileRect(item.tileIndex);
+    // Frame inputs are read from frameInputBuffer at the slot's offsets,
+    // so the last recording is reusable unless the tile size changed
+    // (edge tiles are clipped).
+    if (frameInputsInBuffer && !slot.needsInitialLayout &&
+        slot.recordedExtent.width == tile.extent.width &&
+        slot.recordedExtent.height == tile.extent.height)
+        return;
+    const VkExtent2D drawExtent = scaled(tile.extent);
+    VkCommandBuffer commandBuffer = slot.commandBuffer;
     vkResetCommandBuffer(commandBuffer, 0);
 
     VkCommandBufferBeginInfo beginInfo{
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .flags = frameInputsInBuffer
+                     ? 0u
+                     : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     };
 
+    // Motion blur and supersampling draw into the intermediate image,
+    // cleared to zero.
+    const VkClearValue intermediateClear{};
     VkRenderPassBeginInfo renderPassBeginInfo{
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .renderPass = renderPass,
-        .framebuffer = slot.framebuffer,
-        .renderArea = {{0, 0}, imageSize},
-        .clearValueCount = 0,
+        .renderPass =
+            usesIntermediate() ? intermediateRenderPass : renderPass,
+        .framebuffer = usesIntermediate() ? slot.intermediateFramebuffer
+                                          : slot.framebuffer,
+        .renderArea = {{0, 0}, drawExtent},
+        .clearValueCount = usesIntermediate() ? 1u : 0u,
+        .pClearValues = usesIntermediate() ? &intermediateClear : nullptr,
     };
 
     VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
-    vkCmdResetQueryPool(commandBuffer, queryPool, slotIndex * 2, 2);
+    const uint32_t firstQuery = slotIndex * QUERIES_PER_SLOT;
+    vkCmdResetQueryPool(commandBuffer, queryPool, firstQuery,
+                        QUERIES_PER_SLOT);
     vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                        queryPool, slotIndex * 2);
+                        queryPool, firstQuery);
+    // Only the first recording transitions; later frames find the image
+    // in COLOR_ATTACHMENT_OPTIMAL, where the render pass leaves it.
+    const bool initialLayout = slot.needsInitialLayout;
+    if (initialLayout) {
+        vkutils::recordImageLayoutTransition(
+            commandBuffer, slot.image, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        slot.needsInitialLayout = false;
+    }
     vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
                          VK_SUBPASS_CONTENTS_INLINE);
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
-    const vkutils::PushConstants pushConstants = getPushConstants(currentFrame);
-    vkCmdPushConstants(commandBuffer, pipelineLayout,
-                       VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-                       sizeof(vkutils::PushConstants), &pushConstants);
-
     VkRect2D scissor{
         .offset = {0, 0},
-        .extent = {imageSize.width, imageSize.height},
+        .extent = drawExtent,
     };
 
     VkViewport viewport{
         .x = 0.0f,
         .y = 0.0f,
-        .width = static_cast<float>(imageSize.width),
-        .height = static_cast<float>(imageSize.height),
+        .width = static_cast<float>(drawExtent.width),
+        .height = static_cast<float>(drawExtent.height),
         .minDepth = 0.0f,
         .maxDepth = 1.0f,
     };
@@ -213,11 +1015,167 @@ void OfflineSDFRenderer::recordCommandBuffer(uint32_t slotIndex,
     vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+    // One draw per motion blur sub-frame (a single draw without blur).
+    for (uint32_t sample = 0; sample < motionBlurSamples; ++sample) {
+        if (frameInputsInBuffer) {
+            const uint32_t offset = frameInputOffset(slotIndex, sample);
+            vkCmdBindDescriptorSets(commandBuffer,
+                                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    pipelineLayout, 0, 1, &frameInputSet, 1,
+                                    &offset);
+        } else {
+            const vkutils::PushConstants pushConstants = getPushConstants(
+                item.frameIndex, tile.offset,
+                motion_blur::subframeOffset(item.frameIndex, sample,
+                                            motionBlurSamples, shutter));
+            vkCmdPushConstants(commandBuffer, pipelineLayout,
+                               VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                               sizeof(vkutils::PushConstants),
+                               &pushConstants);
+        }
+        // One instance per layer; the vertex shader sets gl_Layer.
+        vkCmdDraw(commandBuffer, 6, frameLayers, 0, 0);
+    }
+    vkCmdEndRenderPass(commandBuffer);
+    if (supersampling())
+        recordDownsample(commandBuffer, slot, tile.extent);
+    else if (accumulating())
+        recordAccumResolve(commandBuffer, slot, tile.extent);
+    // Render time includes all sub-frames and the resolve, so it scales
+    // with the sample count and ssaa^2 while readback stays one frame.
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        queryPool, firstQuery + 1);
+
+    if (gpuColorConversion != GpuColorConversion::None) {
+        recordColorConversion(commandBuffer, slot);
+    } else {
+        recordReadbackCopy(commandBuffer, slot, tile.extent);
+    }
     vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                        queryPool, slotIndex * 2 + 1);
+                        queryPool, firstQuery + 2);
+
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+    // The next submit re-records without the transition.
+    if (frameInputsInBuffer && !initialLayout)
+        slot.recordedExtent = tile.extent;
+}
+
+void OfflineSDFRenderer::recordAccumResolve(VkCommandBuffer commandBuffer,
+                                            const RingSlot &slot,
+                                            VkExtent2D extent) {
+    // The intermediate render pass already left intermediateImage in
+    // TRANSFER_SRC_OPTIMAL; the slot image becomes the blit target.
+    VkImageMemoryBarrier barrierToTransferDst{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = slot.image,
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+    };
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrierToTransferDst);
+
+    // Same size, so this is a per-pixel float -> UNORM conversion (clamped).
+    const VkImageSubresourceLayers layers{
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .mipLevel = 0,
+        .baseArrayLayer = 0,
+        .layerCount = 1,
+    };
+    const VkOffset3D end{static_cast<int32_t>(extent.width),
+                         static_cast<int32_t>(extent.height), 1};
+    VkImageBlit blit{
+        .srcSubresource = layers,
+        .srcOffsets = {{0, 0, 0}, end},
+        .dstSubresource = layers,
+        .dstOffsets = {{0, 0, 0}, end},
+    };
+    vkCmdBlitImage(commandBuffer, slot.intermediateImage,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                   VK_FILTER_NEAREST);
+
+    // Back to the layout the readback/convert paths expect, with the blit
+    // visible to whichever of them runs next.
+    VkImageMemoryBarrier barrierToColor{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                         VK_ACCESS_TRANSFER_READ_BIT |
+                         VK_ACCESS_SHADER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = slot.image,
+        .subresourceRange = barrierToTransferDst.subresourceRange,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_TRANSFER_BIT |
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrierToColor);
+}
+
+void OfflineSDFRenderer::recordDownsample(VkCommandBuffer commandBuffer,
+                                          const RingSlot &slot,
+                                          VkExtent2D extent) {
+    // The intermediate render pass left its image in
+    // SHADER_READ_ONLY_OPTIMAL; this pass writes the slot image the same
+    // way an ordinary render would, so readback/convert are unchanged.
+    VkRenderPassBeginInfo renderPassBeginInfo{
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = renderPass,
+        .framebuffer = slot.framebuffer,
+        .renderArea = {{0, 0}, extent},
+        .clearValueCount = 0,
+        .pClearValues = nullptr,
+    };
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      downsamplePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            downsamplePipelineLayout, 0, 1,
+                            &slot.downsampleDescriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, downsamplePipelineLayout,
+                       VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t),
+                       &ssaa);
+
+    const VkRect2D scissor{
+        .offset = {0, 0},
+        .extent = extent,
+    };
+    const VkViewport viewport{
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = static_cast<float>(extent.width),
+        .height = static_cast<float>(extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
     vkCmdEndRenderPass(commandBuffer);
+}
 
+void OfflineSDFRenderer::recordReadbackCopy(VkCommandBuffer commandBuffer,
+                                            const RingSlot &slot,
+                                            VkExtent2D extent) {
     // Transition image layout to TRANSFER_SRC_OPTIMAL so we can
     // copy it to the staging buffer.
     VkImageMemoryBarrier barrierToTransfer{
@@ -235,7 +1193,7 @@ void OfflineSDFRenderer::recordCommandBuffer(uint32_t slotIndex,
                 .baseMipLevel = 0,
                 .levelCount = 1,
                 .baseArrayLayer = 0,
-                .layerCount = 1,
+                .layerCount = frameLayers,
             },
     };
 
@@ -244,6 +1202,7 @@ void OfflineSDFRenderer::recordCommandBuffer(uint32_t slotIndex,
                          VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
                          nullptr, 1, &barrierToTransfer);
 
+    // All layers in one copy, packed back to back in the staging buffer.
     VkBufferImageCopy region{
         .bufferOffset = 0,
         .bufferRowLength = 0,
@@ -253,10 +1212,10 @@ void OfflineSDFRenderer::recordCommandBuffer(uint32_t slotIndex,
                 .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
                 .mipLevel = 0,
                 .baseArrayLayer = 0,
-                .layerCount = 1,
+                .layerCount = frameLayers,
             },
         .imageOffset = {0, 0, 0},
-        .imageExtent = {imageSize.width, imageSize.height, 1},
+        .imageExtent = {extent.width, extent.height, 1},
     };
 
     vkCmdCopyImageToBuffer(commandBuffer, slot.image,
@@ -280,30 +1239,186 @@ void OfflineSDFRenderer::recordCommandBuffer(uint32_t slotIndex,
                 .baseMipLevel = 0,
                 .levelCount = 1,
                 .baseArrayLayer = 0,
-                .layerCount = 1,
+                .layerCount = frameLayers,
             },
     };
 
+    // Make the copy visible to the host (needed for cached staging memory).
+    VkBufferMemoryBarrier copyToHost{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = slot.stagingBuffer.buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+
     vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0,
-                         nullptr, 0, nullptr, 1, &barrierToColor);
+                         VK_PIPELINE_STAGE_HOST_BIT |
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         0, 0, nullptr, 1, &copyToHost, 1, &barrierToColor);
+}
 
-    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+void OfflineSDFRenderer::recordColorConversion(VkCommandBuffer commandBuffer,
+                                               const RingSlot &slot) {
+    // Rendered image becomes the compute pass input.
+    VkImageMemoryBarrier barrierToSampled{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = slot.image,
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+    };
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &barrierToSampled);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      convertPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            convertPipelineLayout, 0, 1,
+                            &slot.convertDescriptorSet, 0, nullptr);
+    const vkutils::YuvConvertPushConstants pushConstants =
+        getConvertPushConstants();
+    vkCmdPushConstants(commandBuffer, convertPipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(vkutils::YuvConvertPushConstants),
+                       &pushConstants);
+
+    // One invocation per 8x2 block, 8x8 invocations per workgroup.
+    const uint32_t blocksX = imageSize.width / 8;
+    const uint32_t blocksY = imageSize.height / 2;
+    vkCmdDispatch(commandBuffer, (blocksX + 7) / 8, (blocksY + 7) / 8, 1);
+
+    // Make the plane writes visible to the host and hand the image back
+    // to the render pass for the next frame.
+    VkBufferMemoryBarrier planesToHost{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = slot.stagingBuffer.buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+
+    VkImageMemoryBarrier barrierToColor{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = slot.image,
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+    };
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT |
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         0, 0, nullptr, 1, &planesToHost, 1, &barrierToColor);
+}
+
+vkutils::YuvConvertPushConstants
+OfflineSDFRenderer::getConvertPushConstants() const noexcept {
+    const uint32_t lumaBytes = imageSize.width * imageSize.height;
+    const uint32_t chromaPlaneBytes = lumaBytes / 4;
+    return vkutils::YuvConvertPushConstants{
+        .width = imageSize.width,
+        .height = imageSize.height,
+        .chromaOffset = lumaBytes,
+        .crOffset = lumaBytes + chromaPlaneBytes,
+        .interleaved = gpuColorConversion == GpuColorConversion::NV12 ? 1u : 0u,
+    };
 }
 
 vkutils::PushConstants
-OfflineSDFRenderer::getPushConstants(uint32_t currentFrame) noexcept {
-    const float elapsed = static_cast<float>(currentFrame) /
-                          static_cast<float>(encodeSettings.fps);
-    return buildPushConstants(elapsed, currentFrame,
-                              glm::vec2(imageSize.width, imageSize.height));
+OfflineSDFRenderer::getPushConstants(uint32_t currentFrame,
+                                     VkOffset2D tileOffset,
+                                     float frameOffset) noexcept {
+    const float fps = static_cast<float>(encodeSettings.fps);
+    const float elapsed =
+        frameTimes.empty()
+            ? (static_cast<float>(currentFrame) + frameOffset) / fps
+            : frameTimes[currentFrame] + frameOffset / fps;
+    // Shaders see the supersampled frame: resolution and tile offset are
+    // in ssaa x pixels, matching gl_FragCoord in the intermediate image.
+    const VkExtent2D resolution = scaled(imageSize);
+    vkutils::PushConstants pushConstants = buildPushConstants(
+        elapsed, currentFrame, glm::vec2(resolution.width, resolution.height));
+    const float scale = static_cast<float>(ssaa);
+    pushConstants.iTileOffset =
+        glm::vec2(static_cast<float>(tileOffset.x) * scale,
+                  static_cast<float>(tileOffset.y) * scale);
+    return pushConstants;
+}
+
+void OfflineSDFRenderer::writeFrameInputs(const EncodeItem &item) {
+    // The slot's previous frame has been encoded (that's what freed the
+    // slot), so the GPU is done reading these entries. The memory is
+    // coherent and vkQueueSubmit makes the writes visible.
+    // Layered slots get one entry per layer, frame frameIndex + layer. A
+    // short last batch leaves the layers past frameCount stale: they are
+    // still drawn but never read back, and frameTimes has no entry there.
+    const VkOffset2D tileOffset = tileRect(item.tileIndex).offset;
+    for (uint32_t sample = 0; sample < motionBlurSamples; ++sample) {
+        uint8_t *entry =
+            frameInputData + frameInputOffset(item.slotIndex, sample);
+        for (uint32_t layer = 0; layer < item.frameCount; ++layer) {
+            const uint32_t frameIndex = item.frameIndex + layer;
+            const vkutils::PushConstants inputs = getPushConstants(
+                frameIndex, tileOffset,
+                motion_blur::subframeOffset(frameIndex, sample,
+                                            motionBlurSamples, shutter));
+            std::memcpy(entry + layer * sizeof(inputs), &inputs,
+                        sizeof(inputs));
+        }
+    }
+}
+
+void OfflineSDFRenderer::stitchTile(const RingSlot &slot, uint32_t tileIndex) {
+    const VkRect2D tile = tileRect(tileIndex);
+    const size_t bytesPerPixel = readbackFormatInfo.bytesPerPixel;
+    const size_t rowBytes = tile.extent.width * bytesPerPixel;
+    const size_t dstStride = imageSize.width * bytesPerPixel;
+    // Tile rows are tightly packed in the staging buffer.
+    const uint8_t *src = static_cast<const uint8_t *>(slot.mappedData);
+    uint8_t *dst = stitchedFrame.data() +
+                   static_cast<size_t>(tile.offset.y) * dstStride +
+                   static_cast<size_t>(tile.offset.x) * bytesPerPixel;
+    for (uint32_t row = 0; row < tile.extent.height; ++row) {
+        std::memcpy(dst + row * dstStride, src + row * rowBytes, rowBytes);
+    }
 }
 
 PPMDebugFrame
-OfflineSDFRenderer::debugReadbackOffscreenImage(const RingSlot &slot) {
+OfflineSDFRenderer::debugReadbackOffscreenImage(const uint8_t *data) const {
     // Only for debug PPM dump
     const auto formatInfo = readbackFormatInfo;
-    const uint8_t *data = static_cast<const uint8_t *>(slot.mappedData);
 
     PPMDebugFrame frame;
     frame.allocateRGB(imageSize.width, imageSize.height);
@@ -336,44 +1451,179 @@ OfflineSDFRenderer::debugReadbackOffscreenImage(const RingSlot &slot) {
 void OfflineSDFRenderer::renderFrames() {
     uint32_t totalFrames = maxFrames;
     startEncoding();
-    for (uint32_t currentFrame = 0; currentFrame < totalFrames;
-         ++currentFrame) {
-        const uint32_t slotIndex = currentFrame % ringSize;
-        waitForSlotEncode(slotIndex);
-
-        VK_CHECK(vkResetFences(logicalDevice, 1, &fences.fences[slotIndex]));
-        recordCommandBuffer(slotIndex, currentFrame);
-
-        VkSubmitInfo submitInfo{
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &commandBuffers.commandBuffers[slotIndex],
+    std::vector<EncodeItem> batch;
+    batch.reserve(maxRingSize);
+    uint32_t currentFrame = frameStart;
+    uint32_t currentTile = 0;
+    const auto nextItem = [&](uint32_t slotIndex) {
+        // Layered slots take the next frameLayers frames (tiling is off).
+        const EncodeItem item{
+            .slotIndex = slotIndex,
+            .frameIndex = currentFrame,
+            .tileIndex = currentTile,
+            .frameCount = std::min(frameLayers, totalFrames - currentFrame),
         };
-        VK_CHECK(
-            vkQueueSubmit(queue, 1, &submitInfo, fences.fences[slotIndex]));
-        enqueueEncode(slotIndex, currentFrame);
+        if (++currentTile == tileCount()) {
+            currentTile = 0;
+            currentFrame += item.frameCount;
+        }
+        return item;
+    };
+    while (currentFrame < totalFrames) {
+        // Block for one free slot, then fill the batch: with submitBatch
+        // set, wait for that many slots (every other slot is in flight and
+        // comes back once encoded); otherwise take any others the encoder
+        // has already released. Either way they go out in one
+        // vkQueueSubmit.
+        // Slot indices only follow currentFrame % ringSize while the ring
+        // depth is fixed; an adaptive ring grows and retires slots.
+        // Each item is one tile of a frame (the whole frame when untiled).
+        batch.clear();
+        batch.push_back(nextItem(acquireFreeSlot()));
+        const uint32_t batchLimit =
+            submitBatch > 0 ? std::min(submitBatch, ringSize) : ringSize;
+        while (currentFrame < totalFrames && batch.size() < batchLimit) {
+            if (submitBatch > 0) {
+                batch.push_back(nextItem(waitFreeSlot()));
+                continue;
+            }
+            const auto slotIndex = freeSlots->tryPop();
+            if (!slotIndex)
+                break;
+            batch.push_back(nextItem(*slotIndex));
+        }
+
+        submitFrames(batch);
+        for (const EncodeItem &item : batch) {
+            enqueueEncode(item);
+        }
     }
 
     // Finalize after the for loop finished
     stopEncoding();
+    if (checkpoint)
+        render_checkpoint::finishRender(*checkpoint,
+                                        encodeSettings.outputPath);
 
     spdlog::info("Offline render done.");
     destroy();
 }
 
+void OfflineSDFRenderer::submitFrames(std::vector<EncodeItem> &batch) {
+    using Clock = std::chrono::steady_clock;
+    using Ms = std::chrono::duration<double, std::milli>;
+    // One VkSubmitInfo per tile so each tile signals its own timeline
+    // value; no fences to reset since the value only ever increases.
+    submitSignalValues.resize(batch.size());
+    submitTimelineInfos.resize(batch.size());
+    submitInfos.resize(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        EncodeItem &item = batch[i];
+        const auto recordStart = Clock::now();
+        if (frameInputsInBuffer)
+            writeFrameInputs(item);
+        recordCommandBuffer(item);
+        item.recordMs = Ms(Clock::now() - recordStart).count();
+
+        // A layered slot is done once its last frame is.
+        submitSignalValues[i] = tileDoneValue(
+            item.frameIndex + item.frameCount - 1, item.tileIndex);
+        submitTimelineInfos[i] = VkTimelineSemaphoreSubmitInfo{
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &submitSignalValues[i],
+        };
+        submitInfos[i] = VkSubmitInfo{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = &submitTimelineInfos[i],
+            .commandBufferCount = 1,
+            .pCommandBuffers = &ringSlots[item.slotIndex].commandBuffer,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &frameTimeline,
+        };
+    }
+    const auto submitStart = Clock::now();
+    VK_CHECK(vkQueueSubmit(queue, static_cast<uint32_t>(submitInfos.size()),
+                           submitInfos.data(), VK_NULL_HANDLE));
+    const auto submitted = Clock::now();
+    const double submitMs = Ms(submitted - submitStart).count() /
+                            static_cast<double>(batch.size());
+    for (EncodeItem &item : batch) {
+        item.submitted = submitted;
+        item.submitMs = submitMs;
+    }
+    ++stageTimes.submits;
+    stageTimes.submittedSlots += batch.size();
+}
+
 void OfflineSDFRenderer::startEncoding() {
-    const AVPixelFormat srcFormat =
+    AVPixelFormat srcFormat =
         readbackFormatInfo.swapRB ? AV_PIX_FMT_BGRA : AV_PIX_FMT_RGBA;
+    switch (gpuColorConversion) {
+    case GpuColorConversion::YUV420P:
+        srcFormat = AV_PIX_FMT_YUV420P;
+        break;
+    case GpuColorConversion::NV12:
+        srcFormat = AV_PIX_FMT_NV12;
+        break;
+    case GpuColorConversion::None:
+        break;
+    }
+    // Tiles are stitched into a full-width frame before encoding.
     const int srcStride =
-        static_cast<int>(imageSize.width * readbackFormatInfo.bytesPerPixel);
+        tileCount() > 1
+            ? static_cast<int>(imageSize.width *
+                               readbackFormatInfo.bytesPerPixel)
+            : static_cast<int>(ringSlots[0].rowStride);
 
-    encodeStop = false;
     encodeFailed = false;
+    stageTimes = {};
+    freeSlots = std::make_unique<SpscRing<uint32_t>>(maxRingSize);
+    readyFrames = std::make_unique<SpscRing<EncodeItem>>(maxRingSize);
+    for (uint32_t i = 0; i < ringSize; ++i) {
+        (void)freeSlots->tryPush(i);
+    }
+    if (adaptiveRing) {
+        RingDepthController::Config config;
+        config.minDepth = std::min(OFFSCREEN_DEFAULT_RING_SIZE, maxRingSize);
+        config.maxDepth = maxRingSize;
+        ringController.emplace(config);
+    }
 
-    encoder = std::make_unique<ffmpeg_utils::FfmpegEncoder>(
-        encodeSettings, static_cast<int>(imageSize.width),
-        static_cast<int>(imageSize.height), srcFormat, srcStride);
-    encoder->open();
+    profiler = {};
+    profiler.reserve(maxFrames - frameStart);
+    pendingSample = {};
+    encodeStartTime = std::chrono::steady_clock::now();
+
+    encoderSrcFormat = srcFormat;
+    encoderSrcStride = srcStride;
+    if (imageSequence) {
+        imageWriter = std::make_unique<image_sequence::ImageSequenceWriter>(
+            *imageSequence, imageSize.width, imageSize.height,
+            readbackFormatInfo.swapRB);
+        spdlog::info("Writing {} frames to {} on {} thread(s)",
+                     image_sequence::extension(imageSequence->format),
+                     imageSequence->outputDir.string(),
+                     imageWriter->threadCount());
+    } else if (frameStream) {
+        const size_t pixels =
+            static_cast<size_t>(imageSize.width) * imageSize.height;
+        streamFrameBytes = gpuColorConversion != GpuColorConversion::None
+                               ? pixels + pixels / 2
+                               : pixels * readbackFormatInfo.bytesPerPixel;
+        spdlog::info("Streaming {} frames to {} ({}x{} {}, {} fps)",
+                     frameStream->format == frame_stream::Format::Y4M
+                         ? "y4m"
+                         : "raw",
+                     frameStream->path == "-" ? "stdout" : frameStream->path,
+                     imageSize.width, imageSize.height,
+                     av_get_pix_fmt_name(srcFormat), encodeSettings.fps);
+        streamWriter = std::make_unique<frame_stream::FrameStreamWriter>(
+            *frameStream, imageSize.width, imageSize.height,
+            encodeSettings.fps);
+    } else {
+        openEncoder(frameStart);
+    }
 
     // Encoder thread will process in parallel with the GPU
     // through the ring buffer strategy.
@@ -384,167 +1634,518 @@ void OfflineSDFRenderer::startEncoding() {
             runEncoderLoop();
         } catch (const std::exception &e) {
             spdlog::error("FFmpeg encode thread failed: {}", e.what());
-            {
-                std::lock_guard<std::mutex> lock(encodeMutex);
-                encodeFailed = true;
-                encodeStop = true;
-                encodeQueue.clear();
-                for (size_t i = 0; i < ringSize; ++i) {
-                    ringSlots[i].pendingEncode = false;
-                }
-            }
-            encodeCv.notify_all();
+            encodeFailed = true;
+            // Wake the render loop if it is waiting for a free slot.
+            freeSlots->close();
+            readyFrames->close();
         }
     });
 }
 
+void OfflineSDFRenderer::openEncoder(uint32_t firstFrame) {
+    ffmpeg_utils::EncodeSettings settings = encodeSettings;
+    if (checkpoint) {
+        settings.outputPath =
+            render_checkpoint::segmentPath(encodeSettings.outputPath,
+                                           checkpoint->segments.size())
+                .string();
+        settings.closedGop = true;
+    }
+    encoder = std::make_unique<ffmpeg_utils::FfmpegEncoder>(
+        settings, static_cast<int>(imageSize.width),
+        static_cast<int>(imageSize.height), encoderSrcFormat,
+        encoderSrcStride);
+    encoder->open();
+    encoderFirstFrame = firstFrame;
+}
+
+void OfflineSDFRenderer::checkpointSegment(uint32_t nextFrame) {
+    const bool segmentFull =
+        (nextFrame - checkpoint->frameStart) % checkpoint->segmentFrames == 0;
+    if (!segmentFull && nextFrame != maxFrames)
+        return;
+
+    // Closing writes the trailer, so the segment is complete on disk
+    // before the manifest points past it.
+    encoder->flush();
+    encoder.reset();
+    checkpoint->segments.push_back(
+        render_checkpoint::segmentPath(encodeSettings.outputPath,
+                                       checkpoint->segments.size())
+            .string());
+    checkpoint->nextFrame = nextFrame;
+    render_checkpoint::writeManifest(
+        render_checkpoint::manifestPath(encodeSettings.outputPath),
+        *checkpoint);
+    spdlog::debug("Checkpoint: frames [{}, {}) muxed", checkpoint->frameStart,
+                  nextFrame);
+
+    if (nextFrame < maxFrames)
+        openEncoder(nextFrame);
+}
+
 void OfflineSDFRenderer::runEncoderLoop() {
-    while (true) {
-        EncodeItem item;
-        // 1. WAIT: Get work from queue
-        {
-            std::unique_lock<std::mutex> lock(encodeMutex);
-            encodeCv.wait(lock, [this]() {
-                return encodeStop || !encodeQueue.empty();
-            });
-            if (encodeQueue.empty()) {
-                if (encodeStop)
-                    break;
-                continue;
-            }
-            item = encodeQueue.front();
-            encodeQueue.pop_front();
-            encodeCv.notify_all();
-        }
+    using Clock = std::chrono::steady_clock;
+    using Ms = std::chrono::duration<double, std::milli>;
+    using Stage = StageProfiler::Stage;
+    auto loopStart = Clock::now();
+    // 1. WAIT: Get the next submitted frame (nullopt once closed + drained)
+    while (const auto item = readyFrames->pop()) {
+        const auto gotFrame = Clock::now();
 
         // 2. Wait for GPU to finish rendering to this slot
-        RingSlot &slot = ringSlots[item.slotIndex];
-        VK_CHECK(vkWaitForFences(logicalDevice, 1,
-                                 &fences.fences[item.slotIndex],
-                                 VK_TRUE, UINT64_MAX));
-
-        if (debugDumpPPMDir) {
-            // Blocking readback + PPM dump; this will stall the encode
-            // thread but remains an optional debug extra.
-            PPMDebugFrame frame = debugReadbackOffscreenImage(slot);
-            dumpDebugFrame(frame);
+        RingSlot &slot = ringSlots[item->slotIndex];
+        vkutils::waitTimelineSemaphore(
+            logicalDevice, frameTimeline,
+            tileDoneValue(item->frameIndex + item->frameCount - 1,
+                          item->tileIndex));
+        vkutils::invalidateReadbackBuffer(logicalDevice, slot.stagingBuffer);
+        const auto gpuDone = Clock::now();
+
+        double gpuRenderMs = 0.0;
+        double gpuReadbackMs = 0.0;
+        readGpuTimes(item->slotIndex, gpuRenderMs, gpuReadbackMs);
+
+        // Tiles are copied out so the slot can go back to the GPU before
+        // the frame is complete.
+        const bool tiled = tileCount() > 1;
+        const uint8_t *src = static_cast<const uint8_t *>(slot.mappedData);
+        if (tiled) {
+            stitchTile(slot, item->tileIndex);
+            src = stitchedFrame.data();
+            (void)freeSlots->push(item->slotIndex);
         }
 
-        // 3. Encode the frame directly from the slot's mapped data
-        const uint8_t *src =
-            static_cast<const uint8_t *>(slot.mappedData);
-        encoder->encodeFrame(src, item.frameIndex);
-
-        // 4. Mark slot as free for GPU to use again
-        {
-            std::lock_guard<std::mutex> lock(encodeMutex);
-            slot.pendingEncode = false;
+        // 3. Encode the frame directly from the slot's mapped data (or the
+        // stitched frame once its last tile is in). A layered slot holds
+        // frameCount frames back to back, output in order.
+        // Per-slot times are shared evenly by its frames in the profile;
+        // tiles of a frame add up.
+        const double share = 1.0 / static_cast<double>(item->frameCount);
+        pendingSample[Stage::Record] += item->recordMs * share;
+        pendingSample[Stage::Submit] += item->submitMs * share;
+        pendingSample[Stage::GpuRender] += gpuRenderMs * share;
+        pendingSample[Stage::GpuReadback] += gpuReadbackMs * share;
+        pendingSample[Stage::SubmitToDone] +=
+            Ms(gpuDone - item->submitted).count() * share;
+        pendingSample[Stage::WaitForFrame] +=
+            Ms(gotFrame - loopStart).count() * share;
+        const auto encodeStart = Clock::now();
+        pendingSample[Stage::Frame] +=
+            Ms(encodeStart - loopStart).count() * share;
+        if (item->tileIndex + 1 == tileCount()) {
+            const size_t layerBytes = readbackBytes();
+            for (uint32_t layer = 0; layer < item->frameCount; ++layer) {
+                const auto outputStart = Clock::now();
+                outputFrame(src + layer * layerBytes,
+                            item->frameIndex + layer);
+                const double outputMs = Ms(Clock::now() - outputStart).count();
+                StageProfiler::Sample sample = pendingSample;
+                sample.frameIndex = item->frameIndex + layer;
+                sample[Stage::Output] += outputMs;
+                sample[Stage::Frame] += outputMs;
+                profiler.add(sample);
+            }
+            pendingSample = {};
+        }
+        const auto encodeEnd = Clock::now();
+
+        stageTimes.encoderWaitForFrame += gotFrame - loopStart;
+        stageTimes.encoderWaitForGpu += gpuDone - gotFrame;
+        stageTimes.encode += encodeEnd - encodeStart;
+        stageTimes.gpuRenderMs += gpuRenderMs;
+        stageTimes.gpuReadbackMs += gpuReadbackMs;
+
+        if (ringController) {
+            const uint32_t depth = ringController->addFrame({
+                .gpuMs = gpuRenderMs,
+                .readbackMs = gpuReadbackMs,
+                .encodeMs = Ms(encodeEnd - encodeStart).count(),
+                .wallMs = Ms(encodeEnd - loopStart).count(),
+            });
+            targetRingSize.store(depth, std::memory_order_relaxed);
         }
-        encodeCv.notify_all();
+
+        // 4. Hand the slot back for the GPU to use again
+        if (!tiled)
+            (void)freeSlots->push(item->slotIndex);
+        loopStart = Clock::now();
     }
 
-    encoder->flush();
+    if (encoder)
+        encoder->flush();
+    if (imageWriter)
+        imageWriter->finish();
 }
 
-void OfflineSDFRenderer::stopEncoding() {
-    {
-        std::lock_guard<std::mutex> lock(encodeMutex);
-        encodeStop = true;
+void OfflineSDFRenderer::outputFrame(const uint8_t *src, uint32_t frameIndex) {
+    if (debugDumpPPMDir) {
+        // Blocking readback + PPM dump; this will stall the encode
+        // thread but remains an optional debug extra.
+        PPMDebugFrame frame = debugReadbackOffscreenImage(src);
+        dumpDebugFrame(frame);
+    }
+    if (imageWriter) {
+        // Copies the frame out, blocking (and so holding the slot)
+        // while the writer's frame buffers are all in use.
+        imageWriter->write(src, static_cast<uint32_t>(encoderSrcStride),
+                           frameIndex);
+    } else if (streamWriter) {
+        // Rows are tightly packed, so the whole frame goes out in
+        // one write; a full pipe blocks here and stalls the ring.
+        streamWriter->writeFrame(src, streamFrameBytes);
+    } else {
+        using Stage = StageProfiler::Stage;
+        encoder->encodeFrame(src, frameIndex - encoderFirstFrame);
+        const auto &timings = encoder->lastFrameTimings();
+        pendingSample[Stage::Convert] = timings.convertMs;
+        pendingSample[Stage::Send] = timings.sendMs;
+        pendingSample[Stage::Receive] = timings.receiveMs;
+        pendingSample[Stage::Mux] = timings.muxMs;
+    }
+    ++stageTimes.frames;
+    if (checkpoint)
+        checkpointSegment(frameIndex + 1);
+}
+
+void OfflineSDFRenderer::readGpuTimes(uint32_t slotIndex, double &renderMs,
+                                      double &readbackMs) const {
+    renderMs = 0.0;
+    readbackMs = 0.0;
+    if (timestampPeriodNs <= 0.0f)
+        return;
+
+    // The slot's frame has completed (timeline waited), so the results
+    // are available without VK_QUERY_RESULT_WAIT_BIT.
+    std::array<uint64_t, QUERIES_PER_SLOT> timestamps{};
+    const VkResult result = vkGetQueryPoolResults(
+        logicalDevice, queryPool, slotIndex * QUERIES_PER_SLOT,
+        QUERIES_PER_SLOT, sizeof(timestamps), timestamps.data(),
+        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+        return;
+
+    const double msPerTick = static_cast<double>(timestampPeriodNs) / 1e6;
+    renderMs = static_cast<double>(timestamps[1] - timestamps[0]) * msPerTick;
+    readbackMs =
+        static_cast<double>(timestamps[2] - timestamps[1]) * msPerTick;
+}
+
+void OfflineSDFRenderer::logStageSummary() const {
+    using Ms = std::chrono::duration<double, std::milli>;
+    if (adaptiveRing && ringController) {
+        spdlog::info("Ring depth: auto, final {} slot(s), peak {} (max {})",
+                     ringController->depth(), ringController->peakDepth(),
+                     maxRingSize);
+    } else {
+        spdlog::info("Ring depth: fixed {} slot(s)", ringSize);
+    }
+    spdlog::info("Stage busy: GPU render {:.1f} ms, GPU readback {:.1f} ms, "
+                 "encode {:.1f} ms",
+                 stageTimes.gpuRenderMs, stageTimes.gpuReadbackMs,
+                 Ms(stageTimes.encode).count());
+    if (stageTimes.submits > 0) {
+        spdlog::info("Submits: {} vkQueueSubmit call(s), {:.2f} slot(s) each "
+                     "(batch: {})",
+                     stageTimes.submits,
+                     static_cast<double>(stageTimes.submittedSlots) /
+                         static_cast<double>(stageTimes.submits),
+                     submitBatch > 0 ? fmt::format("{}", submitBatch)
+                                     : std::string("auto"));
+    }
+    spdlog::info("Stage stalls: render waited {:.1f} ms for a free slot, "
+                 "encoder waited {:.1f} ms for frames and {:.1f} ms for GPU",
+                 Ms(stageTimes.renderWaitForSlot).count(),
+                 Ms(stageTimes.encoderWaitForFrame).count(),
+                 Ms(stageTimes.encoderWaitForGpu).count());
+    if (accumulating() && stageTimes.frames > 0) {
+        // GPU render grows with the sub-frame count; readback and encode
+        // are still paid once per output frame.
+        const double frames = static_cast<double>(stageTimes.frames);
+        const double renderPerFrame = stageTimes.gpuRenderMs / frames;
+        spdlog::info("Motion blur per frame: GPU render {:.2f} ms ({} "
+                     "sub-frames, {:.2f} ms each), readback {:.2f} ms, "
+                     "encode {:.2f} ms",
+                     renderPerFrame, motionBlurSamples,
+                     renderPerFrame / motionBlurSamples,
+                     stageTimes.gpuReadbackMs / frames,
+                     Ms(stageTimes.encode).count() / frames);
     }
-    encodeCv.notify_all();
+}
+
+void OfflineSDFRenderer::stopEncoding() {
+    if (readyFrames)
+        readyFrames->close();
     if (encoderThread.joinable()) {
         encoderThread.join();
     }
     encoder.reset();
-}
-
-void OfflineSDFRenderer::enqueueEncode(uint32_t slotIndex,
-                                       uint32_t frameIndex) {
-    std::unique_lock<std::mutex> lock(encodeMutex);
+    imageWriter.reset();
+    streamWriter.reset();
     if (encodeFailed)
         throw std::runtime_error("FFmpeg encoder failed");
+    logStageSummary();
 
-    // Make sure encode queue doesn't get bigger than the ring size
-    encodeCv.wait(lock, [this]() { return encodeQueue.size() < ringSize; });
-    if (encodeFailed)
+    const auto wallTime = std::chrono::steady_clock::now() - encodeStartTime;
+    profiler.logReport(wallTime, static_cast<uint64_t>(imageSize.width) *
+                                     imageSize.height);
+    if (profileOutput)
+        profiler.writeFile(*profileOutput, wallTime);
+}
+
+uint32_t OfflineSDFRenderer::waitFreeSlot() {
+    const auto waitStart = std::chrono::steady_clock::now();
+    const auto slotIndex = freeSlots->pop();
+    stageTimes.renderWaitForSlot +=
+        std::chrono::steady_clock::now() - waitStart;
+    if (!slotIndex || encodeFailed)
         throw std::runtime_error("FFmpeg encoder failed");
+    return *slotIndex;
+}
 
-    RingSlot &slot = ringSlots[slotIndex];
-    slot.pendingEncode = true;
-    encodeQueue.push_back(EncodeItem{slotIndex, frameIndex});
-    lock.unlock();
-    encodeCv.notify_all();
+uint32_t OfflineSDFRenderer::acquireFreeSlot() {
+    if (adaptiveRing) {
+        const uint32_t target = targetRingSize.load(std::memory_order_relaxed);
+        if (ringSize < target && !retiredSlots.empty())
+            return growRing();
+        // Shrink by retiring slots as the encoder hands them back; their
+        // frames are fully encoded so nothing references them anymore.
+        while (ringSize > target && ringSize > 1) {
+            const uint32_t slotIndex = waitFreeSlot();
+            destroyRingSlot(ringSlots[slotIndex]);
+            retiredSlots.push_back(slotIndex);
+            --ringSize;
+            spdlog::debug("Ring shrunk to {} slot(s)", ringSize);
+        }
+    }
+    return waitFreeSlot();
 }
 
-void OfflineSDFRenderer::waitForSlotEncode(uint32_t slotIndex) {
-    std::unique_lock<std::mutex> lock(encodeMutex);
-    encodeCv.wait(lock, [this, slotIndex]() {
-        return encodeFailed || !ringSlots[slotIndex].pendingEncode;
-    });
-    if (encodeFailed)
+uint32_t OfflineSDFRenderer::growRing() {
+    const uint32_t slotIndex = retiredSlots.back();
+    retiredSlots.pop_back();
+    createRingSlot(slotIndex);
+    ++ringSize;
+    spdlog::debug("Ring grew to {} slot(s)", ringSize);
+    return slotIndex;
+}
+
+void OfflineSDFRenderer::enqueueEncode(const EncodeItem &item) {
+    // Never blocks: at most ringSize frames are in flight and the ring
+    // holds at least that many.
+    if (!readyFrames->push(item))
         throw std::runtime_error("FFmpeg encoder failed");
 }
 
 void OfflineSDFRenderer::destroyPipeline() {
-    vkDestroyPipeline(logicalDevice, pipeline, nullptr);
-    vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
-    vkDestroyShaderModule(logicalDevice, fragShaderModule, nullptr);
+    if (ownsPipeline) {
+        vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+        vkDestroyShaderModule(logicalDevice, fragShaderModule, nullptr);
+    }
+    if (!vulkanContext)
+        vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+    pipeline = VK_NULL_HANDLE;
+    fragShaderModule = VK_NULL_HANDLE;
+    pipelineLayout = VK_NULL_HANDLE;
 }
 
-void OfflineSDFRenderer::destroyRenderContext() {
-    VK_CHECK(vkDeviceWaitIdle(logicalDevice));
-    for (size_t i = 0; i < ringSize; ++i) {
-        RingSlot &slot = ringSlots[i];
-        if (slot.framebuffer != VK_NULL_HANDLE) {
-            vkDestroyFramebuffer(logicalDevice, slot.framebuffer, nullptr);
-            slot.framebuffer = VK_NULL_HANDLE;
-        }
-        if (slot.imageView != VK_NULL_HANDLE) {
-            vkDestroyImageView(logicalDevice, slot.imageView, nullptr);
-            slot.imageView = VK_NULL_HANDLE;
-        }
-        if (slot.image != VK_NULL_HANDLE) {
-            vkDestroyImage(logicalDevice, slot.image, nullptr);
-            slot.image = VK_NULL_HANDLE;
+void OfflineSDFRenderer::destroyColorConversion() {
+    if (convertPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(logicalDevice, convertPipeline, nullptr);
+        convertPipeline = VK_NULL_HANDLE;
+    }
+    if (convertPipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(logicalDevice, convertPipelineLayout, nullptr);
+        convertPipelineLayout = VK_NULL_HANDLE;
+    }
+    if (convertShaderModule != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(logicalDevice, convertShaderModule, nullptr);
+        convertShaderModule = VK_NULL_HANDLE;
+    }
+    if (convertDescriptorPool != VK_NULL_HANDLE) {
+        // Frees every slot's descriptor set along with the pool.
+        vkDestroyDescriptorPool(logicalDevice, convertDescriptorPool, nullptr);
+        convertDescriptorPool = VK_NULL_HANDLE;
+        for (RingSlot &slot : ringSlots) {
+            slot.convertDescriptorSet = VK_NULL_HANDLE;
         }
-        if (slot.imageMemory != VK_NULL_HANDLE) {
-            vkFreeMemory(logicalDevice, slot.imageMemory, nullptr);
-            slot.imageMemory = VK_NULL_HANDLE;
+    }
+    if (convertDescriptorSetLayout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(logicalDevice, convertDescriptorSetLayout,
+                                     nullptr);
+        convertDescriptorSetLayout = VK_NULL_HANDLE;
+    }
+    if (convertSampler != VK_NULL_HANDLE) {
+        vkDestroySampler(logicalDevice, convertSampler, nullptr);
+        convertSampler = VK_NULL_HANDLE;
+    }
+}
+
+void OfflineSDFRenderer::destroySupersampling() {
+    if (downsamplePipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(logicalDevice, downsamplePipeline, nullptr);
+        downsamplePipeline = VK_NULL_HANDLE;
+    }
+    if (downsamplePipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(logicalDevice, downsamplePipelineLayout,
+                                nullptr);
+        downsamplePipelineLayout = VK_NULL_HANDLE;
+    }
+    if (downsampleShaderModule != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(logicalDevice, downsampleShaderModule, nullptr);
+        downsampleShaderModule = VK_NULL_HANDLE;
+    }
+    if (downsampleDescriptorPool != VK_NULL_HANDLE) {
+        // Frees every slot's descriptor set along with the pool.
+        vkDestroyDescriptorPool(logicalDevice, downsampleDescriptorPool,
+                                nullptr);
+        downsampleDescriptorPool = VK_NULL_HANDLE;
+        for (RingSlot &slot : ringSlots) {
+            slot.downsampleDescriptorSet = VK_NULL_HANDLE;
         }
-        if (slot.stagingBuffer.buffer != VK_NULL_HANDLE ||
-            slot.stagingBuffer.memory != VK_NULL_HANDLE) {
-            if (slot.mappedData) {
-                vkUnmapMemory(logicalDevice, slot.stagingBuffer.memory);
-                slot.mappedData = nullptr;
-            }
-            vkutils::destroyReadbackBuffer(logicalDevice, slot.stagingBuffer);
+    }
+    if (downsampleDescriptorSetLayout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(logicalDevice,
+                                     downsampleDescriptorSetLayout, nullptr);
+        downsampleDescriptorSetLayout = VK_NULL_HANDLE;
+    }
+    if (downsampleSampler != VK_NULL_HANDLE) {
+        vkDestroySampler(logicalDevice, downsampleSampler, nullptr);
+        downsampleSampler = VK_NULL_HANDLE;
+    }
+}
+
+void OfflineSDFRenderer::destroyFrameInputs() {
+    if (frameInputData) {
+        vkUnmapMemory(logicalDevice, frameInputBuffer.memory);
+        frameInputData = nullptr;
+    }
+    vkutils::destroyHostBuffer(logicalDevice, frameInputBuffer);
+    if (frameInputPool != VK_NULL_HANDLE) {
+        // Frees frameInputSet along with the pool.
+        vkDestroyDescriptorPool(logicalDevice, frameInputPool, nullptr);
+        frameInputPool = VK_NULL_HANDLE;
+        frameInputSet = VK_NULL_HANDLE;
+    }
+    if (frameInputSetLayout != VK_NULL_HANDLE) {
+        if (!vulkanContext)
+            vkDestroyDescriptorSetLayout(logicalDevice, frameInputSetLayout,
+                                         nullptr);
+        frameInputSetLayout = VK_NULL_HANDLE;
+    }
+}
+
+void OfflineSDFRenderer::destroyRingSlot(RingSlot &slot) {
+    if (slot.commandBuffer != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(logicalDevice, commandPool, 1, &slot.commandBuffer);
+        slot.commandBuffer = VK_NULL_HANDLE;
+    }
+    slot.recordedExtent = {};
+    if (slot.framebuffer != VK_NULL_HANDLE) {
+        vkDestroyFramebuffer(logicalDevice, slot.framebuffer, nullptr);
+        slot.framebuffer = VK_NULL_HANDLE;
+    }
+    if (slot.intermediateFramebuffer != VK_NULL_HANDLE) {
+        vkDestroyFramebuffer(logicalDevice, slot.intermediateFramebuffer,
+                             nullptr);
+        slot.intermediateFramebuffer = VK_NULL_HANDLE;
+    }
+    if (slot.intermediateImageView != VK_NULL_HANDLE) {
+        vkDestroyImageView(logicalDevice, slot.intermediateImageView, nullptr);
+        slot.intermediateImageView = VK_NULL_HANDLE;
+    }
+    if (slot.intermediateImage != VK_NULL_HANDLE) {
+        vkDestroyImage(logicalDevice, slot.intermediateImage, nullptr);
+        slot.intermediateImage = VK_NULL_HANDLE;
+    }
+    if (slot.intermediateImageMemory != VK_NULL_HANDLE) {
+        vkFreeMemory(logicalDevice, slot.intermediateImageMemory, nullptr);
+        slot.intermediateImageMemory = VK_NULL_HANDLE;
+    }
+    if (slot.imageView != VK_NULL_HANDLE) {
+        vkDestroyImageView(logicalDevice, slot.imageView, nullptr);
+        slot.imageView = VK_NULL_HANDLE;
+    }
+    if (slot.image != VK_NULL_HANDLE) {
+        vkDestroyImage(logicalDevice, slot.image, nullptr);
+        slot.image = VK_NULL_HANDLE;
+    }
+    if (slot.imageMemory != VK_NULL_HANDLE) {
+        vkFreeMemory(logicalDevice, slot.imageMemory, nullptr);
+        slot.imageMemory = VK_NULL_HANDLE;
+    }
+    if (slot.stagingBuffer.buffer != VK_NULL_HANDLE ||
+        slot.stagingBuffer.memory != VK_NULL_HANDLE) {
+        if (slot.mappedData) {
+            vkUnmapMemory(logicalDevice, slot.stagingBuffer.memory);
+            slot.mappedData = nullptr;
         }
-        slot.pendingReadback = false;
-        slot.pendingEncode = false;
+        vkutils::destroyHostBuffer(logicalDevice, slot.stagingBuffer);
+    }
+    slot.pendingReadback = false;
+}
+
+void OfflineSDFRenderer::destroyRenderContext() {
+    VK_CHECK(vkDeviceWaitIdle(logicalDevice));
+    for (RingSlot &slot : ringSlots) {
+        destroyRingSlot(slot);
     }
 }
 
 void OfflineSDFRenderer::destroy() {
+    if (logicalDevice == VK_NULL_HANDLE) {
+        // setup() failed between creating the instance and the device.
+        if (instance != VK_NULL_HANDLE && !vulkanContext)
+            vkDestroyInstance(instance, nullptr);
+        instance = VK_NULL_HANDLE;
+        return;
+    }
     VK_CHECK(vkDeviceWaitIdle(logicalDevice));
-    vkutils::destroyFences(logicalDevice, fences);
+    if (frameTimeline != VK_NULL_HANDLE) {
+        vkDestroySemaphore(logicalDevice, frameTimeline, nullptr);
+        frameTimeline = VK_NULL_HANDLE;
+    }
     destroyPipeline();
+    destroyColorConversion();
+    destroySupersampling();
+    destroyFrameInputs();
     destroyRenderContext();
     if (renderPass != VK_NULL_HANDLE) {
-        vkDestroyRenderPass(logicalDevice, renderPass, nullptr);
+        if (!vulkanContext)
+            vkDestroyRenderPass(logicalDevice, renderPass, nullptr);
         renderPass = VK_NULL_HANDLE;
     }
+    if (intermediateRenderPass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(logicalDevice, intermediateRenderPass, nullptr);
+        intermediateRenderPass = VK_NULL_HANDLE;
+    }
     if (queryPool != VK_NULL_HANDLE) {
         vkDestroyQueryPool(logicalDevice, queryPool, nullptr);
         queryPool = VK_NULL_HANDLE;
     }
     if (vertShaderModule != VK_NULL_HANDLE) {
-        vkDestroyShaderModule(logicalDevice, vertShaderModule, nullptr);
+        if (!vulkanContext ||
+            vertShaderModule != vulkanContext->vertShaderModule)
+            vkDestroyShaderModule(logicalDevice, vertShaderModule, nullptr);
         vertShaderModule = VK_NULL_HANDLE;
     }
     if (commandPool != VK_NULL_HANDLE) {
         vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
         commandPool = VK_NULL_HANDLE;
     }
+    if (vulkanContext) {
+        // The device outlives this renderer; the next job reuses it.
+        pipelineCache = VK_NULL_HANDLE;
+        logicalDevice = VK_NULL_HANDLE;
+        instance = VK_NULL_HANDLE;
+        return;
+    }
+    if (pipelineCache != VK_NULL_HANDLE) {
+        vkutils::savePipelineCache(logicalDevice, deviceProperties,
+                                   pipelineCache);
+        vkDestroyPipelineCache(logicalDevice, pipelineCache, nullptr);
+        pipelineCache = VK_NULL_HANDLE;
+    }
     if (logicalDevice != VK_NULL_HANDLE) {
         vkDestroyDevice(logicalDevice, nullptr);
         logicalDevice = VK_NULL_HANDLE;
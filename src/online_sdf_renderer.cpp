@@ -1,9 +1,11 @@
 #include "online_sdf_renderer.h"
 #include "filewatcher/filewatcher_factory.h"
 #include "glfwutils.h"
+#include "shader_compile_thread.h"
 #include "shader_utils.h"
 #include "vkutils.h"
-#include <atomic>
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <spdlog/spdlog.h>
 
@@ -56,6 +58,7 @@ void OnlineSDFRenderer::vulkanSetup() {
         vkutils::createVulkanLogicalDevice(physicalDevice, graphicsQueueIndex);
     queue = VK_NULL_HANDLE;
     initDeviceQueue();
+    pipelineCache = vkutils::loadPipelineCache(logicalDevice, deviceProperties);
     swapchainFormat = vkutils::selectSwapchainFormat(physicalDevice, surface);
     renderPass =
         vkutils::createRenderPass(logicalDevice, swapchainFormat.format);
@@ -107,27 +110,44 @@ void OnlineSDFRenderer::createPipeline() {
     fragShaderModule = vkutils::createShaderModule(logicalDevice, fragSpirv);
     pipeline = vkutils::createGraphicsPipeline(
         logicalDevice, renderPass, pipelineLayout, swapchainSize,
-        vertShaderModule, fragShaderModule);
+        vertShaderModule, fragShaderModule, std::nullopt, pipelineCache);
 }
 
-void OnlineSDFRenderer::tryRecreatePipeline() {
-    std::vector<uint32_t> fragSpirv;
+OnlineSDFRenderer::ReloadedPipeline
+OnlineSDFRenderer::buildReloadedPipeline() const {
+    const auto fragSpirv =
+        shader_utils::compileFileToSpirv(fragShaderPath, useToyTemplate);
+    ReloadedPipeline reloaded;
+    reloaded.fragShaderModule =
+        vkutils::createShaderModule(logicalDevice, fragSpirv);
     try {
-        fragSpirv =
-            shader_utils::compileFileToSpirv(fragShaderPath, useToyTemplate);
-    } catch (const std::runtime_error &err) {
-        spdlog::warn("Shader compile failed, keeping previous pipeline: {}",
-                     err.what());
-        return;
+        // Viewport and scissor are dynamic, so the extent baked in here
+        // doesn't have to follow swapchain resizes.
+        reloaded.pipeline = vkutils::createGraphicsPipeline(
+            logicalDevice, renderPass, pipelineLayout,
+            VkExtent2D{WINDOW_WIDTH, WINDOW_HEIGHT}, vertShaderModule,
+            reloaded.fragShaderModule, std::nullopt, pipelineCache);
+    } catch (...) {
+        vkDestroyShaderModule(logicalDevice, reloaded.fragShaderModule,
+                              nullptr);
+        throw;
     }
+    return reloaded;
+}
 
-    VK_CHECK(vkDeviceWaitIdle(logicalDevice));
-    destroyPipeline();
-    createPipelineLayoutCommon();
-    fragShaderModule = vkutils::createShaderModule(logicalDevice, fragSpirv);
-    pipeline = vkutils::createGraphicsPipeline(
-        logicalDevice, renderPass, pipelineLayout, swapchainSize,
-        vertShaderModule, fragShaderModule);
+void OnlineSDFRenderer::swapPipeline(const ReloadedPipeline &reloaded) {
+    // No vkDeviceWaitIdle: frames already submitted keep using the old
+    // pipeline, which is freed once their fences have signalled. Every
+    // shader gets the same push constant layout, so the layout stays.
+    retiredPipelines.retire(
+        submitSerial, [device = logicalDevice, oldPipeline = pipeline,
+                       oldFragShaderModule = fragShaderModule] {
+            vkDestroyPipeline(device, oldPipeline, nullptr);
+            vkDestroyShaderModule(device, oldFragShaderModule, nullptr);
+        });
+    pipeline = reloaded.pipeline;
+    fragShaderModule = reloaded.fragShaderModule;
+    reloadHitch.reloaded();
 }
 
 void OnlineSDFRenderer::createCommandBuffers() {
@@ -135,12 +155,6 @@ void OnlineSDFRenderer::createCommandBuffers() {
                                                    swapchainImages.count);
 }
 
-void OnlineSDFRenderer::destroyPipeline() {
-    vkDestroyPipeline(logicalDevice, pipeline, nullptr);
-    vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
-    vkDestroyShaderModule(logicalDevice, fragShaderModule, nullptr);
-}
-
 void OnlineSDFRenderer::destroyRenderContext() {
     VK_CHECK(vkDeviceWaitIdle(logicalDevice));
     VK_CHECK(vkResetCommandPool(logicalDevice, commandPool, 0));
@@ -188,10 +202,19 @@ void OnlineSDFRenderer::calcTimestamps(uint32_t imageIndex) {
 void OnlineSDFRenderer::gameLoop() {
     uint32_t currentFrame = 0;
     uint32_t frameIndex = 0;
-    std::atomic<bool> pipelineUpdated{false};
+    // Declared before the watcher so it outlives the watcher's callbacks.
+    // A pipeline built for a save that was overtaken never reached a
+    // command buffer, so it is freed straight away.
+    ShaderCompileThread<ReloadedPipeline> shaderCompiler(
+        [device = logicalDevice](ReloadedPipeline &unused) {
+            vkDestroyPipeline(device, unused.pipeline, nullptr);
+            vkDestroyShaderModule(device, unused.fragShaderModule, nullptr);
+        });
     auto filewatcher = filewatcher_factory::createFileWatcher();
     filewatcher->startWatching(fragShaderPath, [&]() {
-        pipelineUpdated.store(true, std::memory_order_relaxed);
+        // Frames keep going out with the current pipeline meanwhile.
+        spdlog::info("Shader changed, compiling in the background");
+        shaderCompiler.request([this] { return buildReloadedPipeline(); });
     });
     auto recreateSwapchain = [&]() {
         destroyRenderContext();
@@ -200,6 +223,8 @@ void OnlineSDFRenderer::gameLoop() {
         frameIndex = 0;
         spdlog::info("Swapchain out of date, recreating.");
     };
+    std::chrono::time_point<std::chrono::high_resolution_clock>
+        previousFrameEnd;
     while (!glfwWindowShouldClose(window)) {
         if (options.maxFrames && currentFrame >= *options.maxFrames) {
             spdlog::info("Reached max frames {}, exiting.",
@@ -214,9 +239,17 @@ void OnlineSDFRenderer::gameLoop() {
             recreateSwapchain();
             continue;
         }
-        if (pipelineUpdated.exchange(false, std::memory_order_relaxed)) {
-            spdlog::info("Recreating pipeline");
-            tryRecreatePipeline();
+        if (auto compiled = shaderCompiler.takeResult()) {
+            if (compiled->output) {
+                spdlog::info("Shader compiled and pipeline built in "
+                             "{:.1f} ms, swapping it in",
+                             compiled->compileMs);
+                swapPipeline(*compiled->output);
+            } else {
+                spdlog::warn(
+                    "Shader compile failed, keeping previous pipeline: {}",
+                    compiled->error);
+            }
         }
         if (options.ciResizeAfter && !ciResizeTriggered &&
             currentFrame >= *options.ciResizeAfter) {
@@ -232,6 +265,9 @@ void OnlineSDFRenderer::gameLoop() {
 
         VK_CHECK(vkWaitForFences(logicalDevice, 1, &fences.fences[frameIndex],
                                  VK_TRUE, UINT64_MAX));
+        // One queue, so everything submitted before this frame is done too.
+        completedSerial = std::max(completedSerial, fenceSerials[frameIndex]);
+        retiredPipelines.collect(completedSerial);
 
         VkResult acquireResult = vkAcquireNextImageKHR(
             logicalDevice, swapchain, UINT64_MAX,
@@ -257,6 +293,7 @@ void OnlineSDFRenderer::gameLoop() {
             imageAvailableSemaphores.semaphores[imageIndex],
             renderFinishedSemaphores.semaphores[imageIndex],
             fences.fences[frameIndex]);
+        fenceSerials[frameIndex] = ++submitSerial;
         if (debugDumpPPMDir) {
             // Debug-only: copy the swapchain image before present, which
             // stalls. Mainly useful for smoke tests or debugging.
@@ -287,16 +324,30 @@ void OnlineSDFRenderer::gameLoop() {
         frameIndex = (frameIndex + 1) % swapchainImages.count;
         currentFrame++;
         cpuEndFrame = std::chrono::high_resolution_clock::now();
+        if (currentFrame > 1) {
+            reloadHitch.frame(std::chrono::duration<double, std::milli>(
+                                  cpuEndFrame - previousFrameEnd)
+                                  .count());
+        }
+        previousFrameEnd = cpuEndFrame;
+        if (auto hitch = reloadHitch.takeReport()) {
+            spdlog::info("Hot reload hitch: longest frame {:.2f} ms around "
+                         "the swap, {:.2f} ms typical",
+                         hitch->longestMs, hitch->typicalMs);
+        }
         calcTimestamps(imageIndex);
     }
 
     filewatcher->stopWatching();
+    // Before destroy(): a build in flight still uses the device.
+    shaderCompiler.stop();
     spdlog::info("Done!");
     destroy();
 }
 
 void OnlineSDFRenderer::destroy() {
     VK_CHECK(vkDeviceWaitIdle(logicalDevice));
+    retiredPipelines.flush();
     vkutils::destroySemaphores(logicalDevice, imageAvailableSemaphores);
     vkutils::destroySemaphores(logicalDevice, renderFinishedSemaphores);
     vkutils::destroyFences(logicalDevice, fences);
@@ -310,6 +361,8 @@ void OnlineSDFRenderer::destroy() {
     vkDestroySwapchainKHR(logicalDevice, swapchain, nullptr);
     vkDestroyQueryPool(logicalDevice, queryPool, nullptr);
     vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
+    vkutils::savePipelineCache(logicalDevice, deviceProperties, pipelineCache);
+    vkDestroyPipelineCache(logicalDevice, pipelineCache, nullptr);
     vkDestroyDevice(logicalDevice, nullptr);
     vkDestroySurfaceKHR(instance, surface, nullptr);
     vkDestroyInstance(instance, nullptr);
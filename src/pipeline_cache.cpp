@@ -0,0 +1,125 @@
+#include "pipeline_cache.h"
+
+#include <spdlog/fmt/fmt.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace pipeline_cache {
+namespace {
+// VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID,
+// deviceID (uint32 each) then the 16 byte pipelineCacheUUID.
+constexpr size_t kHeaderSize = 16 + 16;
+constexpr uint32_t kHeaderVersionOne = 1;
+
+uint32_t readU32(const std::vector<uint8_t> &blob, size_t offset) {
+    // The header is in host byte order, as is the cache it describes.
+    uint32_t value = 0;
+    std::memcpy(&value, blob.data() + offset, sizeof(value));
+    return value;
+}
+
+std::filesystem::path envPath(const char *name) {
+    const char *value = std::getenv(name);
+    if (value == nullptr || *value == '\0')
+        return {};
+    return value;
+}
+} // namespace
+
+std::filesystem::path defaultDirectory() {
+    if (auto dir = envPath("VSDF_CACHE_DIR"); !dir.empty())
+        return dir;
+#if defined(_WIN32)
+    if (auto dir = envPath("LOCALAPPDATA"); !dir.empty())
+        return dir / "vsdf";
+#elif defined(__APPLE__)
+    if (auto home = envPath("HOME"); !home.empty())
+        return home / "Library" / "Caches" / "vsdf";
+#else
+    if (auto dir = envPath("XDG_CACHE_HOME"); !dir.empty())
+        return dir / "vsdf";
+    if (auto home = envPath("HOME"); !home.empty())
+        return home / ".cache" / "vsdf";
+#endif
+    return {};
+}
+
+std::filesystem::path cachePath(const std::filesystem::path &dir,
+                                const DeviceKey &key) {
+    std::string uuid;
+    for (uint8_t byte : key.uuid)
+        uuid += fmt::format("{:02x}", byte);
+    return dir / fmt::format("pipeline_{:04x}_{:04x}_{:08x}_{}.bin",
+                             key.vendorID, key.deviceID, key.driverVersion,
+                             uuid);
+}
+
+bool headerMatches(const std::vector<uint8_t> &blob, const DeviceKey &key) {
+    if (blob.size() < kHeaderSize)
+        return false;
+    const uint32_t headerSize = readU32(blob, 0);
+    return headerSize >= kHeaderSize && headerSize <= blob.size() &&
+           readU32(blob, 4) == kHeaderVersionOne &&
+           readU32(blob, 8) == key.vendorID &&
+           readU32(blob, 12) == key.deviceID &&
+           std::memcmp(blob.data() + 16, key.uuid.data(), key.uuid.size()) ==
+               0;
+}
+
+std::vector<uint8_t> load(const std::filesystem::path &path,
+                          const DeviceKey &key) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        return {};
+    std::vector<uint8_t> blob((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+    if (in.bad() || !headerMatches(blob, key))
+        return {};
+    return blob;
+}
+
+void saveAtomic(const std::filesystem::path &path,
+                const std::vector<uint8_t> &blob) {
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path());
+    // Per process, so two instances exiting together don't share a temp.
+    std::filesystem::path tmpPath = path;
+    tmpPath += fmt::format(".{}.tmp", getpid());
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+            throw std::runtime_error("Failed to write pipeline cache: " +
+                                     tmpPath.string());
+        out.write(reinterpret_cast<const char *>(blob.data()),
+                  static_cast<std::streamsize>(blob.size()));
+        out.flush();
+        if (!out) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tmpPath, ec);
+            throw std::runtime_error("Failed to write pipeline cache: " +
+                                     tmpPath.string());
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::error_code removeEc;
+        std::filesystem::remove(tmpPath, removeEc);
+        throw std::runtime_error("Failed to replace pipeline cache " +
+                                 path.string() + ": " + ec.message());
+    }
+}
+} // namespace pipeline_cache
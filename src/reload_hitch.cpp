@@ -0,0 +1,41 @@
+#include "reload_hitch.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+ReloadHitchMeter::ReloadHitchMeter(uint32_t windowFrames,
+                                   size_t historyFrames)
+    : windowFrames(std::max<uint32_t>(windowFrames, 1)),
+      historyFrames(std::max<size_t>(historyFrames, 1)) {}
+
+void ReloadHitchMeter::reloaded() {
+    current = Report{};
+    if (!history.empty()) {
+        std::vector<double> sorted(history.begin(), history.end());
+        std::nth_element(sorted.begin(),
+                         sorted.begin() +
+                             static_cast<std::ptrdiff_t>(sorted.size() / 2),
+                         sorted.end());
+        current.typicalMs = sorted[sorted.size() / 2];
+    }
+    // A reload during the window of the previous one starts over.
+    windowLeft = windowFrames;
+}
+
+void ReloadHitchMeter::frame(double frameMs) {
+    if (windowLeft > 0) {
+        current.longestMs = std::max(current.longestMs, frameMs);
+        if (--windowLeft == 0)
+            finished = current;
+        // Reload frames would skew the baseline of the next reload.
+        return;
+    }
+    history.push_back(frameMs);
+    if (history.size() > historyFrames)
+        history.pop_front();
+}
+
+std::optional<ReloadHitchMeter::Report> ReloadHitchMeter::takeReport() {
+    return std::exchange(finished, std::nullopt);
+}
@@ -0,0 +1,163 @@
+#include "render_checkpoint.h"
+#include "content_hash.h"
+#include "ffmpeg_utils.h"
+
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace render_checkpoint {
+namespace {
+constexpr const char kMagic[] = "vsdf-checkpoint 1";
+
+uint32_t parseFrame(const std::string &key, const std::string &value) {
+    try {
+        size_t used = 0;
+        const unsigned long parsed = std::stoul(value, &used);
+        if (used != value.size() || parsed > UINT32_MAX)
+            throw std::out_of_range(value);
+        return static_cast<uint32_t>(parsed);
+    } catch (const std::exception &) {
+        throw std::runtime_error(
+            fmt::format("Invalid checkpoint value for {}: {}", key, value));
+    }
+}
+} // namespace
+
+std::filesystem::path manifestPath(const std::filesystem::path &outputPath) {
+    std::filesystem::path path = outputPath;
+    path += ".checkpoint";
+    return path;
+}
+
+std::filesystem::path segmentPath(const std::filesystem::path &outputPath,
+                                  size_t index) {
+    std::filesystem::path segment = outputPath;
+    segment.replace_filename(fmt::format("{}.part{}{}",
+                                         outputPath.stem().string(), index,
+                                         outputPath.extension().string()));
+    return segment;
+}
+
+std::string hashFile(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        throw std::runtime_error("Failed to open for hashing: " +
+                                 path.string());
+    uint64_t hash = content_hash::FNV1A_OFFSET;
+    char buf[4096];
+    while (in.read(buf, sizeof(buf)) || in.gcount() > 0) {
+        hash = content_hash::fnv1a({buf, static_cast<size_t>(in.gcount())},
+                                   hash);
+    }
+    return fmt::format("{:016x}", hash);
+}
+
+std::string hashContents(std::string_view contents) {
+    return fmt::format("{:016x}", content_hash::fnv1a(contents));
+}
+
+void writeManifest(const std::filesystem::path &path,
+                   const Manifest &manifest) {
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::trunc);
+        if (!out.is_open())
+            throw std::runtime_error("Failed to write checkpoint: " +
+                                     tmpPath.string());
+        out << kMagic << '\n'
+            << "shader_hash " << manifest.shaderHash << '\n'
+            << "settings " << manifest.settings << '\n'
+            << "frame_start " << manifest.frameStart << '\n'
+            << "frame_end " << manifest.frameEnd << '\n'
+            << "segment_frames " << manifest.segmentFrames << '\n'
+            << "next_frame " << manifest.nextFrame << '\n';
+        for (const std::string &segment : manifest.segments)
+            out << "segment " << segment << '\n';
+        out.flush();
+        if (!out)
+            throw std::runtime_error("Failed to write checkpoint: " +
+                                     tmpPath.string());
+    }
+    std::filesystem::rename(tmpPath, path);
+}
+
+std::optional<Manifest> readManifest(const std::filesystem::path &path) {
+    std::ifstream in(path);
+    if (!in.is_open())
+        return std::nullopt;
+
+    std::string line;
+    if (!std::getline(in, line) || line != kMagic)
+        throw std::runtime_error("Not a vsdf checkpoint: " + path.string());
+
+    Manifest manifest;
+    while (std::getline(in, line)) {
+        if (line.empty())
+            continue;
+        const size_t space = line.find(' ');
+        const std::string key = line.substr(0, space);
+        const std::string value =
+            space == std::string::npos ? "" : line.substr(space + 1);
+        if (key == "shader_hash") {
+            manifest.shaderHash = value;
+        } else if (key == "settings") {
+            manifest.settings = value;
+        } else if (key == "frame_start") {
+            manifest.frameStart = parseFrame(key, value);
+        } else if (key == "frame_end") {
+            manifest.frameEnd = parseFrame(key, value);
+        } else if (key == "segment_frames") {
+            manifest.segmentFrames = parseFrame(key, value);
+        } else if (key == "next_frame") {
+            manifest.nextFrame = parseFrame(key, value);
+        } else if (key == "segment") {
+            manifest.segments.push_back(value);
+        } else {
+            throw std::runtime_error(
+                fmt::format("Unknown checkpoint key {} in {}", key,
+                            path.string()));
+        }
+    }
+    return manifest;
+}
+
+void validateResume(const Manifest &saved, const Manifest &expected) {
+    if (saved.shaderHash != expected.shaderHash)
+        throw std::runtime_error(
+            "Can't resume: shader changed since the checkpoint");
+    if (saved.settings != expected.settings)
+        throw std::runtime_error(fmt::format(
+            "Can't resume: settings changed since the checkpoint ({} vs {})",
+            saved.settings, expected.settings));
+    if (saved.frameStart != expected.frameStart ||
+        saved.frameEnd != expected.frameEnd)
+        throw std::runtime_error(fmt::format(
+            "Can't resume: checkpoint covers frames [{}, {}), not [{}, {})",
+            saved.frameStart, saved.frameEnd, expected.frameStart,
+            expected.frameEnd));
+    if (saved.nextFrame < saved.frameStart || saved.nextFrame > saved.frameEnd)
+        throw std::runtime_error("Can't resume: checkpoint is corrupt");
+    for (const std::string &segment : saved.segments) {
+        if (!std::filesystem::exists(segment))
+            throw std::runtime_error("Can't resume: missing segment " +
+                                     segment);
+    }
+}
+
+void finishRender(const Manifest &manifest,
+                  const std::filesystem::path &outputPath) {
+    ffmpeg_utils::concatSegments(manifest.segments, outputPath.string());
+    std::error_code ec;
+    for (const std::string &segment : manifest.segments)
+        std::filesystem::remove(segment, ec);
+    std::filesystem::remove(manifestPath(outputPath), ec);
+    spdlog::info("Joined {} checkpoint segment(s) into {}",
+                 manifest.segments.size(), outputPath.string());
+}
+} // namespace render_checkpoint
@@ -0,0 +1,235 @@
+#include "render_daemon.h"
+#include "render_checkpoint.h"
+#include "render_request.h"
+#include "shader_utils.h"
+
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace render_daemon {
+#if defined(_WIN32)
+void serve(const Settings &, const OfflineRenderOptions &) {
+    throw std::runtime_error("The render daemon needs Unix domain sockets");
+}
+#else
+namespace {
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+// Requests are a handful of short lines.
+constexpr size_t kMaxRequestBytes = 64 * 1024;
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void onStopSignal(int) { stopRequested = 1; }
+
+[[noreturn]] void throwSocketError(const std::string &what) {
+    throw std::runtime_error(fmt::format(
+        "{}: {}", what, std::generic_category().message(errno)));
+}
+
+// Reads up to the blank line ending the request or until the client shuts
+// down its side.
+std::string readRequest(int fd) {
+    std::string text;
+    char buf[4096];
+    while (text.find("\n\n") == std::string::npos) {
+        const ssize_t got = ::read(fd, buf, sizeof(buf));
+        if (got < 0) {
+            if (errno == EINTR && !stopRequested)
+                continue;
+            throwSocketError("Failed to read request");
+        }
+        if (got == 0)
+            break;
+        text.append(buf, static_cast<size_t>(got));
+        if (text.size() > kMaxRequestBytes)
+            throw std::runtime_error("Request too large");
+    }
+    return text;
+}
+
+void writeReply(int fd, const std::string &reply) {
+    size_t sent = 0;
+    while (sent < reply.size()) {
+        const ssize_t wrote = ::write(fd, reply.data() + sent,
+                                      reply.size() - sent);
+        if (wrote < 0) {
+            if (errno == EINTR)
+                continue;
+            // The client went away; nothing left to tell it.
+            spdlog::warn("Failed to send reply: {}",
+                         std::generic_category().message(errno));
+            return;
+        }
+        sent += static_cast<size_t>(wrote);
+    }
+}
+
+class Daemon {
+  public:
+    Daemon(const Settings &settings, const OfflineRenderOptions &base)
+        : settings(settings), base(base),
+          context(std::make_shared<OfflineVulkanContext>()) {}
+
+    // Returns the reply line.
+    std::string handle(const render_request::Request &request,
+                       Clock::time_point received);
+
+  private:
+    const Settings &settings;
+    const OfflineRenderOptions &base;
+    std::shared_ptr<OfflineVulkanContext> context;
+    uint64_t served = 0;
+};
+
+std::string Daemon::handle(const render_request::Request &request,
+                           Clock::time_point received) {
+    // Content, not path, so an edited shader gets a fresh pipeline. The
+    // file is read once so the key and the compile see the same bytes
+    // even if it is saved again meanwhile.
+    const std::string source =
+        shader_utils::readShaderSource(request.shader.string());
+    const std::string key =
+        fmt::format("{}:{}", render_checkpoint::hashContents(source),
+                    request.toy ? "toy" : "vulkan");
+    const bool warm = context->findPipeline(key) != nullptr;
+
+    OfflineRenderOptions options = base;
+    options.frameStart = 0;
+    options.maxFrames = static_cast<uint32_t>(request.times.size());
+    options.width = request.width;
+    options.height = request.height;
+    options.imageSequence = image_sequence::Settings{
+        .outputDir = request.output,
+        .format = request.format,
+        .threads = 0,
+        .maxInFlight = 0,
+    };
+    options.vulkanContext = context;
+    options.pipelineKey = key;
+    options.frameTimes = request.times;
+    if (!warm) {
+        // Compile before any GPU objects exist so a broken shader fails
+        // the request without leaving a half-built renderer behind.
+        options.fragSpirv = OfflineSDFRenderer::compileFragmentSource(
+            source, request.shader.string(), request.toy, base.frameLayers);
+    }
+    std::filesystem::create_directories(request.output);
+
+    const auto setupStart = Clock::now();
+    OfflineSDFRenderer renderer(request.shader.string(), request.toy,
+                                std::move(options));
+    renderer.setup();
+    const auto renderStart = Clock::now();
+    renderer.renderFrames();
+    const auto done = Clock::now();
+
+    // Warm pipelines aren't in use between requests.
+    context->trimPipelines(settings.maxWarmPipelines);
+    const render_request::Latency latency{
+        .totalMs = Milliseconds(done - received).count(),
+        .setupMs = Milliseconds(renderStart - setupStart).count(),
+        .renderMs = Milliseconds(done - renderStart).count(),
+    };
+    ++served;
+    spdlog::info("Request {}: {} frame(s) of {} at {}x{} in {:.2f} ms "
+                 "(setup {:.2f} ms, render {:.2f} ms, {})",
+                 served, request.times.size(), request.shader.string(),
+                 request.width, request.height, latency.totalMs,
+                 latency.setupMs, latency.renderMs, warm ? "warm" : "cold");
+    return render_request::okReply(request.times.size(), latency, warm);
+}
+} // namespace
+
+void serve(const Settings &settings, const OfflineRenderOptions &base) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    const std::string path = settings.socketPath.string();
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Daemon socket path is empty or too long: " +
+                                 path);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    // A socket left by a daemon that was killed; anything else is kept.
+    std::error_code ec;
+    if (std::filesystem::is_socket(settings.socketPath, ec))
+        std::filesystem::remove(settings.socketPath, ec);
+
+    const int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0)
+        throwSocketError("Failed to create daemon socket");
+    if (::bind(listenFd, reinterpret_cast<const sockaddr *>(&addr),
+               sizeof(addr)) < 0 ||
+        ::listen(listenFd, 16) < 0) {
+        const int err = errno;
+        ::close(listenFd);
+        errno = err;
+        throwSocketError("Failed to listen on " + path);
+    }
+
+    // No SA_RESTART: the signal has to interrupt accept().
+    struct sigaction stopAction{};
+    stopAction.sa_handler = onStopSignal;
+    sigemptyset(&stopAction.sa_mask);
+    sigaction(SIGINT, &stopAction, nullptr);
+    sigaction(SIGTERM, &stopAction, nullptr);
+    // A client hanging up early should fail the write, not kill us.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    try {
+        Daemon daemon(settings, base);
+        spdlog::info("Render daemon listening on {}", path);
+        while (!stopRequested) {
+            const int client = ::accept(listenFd, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR)
+                    continue;
+                throwSocketError("Failed to accept a client");
+            }
+            const auto received = Clock::now();
+            std::string reply;
+            try {
+                std::istringstream in(readRequest(client));
+                const auto request = render_request::parseRequest(in);
+                if (request.shutdown) {
+                    stopRequested = 1;
+                    reply = "ok shutdown\n";
+                } else {
+                    reply = daemon.handle(request, received);
+                }
+            } catch (const std::exception &e) {
+                spdlog::error("Request failed: {}", e.what());
+                reply = render_request::errorReply(e.what());
+            }
+            writeReply(client, reply);
+            ::close(client);
+        }
+    } catch (...) {
+        ::close(listenFd);
+        std::filesystem::remove(settings.socketPath, ec);
+        throw;
+    }
+    ::close(listenFd);
+    std::filesystem::remove(settings.socketPath, ec);
+    spdlog::info("Render daemon stopped");
+}
+#endif
+} // namespace render_daemon
@@ -0,0 +1,144 @@
+#include "render_request.h"
+
+#include <spdlog/fmt/fmt.h>
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace render_request {
+namespace {
+constexpr size_t kMaxTimes = 4096;
+// Largest width or height a request may ask for. The daemon renders
+// previews and thumbnails; this keeps a typo from allocating gigabytes.
+constexpr unsigned long kMaxSize = 16384;
+
+std::string trim(const std::string &text) {
+    const size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+        return {};
+    const size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+uint32_t parseSize(const std::string &key, const std::string &value) {
+    try {
+        size_t used = 0;
+        const unsigned long parsed = std::stoul(value, &used);
+        if (used != value.size() || parsed == 0 || parsed > kMaxSize)
+            throw std::out_of_range(value);
+        return static_cast<uint32_t>(parsed);
+    } catch (const std::exception &) {
+        throw std::runtime_error(fmt::format(
+            "{} must be an integer from 1 to {}: {}", key, kMaxSize, value));
+    }
+}
+
+std::filesystem::path parsePath(const std::string &key,
+                                const std::string &value) {
+    std::filesystem::path path = value;
+    if (value.empty() || !path.is_absolute()) {
+        throw std::runtime_error(
+            fmt::format("{} must be an absolute path: {}", key, value));
+    }
+    return path;
+}
+
+std::vector<float> parseTimes(const std::string &value) {
+    std::vector<float> times;
+    std::istringstream in(value);
+    std::string token;
+    while (in >> token) {
+        float time = 0.0f;
+        try {
+            size_t used = 0;
+            time = std::stof(token, &used);
+            if (used != token.size())
+                throw std::invalid_argument(token);
+        } catch (const std::exception &) {
+            throw std::runtime_error("Invalid time: " + token);
+        }
+        if (!std::isfinite(time))
+            throw std::runtime_error("Invalid time: " + token);
+        times.push_back(time);
+    }
+    if (times.empty() || times.size() > kMaxTimes) {
+        throw std::runtime_error(
+            fmt::format("times needs 1..{} values", kMaxTimes));
+    }
+    return times;
+}
+} // namespace
+
+Request parseRequest(std::istream &in) {
+    Request request;
+    bool any = false;
+    std::string line;
+    while (std::getline(in, line)) {
+        const std::string text = trim(line);
+        if (text.empty()) {
+            if (any)
+                break;
+            continue;
+        }
+        any = true;
+        if (text == "shutdown") {
+            request.shutdown = true;
+            continue;
+        }
+        const size_t space = text.find_first_of(" \t");
+        const std::string key = text.substr(0, space);
+        const std::string value =
+            space == std::string::npos ? "" : trim(text.substr(space));
+        if (key == "shader") {
+            request.shader = parsePath(key, value);
+        } else if (key == "toy") {
+            if (value != "0" && value != "1")
+                throw std::runtime_error("toy must be 0 or 1: " + value);
+            request.toy = value == "1";
+        } else if (key == "width") {
+            request.width = parseSize(key, value);
+        } else if (key == "height") {
+            request.height = parseSize(key, value);
+        } else if (key == "times") {
+            request.times = parseTimes(value);
+        } else if (key == "output") {
+            request.output = parsePath(key, value);
+        } else if (key == "format") {
+            const auto format = image_sequence::parseFormat(value);
+            if (!format)
+                throw std::runtime_error("Unknown format: " + value);
+            request.format = *format;
+        } else {
+            throw std::runtime_error("Unknown request key: " + key);
+        }
+    }
+    if (!any)
+        throw std::runtime_error("Empty request");
+    if (request.shutdown)
+        return request;
+    if (request.shader.empty())
+        throw std::runtime_error("Request has no shader");
+    if (request.output.empty())
+        throw std::runtime_error("Request has no output");
+    if (request.times.empty())
+        throw std::runtime_error("Request has no times");
+    return request;
+}
+
+std::string okReply(size_t frames, const Latency &latency, bool warm) {
+    return fmt::format(
+        "ok frames={} ms={:.2f} setup_ms={:.2f} render_ms={:.2f} warm={}\n",
+        frames, latency.totalMs, latency.setupMs, latency.renderMs,
+        warm ? 1 : 0);
+}
+
+std::string errorReply(const std::string &message) {
+    std::string flat = message;
+    for (char &c : flat) {
+        if (c == '\n' || c == '\r')
+            c = ' ';
+    }
+    return "error " + flat + "\n";
+}
+} // namespace render_request
@@ -0,0 +1,222 @@
+#include "render_shards.h"
+#include "ffmpeg_utils.h"
+
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <cerrno>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif
+
+namespace render_shards {
+namespace {
+// Flags the coordinator rewrites per worker; all take one value.
+constexpr std::string_view SHARD_FLAGS[] = {
+    "--ffmpeg-shards",
+    "--ffmpeg-output",
+    "--frame-start",
+    "--frame-end",
+};
+
+#if defined(_WIN32)
+using ProcessHandle = intptr_t;
+
+// _spawnv joins argv with spaces, so arguments with spaces need quotes.
+std::string quoteArg(const std::string &arg) {
+    if (arg.find_first_of(" \t\"") == std::string::npos)
+        return arg;
+    std::string quoted = "\"";
+    for (char c : arg) {
+        if (c == '"')
+            quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+ProcessHandle spawnProcess(const std::filesystem::path &exePath,
+                           const std::vector<std::string> &args) {
+    std::vector<std::string> quoted;
+    quoted.reserve(args.size() + 1);
+    quoted.push_back(quoteArg(exePath.string()));
+    for (const auto &arg : args)
+        quoted.push_back(quoteArg(arg));
+    std::vector<const char *> argv;
+    for (const auto &arg : quoted)
+        argv.push_back(arg.c_str());
+    argv.push_back(nullptr);
+
+    const intptr_t handle =
+        _spawnv(_P_NOWAIT, exePath.string().c_str(), argv.data());
+    if (handle == -1)
+        throw std::runtime_error("Failed to start worker: " +
+                                 exePath.string());
+    return handle;
+}
+
+int waitProcess(ProcessHandle handle) {
+    int status = 0;
+    if (_cwait(&status, handle, _WAIT_CHILD) == -1)
+        return -1;
+    return status;
+}
+#else
+using ProcessHandle = pid_t;
+
+ProcessHandle spawnProcess(const std::filesystem::path &exePath,
+                           const std::vector<std::string> &args) {
+    const std::string exe = exePath.string();
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>(exe.c_str()));
+    for (const auto &arg : args)
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    pid_t pid = 0;
+    const int err =
+        posix_spawnp(&pid, exe.c_str(), nullptr, nullptr, argv.data(), environ);
+    if (err != 0)
+        throw std::runtime_error(fmt::format(
+            "Failed to start worker {}: {}", exe,
+            std::system_category().message(err)));
+    return pid;
+}
+
+int waitProcess(ProcessHandle pid) {
+    int status = 0;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR)
+            return -1;
+    }
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+    return -1;
+}
+#endif
+} // namespace
+
+std::vector<FrameRange> splitFrameRange(FrameRange range,
+                                        uint32_t shardCount) {
+    if (range.end <= range.start)
+        throw std::runtime_error("Frame range is empty");
+    const uint32_t frames = range.end - range.start;
+    const uint32_t shards = std::clamp(shardCount, 1u, frames);
+
+    std::vector<FrameRange> ranges;
+    ranges.reserve(shards);
+    // The first (frames % shards) shards get one extra frame.
+    uint32_t start = range.start;
+    for (uint32_t i = 0; i < shards; ++i) {
+        const uint32_t count = frames / shards + (i < frames % shards ? 1 : 0);
+        ranges.push_back(FrameRange{start, start + count});
+        start += count;
+    }
+    return ranges;
+}
+
+std::filesystem::path segmentPath(const std::filesystem::path &outputPath,
+                                  size_t index) {
+    std::filesystem::path segment = outputPath;
+    segment.replace_filename(fmt::format("{}.shard{}{}",
+                                         outputPath.stem().string(), index,
+                                         outputPath.extension().string()));
+    return segment;
+}
+
+std::vector<std::string>
+workerArgs(const std::vector<std::string> &coordinatorArgs,
+           const FrameRange &range, const std::filesystem::path &segment) {
+    std::vector<std::string> args;
+    args.reserve(coordinatorArgs.size() + 6);
+    for (size_t i = 0; i < coordinatorArgs.size(); ++i) {
+        const std::string &arg = coordinatorArgs[i];
+        if (std::find(std::begin(SHARD_FLAGS), std::end(SHARD_FLAGS), arg) !=
+            std::end(SHARD_FLAGS)) {
+            ++i; // Skip the flag's value too.
+            continue;
+        }
+        args.push_back(arg);
+    }
+    args.insert(args.end(), {"--frame-start", std::to_string(range.start),
+                             "--frame-end", std::to_string(range.end),
+                             "--ffmpeg-output", segment.string()});
+    return args;
+}
+
+void runShardedRender(const std::filesystem::path &exePath,
+                      const std::vector<std::string> &coordinatorArgs,
+                      FrameRange range, uint32_t shardCount,
+                      const std::filesystem::path &outputPath) {
+    const std::vector<FrameRange> ranges = splitFrameRange(range, shardCount);
+    std::vector<std::filesystem::path> segments;
+    for (size_t i = 0; i < ranges.size(); ++i)
+        segments.push_back(segmentPath(outputPath, i));
+
+    const auto removeSegments = [&segments]() {
+        std::error_code ec;
+        for (const auto &segment : segments)
+            std::filesystem::remove(segment, ec);
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<ProcessHandle> workers;
+    try {
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            spdlog::info("Shard {}: frames [{}, {}) -> {}", i, ranges[i].start,
+                         ranges[i].end, segments[i].string());
+            workers.push_back(spawnProcess(
+                exePath, workerArgs(coordinatorArgs, ranges[i], segments[i])));
+        }
+    } catch (...) {
+        // Don't leave already started workers running unattended.
+        for (ProcessHandle worker : workers)
+            (void)waitProcess(worker);
+        removeSegments();
+        throw;
+    }
+
+    std::vector<size_t> failed;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        const int rc = waitProcess(workers[i]);
+        if (rc != 0) {
+            spdlog::error("Shard {} failed (exit code {})", i, rc);
+            failed.push_back(i);
+        }
+    }
+    if (!failed.empty()) {
+        removeSegments();
+        throw std::runtime_error(
+            fmt::format("{} of {} shard(s) failed", failed.size(),
+                        workers.size()));
+    }
+
+    const auto rendered = std::chrono::steady_clock::now();
+    try {
+        std::vector<std::string> segmentPaths;
+        for (const auto &segment : segments)
+            segmentPaths.push_back(segment.string());
+        ffmpeg_utils::concatSegments(segmentPaths, outputPath.string());
+    } catch (...) {
+        removeSegments();
+        throw;
+    }
+    removeSegments();
+
+    using Ms = std::chrono::duration<double, std::milli>;
+    spdlog::info("Sharded render done: {} shard(s), render {:.0f} ms, join "
+                 "{:.0f} ms",
+                 workers.size(), Ms(rendered - start).count(),
+                 Ms(std::chrono::steady_clock::now() - rendered).count());
+}
+} // namespace render_shards
@@ -0,0 +1,50 @@
+#include "ring_depth_controller.h"
+
+#include <algorithm>
+
+RingDepthController::RingDepthController(const Config &config)
+    : config(config),
+      currentDepth(std::min(config.minDepth, config.maxDepth)),
+      maxSeenDepth(currentDepth) {}
+
+uint32_t RingDepthController::addFrame(const FrameTimes &times) {
+    producerBusyMs += times.gpuMs + times.readbackMs;
+    consumerBusyMs += times.encodeMs;
+    wallMs += times.wallMs;
+    if (++windowCount >= config.windowFrames)
+        endWindow();
+    return currentDepth;
+}
+
+void RingDepthController::endWindow() {
+    const double wall = std::max(wallMs, 1e-6);
+    const double producerIdle = std::max(0.0, 1.0 - producerBusyMs / wall);
+    const double consumerIdle = std::max(0.0, 1.0 - consumerBusyMs / wall);
+    const double bottleneckIdle =
+        consumerBusyMs >= producerBusyMs ? consumerIdle : producerIdle;
+
+    if (cooldownWindows > 0)
+        --cooldownWindows;
+
+    if (bottleneckIdle > config.growIdleFraction &&
+        currentDepth < config.maxDepth) {
+        ++currentDepth;
+        maxSeenDepth = std::max(maxSeenDepth, currentDepth);
+        calmWindows = 0;
+        cooldownWindows = config.growCooldownWindows;
+    } else if (bottleneckIdle < config.shrinkIdleFraction &&
+               currentDepth > config.minDepth) {
+        if (++calmWindows >= config.shrinkAfterWindows &&
+            cooldownWindows == 0) {
+            --currentDepth;
+            calmWindows = 0;
+        }
+    } else {
+        calmWindows = 0;
+    }
+
+    windowCount = 0;
+    producerBusyMs = 0.0;
+    consumerBusyMs = 0.0;
+    wallMs = 0.0;
+}
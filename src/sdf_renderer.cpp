@@ -46,5 +46,6 @@ SDFRenderer::buildPushConstants(float timeSeconds, uint32_t currentFrame,
     pushConstants.iFrame = currentFrame;
     pushConstants.iResolution = resolution;
     pushConstants.iMouse = glm::vec2{-1000, -1000};
+    pushConstants.iTileOffset = glm::vec2{0, 0};
     return pushConstants;
 }
@@ -1,3 +1,5 @@
+#include "shader_utils.h"
+#include "pipeline_cache.h"
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
@@ -6,11 +8,15 @@
 #include <glslang/Public/ShaderLang.h>
 #include <glslang/SPIRV/GlslangToSpv.h>
 #include <glslang/SPIRV/Logger.h>
+#if __has_include(<glslang/build_info.h>)
+#include <glslang/build_info.h>
+#endif
 #include <spdlog/fmt/fmt.h>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
+#include <unordered_set>
 #include <vector>
 
 static constexpr char TOY_TEMPLATE_FRAG_SOURCE[] = R"(#version 450
@@ -19,12 +25,36 @@ static constexpr char TOY_TEMPLATE_FRAG_SOURCE[] = R"(#version 450
 // eg. for a shader toy shader.
 // Not everything yet...
 
+// The offline renderer defines VSDF_FRAME_UBO and feeds these from a
+// per-slot uniform buffer so its command buffers can be recorded once.
+// Layered renders also define VSDF_FRAME_LAYERS: every instance draws the
+// next frame into its own array layer and reads that frame's entry.
+#if defined(VSDF_FRAME_LAYERS)
+struct VsdfFrameInputs {
+    float iTime;
+    int iFrame;
+    vec2 iResolution;
+    vec2 iMouse;
+    vec2 iTileOffset;
+};
+layout (set = 0, binding = 0) uniform FrameInputs {
+    VsdfFrameInputs layers[VSDF_FRAME_LAYERS];
+} frameInputs;
+layout (location = 1) flat in int vsdfLayer;
+#define pc frameInputs.layers[vsdfLayer]
+#else
+#ifdef VSDF_FRAME_UBO
+layout (set = 0, binding = 0) uniform FrameInputs {
+#else
 layout (push_constant) uniform PushConstants {
+#endif
     float iTime;
     int iFrame;
     vec2 iResolution;
     vec2 iMouse;
+    vec2 iTileOffset;
 } pc;
+#endif
 
 layout (location = 0) in vec2 TexCoord;
 layout (location = 0) out vec4 color;
@@ -38,8 +68,10 @@ void mainImage(out vec4 fragColor, in vec2 fragCoord);
 void main() {
     // Call your existing mainImage function
     vec4 fragColor;
+    // Tiled offline renders draw each tile at the image origin
+    vec2 fragCoord = gl_FragCoord.xy + pc.iTileOffset;
     // Convert from vulkan to glsl
-    mainImage(fragColor, vec2(gl_FragCoord.x, iResolution.y - gl_FragCoord.y));
+    mainImage(fragColor, vec2(fragCoord.x, iResolution.y - fragCoord.y));
     // Output color
     color = fragColor;
 }
@@ -47,6 +79,12 @@ void main() {
 )";
 
 static constexpr char FULLSCREEN_QUAD_VERT_SOURCE[] = R"(#version 450
+#ifdef VSDF_FRAME_LAYERS
+// One instance per layer of a layered offline render; the fragment shader
+// picks its frame inputs by layer.
+#extension GL_ARB_shader_viewport_layer_array : require
+layout(location = 1) flat out int vsdfLayer;
+#endif
 
 layout(location = 0) out vec2 texCoord;
 
@@ -59,6 +97,121 @@ void main() {
     uint index = gl_VertexIndex % 6;  // Ensure the index wraps around if needed
     gl_Position = vec4(vertices[index], 0.0, 1.0);
     texCoord = vertices[index] * 0.5 + 0.5;
+#ifdef VSDF_FRAME_LAYERS
+    gl_Layer = gl_InstanceIndex;
+    vsdfLayer = gl_InstanceIndex;
+#endif
+}
+)";
+
+// Converts the rendered RGBA image into YUV420P or NV12 planes, written
+// straight into the readback buffer so only 1.5 bytes/pixel leave the GPU.
+// Each invocation handles an 8x2 pixel block so every store is a whole
+// 32-bit word (requires width % 8 == 0 and height % 2 == 0).
+// Coefficients are BT.601 limited range to match swscale's default output.
+static constexpr char RGBA_TO_YUV_COMP_SOURCE[] = R"(#version 450
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 0) uniform sampler2D srcImage;
+layout(std430, set = 0, binding = 1) writeonly buffer Planes {
+    uint words[];
+} dst;
+
+layout(push_constant) uniform Params {
+    uint width;
+    uint height;
+    uint chromaOffset;
+    uint crOffset;
+    uint interleaved;
+} params;
+
+float lumaOf(vec3 rgb) {
+    return 16.0 + dot(rgb, vec3(65.481, 128.553, 24.966));
+}
+
+float cbOf(vec3 rgb) {
+    return 128.0 + dot(rgb, vec3(-37.797, -74.203, 112.0));
+}
+
+float crOf(vec3 rgb) {
+    return 128.0 + dot(rgb, vec3(112.0, -93.786, -18.214));
+}
+
+uint pack4(float a, float b, float c, float d) {
+    uvec4 v = uvec4(clamp(round(vec4(a, b, c, d)), 0.0, 255.0));
+    return v.x | (v.y << 8) | (v.z << 16) | (v.w << 24);
+}
+
+void main() {
+    uint x0 = gl_GlobalInvocationID.x * 8u;
+    uint y0 = gl_GlobalInvocationID.y * 2u;
+    if (x0 >= params.width || y0 >= params.height)
+        return;
+
+    float luma[16];
+    vec3 chroma[4] = vec3[](vec3(0.0), vec3(0.0), vec3(0.0), vec3(0.0));
+    for (uint row = 0u; row < 2u; ++row) {
+        for (uint col = 0u; col < 8u; ++col) {
+            vec3 rgb =
+                texelFetch(srcImage, ivec2(x0 + col, y0 + row), 0).rgb;
+            luma[row * 8u + col] = lumaOf(rgb);
+            chroma[col / 2u] += rgb * 0.25;
+        }
+    }
+
+    uint rowWords = params.width / 4u;
+    uint yWord = (y0 * params.width + x0) / 4u;
+    dst.words[yWord] = pack4(luma[0], luma[1], luma[2], luma[3]);
+    dst.words[yWord + 1u] = pack4(luma[4], luma[5], luma[6], luma[7]);
+    dst.words[yWord + rowWords] =
+        pack4(luma[8], luma[9], luma[10], luma[11]);
+    dst.words[yWord + rowWords + 1u] =
+        pack4(luma[12], luma[13], luma[14], luma[15]);
+
+    uint chromaRow = y0 / 2u;
+    if (params.interleaved != 0u) {
+        // NV12: one plane of interleaved U/V pairs, width bytes per row.
+        uint uvWord = (params.chromaOffset + chromaRow * params.width + x0) / 4u;
+        dst.words[uvWord] = pack4(cbOf(chroma[0]), crOf(chroma[0]),
+                                  cbOf(chroma[1]), crOf(chroma[1]));
+        dst.words[uvWord + 1u] = pack4(cbOf(chroma[2]), crOf(chroma[2]),
+                                       cbOf(chroma[3]), crOf(chroma[3]));
+    } else {
+        // YUV420P: separate U and V planes, width / 2 bytes per row.
+        uint planeByte = chromaRow * (params.width / 2u) + x0 / 2u;
+        dst.words[(params.chromaOffset + planeByte) / 4u] =
+            pack4(cbOf(chroma[0]), cbOf(chroma[1]), cbOf(chroma[2]),
+                  cbOf(chroma[3]));
+        dst.words[(params.crOffset + planeByte) / 4u] =
+            pack4(crOf(chroma[0]), crOf(chroma[1]), crOf(chroma[2]),
+                  crOf(chroma[3]));
+    }
+}
+)";
+
+// Supersampling resolve: averages each factor x factor block of the
+// high-resolution render into one output pixel (box filter). Drawn as a
+// fullscreen quad into the ring slot image at the output size.
+static constexpr char BOX_DOWNSAMPLE_FRAG_SOURCE[] = R"(#version 450
+
+layout(set = 0, binding = 0) uniform sampler2D srcImage;
+
+layout(push_constant) uniform Params {
+    uint factor;
+} params;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    ivec2 base = ivec2(gl_FragCoord.xy) * int(params.factor);
+    vec4 sum = vec4(0.0);
+    for (uint y = 0u; y < params.factor; ++y) {
+        for (uint x = 0u; x < params.factor; ++x) {
+            sum += texelFetch(srcImage, base + ivec2(x, y), 0);
+        }
+    }
+    outColor = sum / float(params.factor * params.factor);
 }
 )";
 
@@ -135,12 +288,51 @@ std::string readShaderToySource(const std::string &filename) {
     return result;
 }
 
-static std::vector<uint32_t> compileToSpirv(const char *shaderSource,
-                                            EShLanguage lang,
-                                            bool useToyTemplate) {
-    glslang::InitializeProcess();
-    glslang::TShader shader(lang);
+// Enough for thousands of typical shaders; the least recently used go
+// first past these.
+static constexpr size_t SPIRV_CACHE_MEMORY_BYTES = 16u << 20;
+static constexpr size_t SPIRV_CACHE_DISK_BYTES = 64u << 20;
+
+// Shares the pipeline cache's directory.
+static spirv_cache::Cache &spirvCache() {
+    static spirv_cache::Cache cache = [] {
+        auto dir = pipeline_cache::defaultDirectory();
+        if (!dir.empty())
+            dir /= "spirv";
+        return spirv_cache::Cache(dir, SPIRV_CACHE_MEMORY_BYTES,
+                                  SPIRV_CACHE_DISK_BYTES);
+    }();
+    return cache;
+}
+
+spirv_cache::Stats spirvCacheStats() { return spirvCache().stats(); }
+
+// glslang's process-wide tables are built on the first compile and torn
+// down at exit rather than around every compile. Compiles on different
+// threads (hot reload, batch jobs) share them.
+static void initGlslangOnce() {
+    static const struct GlslangProcess {
+        GlslangProcess() { glslang::InitializeProcess(); }
+        ~GlslangProcess() { glslang::FinalizeProcess(); }
+    } process;
+}
 
+// Defines telling the toy template (and shaders that check them) where
+// the frame inputs are.
+static std::string frameInputsPreamble(shader_utils::FrameInputs frameInputs,
+                                       uint32_t frameLayers) {
+    std::string preamble;
+    if (frameInputs == shader_utils::FrameInputs::UniformBuffer)
+        preamble += "#define VSDF_FRAME_UBO 1\n";
+    if (frameLayers > 1)
+        preamble += fmt::format("#define VSDF_FRAME_LAYERS {}\n", frameLayers);
+    return preamble;
+}
+
+static std::vector<uint32_t>
+compileToSpirv(const char *shaderSource, EShLanguage lang,
+               bool useToyTemplate, const std::string &preamble = {},
+               bool spirv15 = false) {
     // https://github.com/KhronosGroup/glslang/blob/main/StandAlone/StandAlone.cpp#L588
     glslang::EShClient Client;
     glslang::EshTargetClientVersion ClientVersion;
@@ -150,12 +342,45 @@ static std::vector<uint32_t> compileToSpirv(const char *shaderSource,
         ClientVersion = glslang::EShTargetOpenGL_450;
     } else {
         Client = glslang::EShClientVulkan;
-        ClientVersion = glslang::EShTargetVulkan_1_0;
+        // SPIR-V 1.5 (Vulkan 1.2) has gl_Layer in the vertex stage as the
+        // core ShaderLayer capability.
+        ClientVersion = spirv15 ? glslang::EShTargetVulkan_1_2
+                                : glslang::EShTargetVulkan_1_0;
     }
 
     // https://github.com/KhronosGroup/glslang/blob/main/StandAlone/StandAlone.cpp#L1097
     glslang::EShTargetLanguage TargetLanguage = glslang::EShTargetSpv;
-    glslang::EShTargetLanguageVersion TargetVersion = glslang::EShTargetSpv_1_0;
+    glslang::EShTargetLanguageVersion TargetVersion =
+        spirv15 ? glslang::EShTargetSpv_1_5 : glslang::EShTargetSpv_1_0;
+
+    // Everything that decides the output; there are no #includes, so the
+    // source and preamble are the whole input.
+    std::string keyInput = fmt::format(
+        "vsdf-spirv-1 {} {} {} {} ", static_cast<int>(lang),
+        static_cast<int>(Client), static_cast<int>(ClientVersion),
+        static_cast<int>(TargetVersion));
+#if defined(GLSLANG_VERSION_MAJOR)
+    keyInput += fmt::format("glslang-{}.{}.{} ", GLSLANG_VERSION_MAJOR,
+                            GLSLANG_VERSION_MINOR, GLSLANG_VERSION_PATCH);
+#endif
+    keyInput += preamble;
+    keyInput += '\0';
+    keyInput += shaderSource;
+    const std::string cacheKey = spirv_cache::makeKey(keyInput);
+    if (auto cached = spirvCache().find(cacheKey)) {
+        const auto stats = spirvCache().stats();
+        spdlog::info("SPIR-V cache hit {} ({} memory / {} disk hits, {} "
+                     "misses)",
+                     cacheKey, stats.memoryHits, stats.diskHits,
+                     stats.misses);
+        return std::move(*cached);
+    }
+
+    initGlslangOnce();
+    glslang::TShader shader(lang);
+    // Goes in after the #version line.
+    if (!preamble.empty())
+        shader.setPreamble(preamble.c_str());
     shader.setEnvClient(Client, ClientVersion);
     shader.setEnvTarget(TargetLanguage, TargetVersion);
 
@@ -195,12 +420,14 @@ static std::vector<uint32_t> compileToSpirv(const char *shaderSource,
 
     spdlog::info("Logger messages: {}", logger.getAllMessages());
 
-    glslang::FinalizeProcess();
+    spirvCache().store(cacheKey, spirv);
     return spirv;
 }
 
 std::vector<uint32_t> compileFileToSpirv(const std::string &shaderFilename,
-                                         bool useToyTemplate) {
+                                         bool useToyTemplate,
+                                         FrameInputs frameInputs,
+                                         uint32_t frameLayers) {
     // Used to compile shaders from a file directly to SPIR-V in memory.
     // With .frag shaders we sometimes use the toy template which does
     // old school GLSL ShaderToy style format (eg. iTime and so on).
@@ -216,11 +443,108 @@ std::vector<uint32_t> compileFileToSpirv(const std::string &shaderFilename,
         shaderString = readShaderSource(shaderFilename);
     }
 
-    return compileToSpirv(shaderString.data(), lang, useToyTemplate);
+    return compileToSpirv(shaderString.data(), lang, useToyTemplate,
+                          frameInputsPreamble(frameInputs, frameLayers));
+}
+
+std::vector<uint32_t> compileSourceToSpirv(const std::string &source,
+                                           const std::string &shaderFilename,
+                                           bool useToyTemplate,
+                                           FrameInputs frameInputs,
+                                           uint32_t frameLayers) {
+    spdlog::info("Compiling shader: {}", shaderFilename);
+    EShLanguage lang = getShaderLang(
+        std::filesystem::path(shaderFilename).extension().string());
+    const std::string shaderString =
+        useToyTemplate ? TOY_TEMPLATE_FRAG_SOURCE + source : source;
+    return compileToSpirv(shaderString.data(), lang, useToyTemplate,
+                          frameInputsPreamble(frameInputs, frameLayers));
+}
+
+// Calls visit(opcode, word index, word count) for every instruction after
+// the 5 word header.
+template <typename Visit>
+static void forEachInstruction(const std::vector<uint32_t> &spirv,
+                               Visit &&visit) {
+    constexpr size_t HEADER_WORDS = 5;
+    size_t i = HEADER_WORDS;
+    while (i < spirv.size()) {
+        const uint32_t wordCount = spirv[i] >> 16;
+        const uint32_t opcode = spirv[i] & 0xffffu;
+        if (wordCount == 0 || i + wordCount > spirv.size())
+            throw std::runtime_error("Malformed SPIR-V");
+        visit(opcode, i, wordCount);
+        i += wordCount;
+    }
+}
+
+// OpVariable <result type> <result id> <storage class> [init]
+constexpr uint32_t OP_VARIABLE = 59;
+
+bool usesPushConstants(const std::vector<uint32_t> &spirv) {
+    // Looking for an OpVariable in the PushConstant storage class.
+    constexpr uint32_t STORAGE_CLASS_PUSH_CONSTANT = 9;
+    bool found = false;
+    forEachInstruction(spirv, [&](uint32_t opcode, size_t i,
+                                  uint32_t wordCount) {
+        if (opcode == OP_VARIABLE && wordCount >= 4 &&
+            spirv[i + 3] == STORAGE_CLASS_PUSH_CONSTANT)
+            found = true;
+    });
+    return found;
+}
+
+bool readsFrameLayer(const std::vector<uint32_t> &spirv) {
+    // vsdfLayer is the flat int input at location 1; declaring it isn't
+    // enough, something has to OpLoad it to pick the layer's inputs.
+    constexpr uint32_t OP_LOAD = 61;
+    constexpr uint32_t OP_DECORATE = 71;
+    constexpr uint32_t DECORATION_LOCATION = 30;
+    constexpr uint32_t STORAGE_CLASS_INPUT = 1;
+    constexpr uint32_t LAYER_LOCATION = 1;
+    std::unordered_set<uint32_t> atLayerLocation;
+    std::unordered_set<uint32_t> layerInputs;
+    std::unordered_set<uint32_t> loaded;
+    forEachInstruction(spirv, [&](uint32_t opcode, size_t i,
+                                  uint32_t wordCount) {
+        // OpDecorate <target> <decoration> [literals]
+        if (opcode == OP_DECORATE && wordCount >= 4 &&
+            spirv[i + 2] == DECORATION_LOCATION &&
+            spirv[i + 3] == LAYER_LOCATION) {
+            atLayerLocation.insert(spirv[i + 1]);
+        } else if (opcode == OP_VARIABLE && wordCount >= 4 &&
+                   spirv[i + 3] == STORAGE_CLASS_INPUT) {
+            layerInputs.insert(spirv[i + 2]);
+        } else if (opcode == OP_LOAD && wordCount >= 4) {
+            // OpLoad <result type> <result id> <pointer> [memory access]
+            loaded.insert(spirv[i + 3]);
+        }
+    });
+    for (const uint32_t id : layerInputs) {
+        if (atLayerLocation.count(id) && loaded.count(id))
+            return true;
+    }
+    return false;
 }
 
-std::vector<uint32_t> compileFullscreenQuadVertSpirv() {
+std::vector<uint32_t> compileFullscreenQuadVertSpirv(uint32_t frameLayers) {
     spdlog::info("Compiling embedded fullscreen quad vertex shader");
-    return compileToSpirv(FULLSCREEN_QUAD_VERT_SOURCE, EShLangVertex, false);
+    if (frameLayers <= 1)
+        return compileToSpirv(FULLSCREEN_QUAD_VERT_SOURCE, EShLangVertex,
+                              false);
+    return compileToSpirv(FULLSCREEN_QUAD_VERT_SOURCE, EShLangVertex, false,
+                          frameInputsPreamble(FrameInputs::UniformBuffer,
+                                              frameLayers),
+                          true);
+}
+
+std::vector<uint32_t> compileRgbaToYuvCompSpirv() {
+    spdlog::info("Compiling embedded RGBA to YUV compute shader");
+    return compileToSpirv(RGBA_TO_YUV_COMP_SOURCE, EShLangCompute, false);
+}
+
+std::vector<uint32_t> compileBoxDownsampleFragSpirv() {
+    spdlog::info("Compiling embedded box downsample fragment shader");
+    return compileToSpirv(BOX_DOWNSAMPLE_FRAG_SOURCE, EShLangFragment, false);
 }
 } // namespace shader_utils
@@ -0,0 +1,184 @@
+#include "spirv_cache.h"
+#include "content_hash.h"
+
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace spirv_cache {
+namespace {
+constexpr uint32_t kSpirvMagic = 0x07230203;
+constexpr const char *kExtension = ".spv";
+
+size_t byteSize(const std::vector<uint32_t> &spirv) {
+    return spirv.size() * sizeof(uint32_t);
+}
+
+std::optional<std::vector<uint32_t>>
+readSpirv(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in.is_open())
+        return std::nullopt;
+    const auto size = static_cast<size_t>(in.tellg());
+    if (size == 0 || size % sizeof(uint32_t) != 0)
+        return std::nullopt;
+    in.seekg(0);
+    std::vector<uint32_t> spirv(size / sizeof(uint32_t));
+    in.read(reinterpret_cast<char *>(spirv.data()),
+            static_cast<std::streamsize>(size));
+    // A torn or foreign file; the compiler will replace it.
+    if (!in || spirv[0] != kSpirvMagic)
+        return std::nullopt;
+    return spirv;
+}
+} // namespace
+
+std::string makeKey(std::string_view input) {
+    return fmt::format("{:016x}{:08x}", content_hash::fnv1a(input),
+                       input.size());
+}
+
+Cache::Cache(std::filesystem::path directory, size_t maxMemoryBytes,
+             size_t maxDiskBytes)
+    : directory(std::move(directory)), maxMemoryBytes(maxMemoryBytes),
+      maxDiskBytes(maxDiskBytes) {}
+
+std::optional<std::vector<uint32_t>> Cache::find(const std::string &key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (const auto it = entries.find(key); it != entries.end()) {
+        lru.splice(lru.begin(), lru, it->second.lruPosition);
+        ++counters.memoryHits;
+        return it->second.spirv;
+    }
+    if (!directory.empty()) {
+        const auto path = diskPath(key);
+        if (auto spirv = readSpirv(path)) {
+            // The modification time orders disk eviction.
+            std::error_code ec;
+            std::filesystem::last_write_time(
+                path, std::filesystem::file_time_type::clock::now(), ec);
+            ++counters.diskHits;
+            storeInMemory(key, *spirv);
+            return spirv;
+        }
+    }
+    ++counters.misses;
+    return std::nullopt;
+}
+
+void Cache::store(const std::string &key,
+                  const std::vector<uint32_t> &spirv) {
+    std::lock_guard<std::mutex> lock(mutex);
+    storeInMemory(key, spirv);
+    if (!directory.empty())
+        storeOnDisk(key, spirv);
+}
+
+Stats Cache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+std::filesystem::path Cache::diskPath(const std::string &key) const {
+    return directory / (key + kExtension);
+}
+
+void Cache::storeInMemory(const std::string &key,
+                          std::vector<uint32_t> spirv) {
+    if (byteSize(spirv) > maxMemoryBytes)
+        return;
+    if (const auto it = entries.find(key); it != entries.end()) {
+        memoryBytes -= byteSize(it->second.spirv);
+        lru.erase(it->second.lruPosition);
+        entries.erase(it);
+    }
+    memoryBytes += byteSize(spirv);
+    lru.push_front(key);
+    entries.emplace(key, Entry{std::move(spirv), lru.begin()});
+    while (memoryBytes > maxMemoryBytes) {
+        const auto oldest = entries.find(lru.back());
+        memoryBytes -= byteSize(oldest->second.spirv);
+        entries.erase(oldest);
+        lru.pop_back();
+        ++counters.evictions;
+    }
+}
+
+void Cache::storeOnDisk(const std::string &key,
+                        const std::vector<uint32_t> &spirv) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    const auto path = diskPath(key);
+    // Per process, so two instances compiling the same shader don't share
+    // a temp file.
+    auto tmpPath = path;
+    tmpPath += fmt::format(".{}.tmp", getpid());
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(spirv.data()),
+                  static_cast<std::streamsize>(byteSize(spirv)));
+        out.flush();
+        if (!out) {
+            out.close();
+            std::filesystem::remove(tmpPath, ec);
+            spdlog::warn("Failed to write SPIR-V cache entry {}",
+                         tmpPath.string());
+            return;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmpPath, ec);
+        spdlog::warn("Failed to write SPIR-V cache entry {}", path.string());
+        return;
+    }
+    trimDisk();
+}
+
+void Cache::trimDisk() {
+    struct File {
+        std::filesystem::path path;
+        std::filesystem::file_time_type written;
+        uintmax_t size;
+    };
+    std::vector<File> files;
+    uintmax_t total = 0;
+    std::error_code ec;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(directory, ec)) {
+        if (entry.path().extension() != kExtension)
+            continue;
+        std::error_code entryEc;
+        const uintmax_t size = entry.file_size(entryEc);
+        const auto written = entry.last_write_time(entryEc);
+        if (entryEc)
+            continue;
+        files.push_back({entry.path(), written, size});
+        total += size;
+    }
+    if (total <= maxDiskBytes)
+        return;
+    std::sort(files.begin(), files.end(), [](const File &a, const File &b) {
+        return a.written < b.written;
+    });
+    for (const File &file : files) {
+        if (total <= maxDiskBytes)
+            break;
+        if (std::filesystem::remove(file.path, ec)) {
+            total -= file.size;
+            ++counters.evictions;
+        }
+    }
+}
+} // namespace spirv_cache
@@ -0,0 +1,154 @@
+#include "stage_profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+namespace {
+// Nearest-rank percentile of sorted values.
+double percentile(const std::vector<double> &sorted, double p) {
+    const double rank =
+        std::ceil(p / 100.0 * static_cast<double>(sorted.size()));
+    const size_t index = static_cast<size_t>(std::max(rank, 1.0)) - 1;
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+using Seconds = std::chrono::duration<double>;
+} // namespace
+
+std::string_view StageProfiler::stageName(Stage stage) {
+    switch (stage) {
+    case Stage::GpuRender:
+        return "gpu_render";
+    case Stage::GpuReadback:
+        return "gpu_readback";
+    case Stage::Record:
+        return "record";
+    case Stage::Submit:
+        return "submit";
+    case Stage::SubmitToDone:
+        return "submit_to_done";
+    case Stage::WaitForFrame:
+        return "wait_for_frame";
+    case Stage::Convert:
+        return "convert";
+    case Stage::Send:
+        return "send";
+    case Stage::Receive:
+        return "receive";
+    case Stage::Mux:
+        return "mux";
+    case Stage::Output:
+        return "output";
+    case Stage::Frame:
+        return "frame";
+    case Stage::Count:
+        break;
+    }
+    return "unknown";
+}
+
+StageProfiler::Stats StageProfiler::stats(Stage stage) const {
+    Stats result;
+    if (samples.empty())
+        return result;
+
+    std::vector<double> values;
+    values.reserve(samples.size());
+    double total = 0.0;
+    for (const Sample &sample : samples) {
+        values.push_back(sample[stage]);
+        total += sample[stage];
+    }
+    std::sort(values.begin(), values.end());
+    result.p50 = percentile(values, 50.0);
+    result.p95 = percentile(values, 95.0);
+    result.p99 = percentile(values, 99.0);
+    result.max = values.back();
+    result.mean = total / static_cast<double>(values.size());
+    return result;
+}
+
+void StageProfiler::logReport(std::chrono::nanoseconds wallTime,
+                              uint64_t pixelsPerFrame) const {
+    if (samples.empty())
+        return;
+
+    spdlog::info("Stage profile over {} frame(s), ms: p50 / p95 / p99 / max",
+                 samples.size());
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        const auto stage = static_cast<Stage>(i);
+        const Stats s = stats(stage);
+        if (s.max <= 0.0)
+            continue;
+        spdlog::info("  {:<15} {:8.2f} {:8.2f} {:8.2f} {:8.2f}",
+                     stageName(stage), s.p50, s.p95, s.p99, s.max);
+    }
+    const double seconds = Seconds(wallTime).count();
+    if (seconds > 0.0) {
+        const double fps = static_cast<double>(samples.size()) / seconds;
+        spdlog::info("Throughput: {:.1f} frames/s, {:.1f} Mpixel/s ({:.2f} s)",
+                     fps, fps * static_cast<double>(pixelsPerFrame) / 1e6,
+                     seconds);
+    }
+}
+
+void StageProfiler::writeCsv(std::ostream &out) const {
+    out << "frame";
+    for (size_t i = 0; i < STAGE_COUNT; ++i)
+        out << ',' << stageName(static_cast<Stage>(i)) << "_ms";
+    out << '\n';
+    for (const Sample &sample : samples) {
+        out << sample.frameIndex;
+        for (const double ms : sample.ms)
+            out << fmt::format(",{:.4f}", ms);
+        out << '\n';
+    }
+}
+
+void StageProfiler::writeJson(std::ostream &out,
+                              std::chrono::nanoseconds wallTime) const {
+    const double seconds = Seconds(wallTime).count();
+    out << fmt::format("{{\n  \"frames\": {},\n  \"wall_seconds\": {:.4f},\n",
+                       samples.size(), seconds);
+    out << "  \"stages\": {\n";
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        const auto stage = static_cast<Stage>(i);
+        const Stats s = stats(stage);
+        out << fmt::format("    \"{}\": {{\"p50\": {:.4f}, \"p95\": {:.4f}, "
+                           "\"p99\": {:.4f}, \"max\": {:.4f}, "
+                           "\"mean\": {:.4f}}}{}\n",
+                           stageName(stage), s.p50, s.p95, s.p99, s.max,
+                           s.mean, i + 1 < STAGE_COUNT ? "," : "");
+    }
+    out << "  },\n  \"samples\": [\n";
+    for (size_t row = 0; row < samples.size(); ++row) {
+        const Sample &sample = samples[row];
+        out << fmt::format("    {{\"frame\": {}", sample.frameIndex);
+        for (size_t i = 0; i < STAGE_COUNT; ++i) {
+            out << fmt::format(", \"{}\": {:.4f}",
+                               stageName(static_cast<Stage>(i)), sample.ms[i]);
+        }
+        out << (row + 1 < samples.size() ? "},\n" : "}\n");
+    }
+    out << "  ]\n}\n";
+}
+
+void StageProfiler::writeFile(const std::filesystem::path &path,
+                              std::chrono::nanoseconds wallTime) const {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("Failed to open profile output: " +
+                                 path.string());
+    if (path.extension() == ".csv")
+        writeCsv(out);
+    else
+        writeJson(out, wallTime);
+    if (!out)
+        throw std::runtime_error("Failed to write profile output: " +
+                                 path.string());
+    spdlog::info("Stage profile written to {}", path.string());
+}
@@ -0,0 +1,22 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+
+namespace {
+// Points the pipeline and SPIR-V caches (see pipeline_cache.h) at the
+// build tree before any test runs, so neither the tests nor the vsdf
+// runs they spawn write into the user's cache directory.
+class CacheDirEnvironment : public ::testing::Environment {
+  public:
+    void SetUp() override {
+#if defined(_WIN32)
+        _putenv_s("VSDF_CACHE_DIR", VSDF_TEST_CACHE_DIR);
+#else
+        setenv("VSDF_CACHE_DIR", VSDF_TEST_CACHE_DIR, 1);
+#endif
+    }
+};
+
+[[maybe_unused]] ::testing::Environment *const cacheDirEnvironment =
+    ::testing::AddGlobalTestEnvironment(new CacheDirEnvironment);
+} // namespace
@@ -0,0 +1,25 @@
+#include "deferred_destroy_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+TEST(DeferredDestroyQueue, DestroysOnceLastUseCompletes) {
+    DeferredDestroyQueue queue;
+    std::vector<int> destroyed;
+    // Retired while frames 1..3 were in flight, then again after frame 5.
+    queue.retire(3, [&destroyed] { destroyed.push_back(1); });
+    queue.retire(5, [&destroyed] { destroyed.push_back(2); });
+    EXPECT_EQ(queue.size(), 2u);
+
+    EXPECT_EQ(queue.collect(2), 0u);
+    EXPECT_TRUE(destroyed.empty());
+    EXPECT_EQ(queue.collect(4), 1u);
+    EXPECT_EQ(destroyed, std::vector<int>{1});
+    EXPECT_EQ(queue.collect(4), 0u);
+
+    queue.retire(7, [&destroyed] { destroyed.push_back(3); });
+    queue.flush();
+    EXPECT_EQ(destroyed, (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(queue.size(), 0u);
+}
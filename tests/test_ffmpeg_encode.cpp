@@ -1,13 +1,20 @@
 #include "ffmpeg_encode_settings.h"
 #include "ffmpeg_encoder.h"
+#include "frame_converter.h"
 #include "ffmpeg_test_utils.h"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 TEST(FFmpegEncoder, EncodesSmallMp4) {
@@ -98,3 +105,367 @@ TEST(FFmpegEncoder, EncodesSmallMp4) {
 
     std::filesystem::remove(tempPath, ec);
 }
+
+TEST(FFmpegEncoder, EncodesPlanarYuvWithoutConversion) {
+    const std::string encoderName = ffmpeg_test_utils::pickH264EncoderName();
+    ASSERT_FALSE(encoderName.empty()) << "No H.264 encoder available";
+
+    const int width = 128;
+    const int height = 72;
+    const size_t lumaBytes =
+        static_cast<size_t>(width) * static_cast<size_t>(height);
+
+    // Solid red in BT.601 limited range, laid out the way the GPU
+    // conversion pass writes it: Y plane, then U, then V.
+    std::vector<uint8_t> frame(lumaBytes + lumaBytes / 2);
+    std::fill(frame.begin(), frame.begin() + static_cast<long>(lumaBytes), 81);
+    std::fill(frame.begin() + static_cast<long>(lumaBytes),
+              frame.begin() + static_cast<long>(lumaBytes + lumaBytes / 4),
+              90);
+    std::fill(frame.begin() + static_cast<long>(lumaBytes + lumaBytes / 4),
+              frame.end(), 240);
+
+    const auto stamp =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    const std::filesystem::path tempPath =
+        std::filesystem::temp_directory_path() /
+        ("vsdf_ffmpeg_yuv_test_" + std::to_string(stamp) + ".mp4");
+    std::error_code ec;
+    std::filesystem::remove(tempPath, ec);
+
+    ffmpeg_utils::EncodeSettings settings;
+    settings.outputPath = tempPath.string();
+    settings.codec = encoderName;
+    settings.fps = 30;
+    settings.crf = 23;
+    settings.preset = "veryfast";
+
+    ffmpeg_utils::FfmpegEncoder encoder(settings, width, height,
+                                        AV_PIX_FMT_YUV420P, width);
+    ASSERT_NO_THROW(encoder.open());
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_NO_THROW(encoder.encodeFrame(frame.data(), i));
+    }
+    ASSERT_NO_THROW(encoder.flush());
+    ASSERT_NO_THROW(encoder.close());
+
+    const auto decoded =
+        ffmpeg_test_utils::decodeVideoRgb24(tempPath.string());
+    EXPECT_EQ(decoded.width, width);
+    EXPECT_EQ(decoded.height, height);
+    EXPECT_EQ(decoded.frameCount, 5);
+    ASSERT_FALSE(decoded.firstFrame.empty());
+
+    const auto mid = ffmpeg_test_utils::pixelAt(decoded, width / 2, height / 2);
+    EXPECT_GT(mid[0], 200);
+    EXPECT_LT(mid[1], 40);
+    EXPECT_LT(mid[2], 40);
+
+    std::filesystem::remove(tempPath, ec);
+}
+
+TEST(FrameConverter, OutputDoesNotDependOnThreadCount) {
+    // Tall enough for four 64-row slices, with colour changing along both
+    // axes so chroma is filtered across every slice edge.
+    const int width = 128;
+    const int height = 256;
+    const int stride = width * 4;
+
+    std::vector<uint8_t> pixels(static_cast<size_t>(height) *
+                                static_cast<size_t>(stride));
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const size_t offset =
+                static_cast<size_t>(y) * static_cast<size_t>(stride) +
+                static_cast<size_t>(x) * 4;
+            pixels[offset + 0] = static_cast<uint8_t>(x * 2);     // B
+            pixels[offset + 1] = static_cast<uint8_t>(y);         // G
+            pixels[offset + 2] = static_cast<uint8_t>(x + y * 3); // R
+            pixels[offset + 3] = 255;
+        }
+    }
+
+    AVFrame *src = av_frame_alloc();
+    ASSERT_NE(src, nullptr);
+    src->format = AV_PIX_FMT_BGRA;
+    src->width = width;
+    src->height = height;
+    src->data[0] = pixels.data();
+    src->linesize[0] = stride;
+
+    const auto convert = [&](int threads) {
+        AVFrame *dst = av_frame_alloc();
+        if (!dst)
+            throw std::runtime_error("Failed to allocate frame");
+        dst->format = AV_PIX_FMT_YUV420P;
+        dst->width = width;
+        dst->height = height;
+        if (av_frame_get_buffer(dst, 0) < 0) {
+            av_frame_free(&dst);
+            throw std::runtime_error("Failed to allocate frame buffer");
+        }
+        ffmpeg_utils::FrameConverter converter(
+            width, height, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV420P, threads);
+        converter.convert(src, dst);
+
+        // Planes without their row padding: Y, then U, then V.
+        std::vector<uint8_t> planes;
+        for (int plane = 0; plane < 3; ++plane) {
+            const int rows = plane == 0 ? height : height / 2;
+            const int cols = plane == 0 ? width : width / 2;
+            for (int y = 0; y < rows; ++y) {
+                const uint8_t *row =
+                    dst->data[plane] +
+                    static_cast<ptrdiff_t>(y) * dst->linesize[plane];
+                planes.insert(planes.end(), row, row + cols);
+            }
+        }
+        av_frame_free(&dst);
+        return planes;
+    };
+
+    std::vector<uint8_t> single;
+    std::vector<uint8_t> sliced;
+    ASSERT_NO_THROW(single = convert(1));
+    ASSERT_NO_THROW(sliced = convert(4));
+    av_frame_free(&src);
+
+    ASSERT_EQ(single.size(), sliced.size());
+    const auto mismatch =
+        std::mismatch(single.begin(), single.end(), sliced.begin());
+    EXPECT_TRUE(mismatch.first == single.end())
+        << "first differing byte at offset "
+        << std::distance(single.begin(), mismatch.first);
+}
+
+TEST(FFmpegEncoder, EncodesPackedRgbWithoutConversion) {
+    // ffv1 takes BGRA directly, so frames are wrapped rather than converted
+    // and the lossless round trip must be exact.
+    if (!avcodec_find_encoder_by_name("ffv1"))
+        GTEST_SKIP() << "ffv1 encoder not available";
+
+    const int width = 64;
+    const int height = 48;
+    const int stride = width * 4;
+
+    std::vector<uint8_t> frame(static_cast<size_t>(height) *
+                               static_cast<size_t>(stride));
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const size_t offset =
+                static_cast<size_t>(y) * static_cast<size_t>(stride) +
+                static_cast<size_t>(x) * 4;
+            frame[offset + 0] = static_cast<uint8_t>(x * 3);     // B
+            frame[offset + 1] = static_cast<uint8_t>(y * 5);     // G
+            frame[offset + 2] = static_cast<uint8_t>(x + y * 2); // R
+            frame[offset + 3] = 255;
+        }
+    }
+
+    const auto stamp =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    const std::filesystem::path tempPath =
+        std::filesystem::temp_directory_path() /
+        ("vsdf_ffmpeg_rgb_test_" + std::to_string(stamp) + ".mkv");
+    std::error_code ec;
+    std::filesystem::remove(tempPath, ec);
+
+    ffmpeg_utils::EncodeSettings settings;
+    settings.outputPath = tempPath.string();
+    settings.codec = "ffv1";
+    settings.preset = "";
+    settings.crf = -1;
+
+    ffmpeg_utils::FfmpegEncoder encoder(settings, width, height,
+                                        AV_PIX_FMT_BGRA, stride);
+    ASSERT_NO_THROW(encoder.open());
+    ASSERT_NO_THROW(encoder.encodeFrame(frame.data(), 0));
+    // The caller reuses its buffer as soon as encodeFrame returns (like a
+    // ring slot); that must not leak into the frame already sent.
+    std::fill(frame.begin(), frame.end(), uint8_t{0});
+    for (int i = 1; i < 3; ++i) {
+        ASSERT_NO_THROW(encoder.encodeFrame(frame.data(), i));
+    }
+    ASSERT_NO_THROW(encoder.flush());
+    ASSERT_NO_THROW(encoder.close());
+
+    const auto decoded =
+        ffmpeg_test_utils::decodeVideoRgb24(tempPath.string());
+    EXPECT_EQ(decoded.width, width);
+    EXPECT_EQ(decoded.height, height);
+    EXPECT_EQ(decoded.frameCount, 3);
+    ASSERT_FALSE(decoded.firstFrame.empty());
+
+    for (const auto &[x, y] : {std::pair{0, 0}, std::pair{17, 9},
+                               std::pair{width - 1, height - 1}}) {
+        const auto pixel = ffmpeg_test_utils::pixelAt(decoded, x, y);
+        EXPECT_EQ(pixel[0], static_cast<uint8_t>(x + y * 2)) << x << "," << y;
+        EXPECT_EQ(pixel[1], static_cast<uint8_t>(y * 5)) << x << "," << y;
+        EXPECT_EQ(pixel[2], static_cast<uint8_t>(x * 3)) << x << "," << y;
+    }
+
+    std::filesystem::remove(tempPath, ec);
+}
+
+namespace {
+// Solid mid-grey BGRA frame for the mux mode tests, which only care about
+// the output layout.
+std::vector<uint8_t> makeGreyFrame(int width, int height) {
+    return std::vector<uint8_t>(
+        static_cast<size_t>(width) * static_cast<size_t>(height) * 4, 128);
+}
+
+std::filesystem::path makeMuxTestDir(const std::string &name) {
+    const auto stamp =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    auto dir = std::filesystem::temp_directory_path() /
+               (name + "_" + std::to_string(stamp));
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+} // namespace
+
+TEST(FFmpegEncoder, FragmentedMp4IsPlayableWhileEncoding) {
+    const std::string encoderName = ffmpeg_test_utils::pickH264EncoderName();
+    ASSERT_FALSE(encoderName.empty()) << "No H.264 encoder available";
+
+    const int width = 64;
+    const int height = 48;
+    const auto frame = makeGreyFrame(width, height);
+    const auto dir = makeMuxTestDir("vsdf_ffmpeg_fragmented_test");
+    const auto outPath = dir / "out.mp4";
+
+    ffmpeg_utils::EncodeSettings settings;
+    settings.outputPath = outPath.string();
+    settings.codec = encoderName;
+    settings.preset = "veryfast";
+    settings.mux = ffmpeg_utils::MuxMode::Fragmented;
+    settings.segmentSeconds = 0.1f; // 3-frame fragments at 30 fps
+
+    const int frameCount = 90;
+    ffmpeg_utils::FfmpegEncoder encoder(settings, width, height,
+                                        AV_PIX_FMT_BGRA, width * 4);
+    ASSERT_NO_THROW(encoder.open());
+    for (int i = 0; i < frameCount; ++i) {
+        ASSERT_NO_THROW(encoder.encodeFrame(frame.data(), i));
+    }
+
+    // No trailer yet (as if the render was killed here), but the fragments
+    // muxed so far already decode.
+    ffmpeg_test_utils::DecodedVideo partial;
+    ASSERT_NO_THROW(partial =
+                        ffmpeg_test_utils::decodeVideoRgb24(outPath.string()));
+    EXPECT_GT(partial.frameCount, 0);
+    EXPECT_LT(partial.frameCount, frameCount);
+
+    ASSERT_NO_THROW(encoder.flush());
+    ASSERT_NO_THROW(encoder.close());
+
+    std::ifstream in(outPath, std::ios::binary);
+    const std::string bytes{std::istreambuf_iterator<char>(in),
+                            std::istreambuf_iterator<char>()};
+    const auto moov = bytes.find("moov");
+    const auto moof = bytes.find("moof");
+    ASSERT_NE(moov, std::string::npos);
+    ASSERT_NE(moof, std::string::npos);
+    EXPECT_LT(moov, moof);
+
+    const auto decoded = ffmpeg_test_utils::decodeVideoRgb24(outPath.string());
+    EXPECT_EQ(decoded.frameCount, frameCount);
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+}
+
+TEST(FFmpegEncoder, WritesHlsPlaylistAndSegments) {
+    const std::string encoderName = ffmpeg_test_utils::pickH264EncoderName();
+    ASSERT_FALSE(encoderName.empty()) << "No H.264 encoder available";
+
+    const int width = 64;
+    const int height = 48;
+    const auto frame = makeGreyFrame(width, height);
+    const auto dir = makeMuxTestDir("vsdf_ffmpeg_hls_test");
+    const auto playlistPath = dir / "out.m3u8";
+
+    ffmpeg_utils::EncodeSettings settings;
+    settings.outputPath = playlistPath.string();
+    settings.codec = encoderName;
+    settings.preset = "veryfast";
+    settings.mux = ffmpeg_utils::MuxMode::HLS;
+    settings.segmentSeconds = 0.5f;
+
+    ffmpeg_utils::FfmpegEncoder encoder(settings, width, height,
+                                        AV_PIX_FMT_BGRA, width * 4);
+    ASSERT_NO_THROW(encoder.open());
+    for (int i = 0; i < 60; ++i) {
+        ASSERT_NO_THROW(encoder.encodeFrame(frame.data(), i));
+    }
+    ASSERT_NO_THROW(encoder.flush());
+    ASSERT_NO_THROW(encoder.close());
+
+    std::ifstream in(playlistPath);
+    const std::string playlist{std::istreambuf_iterator<char>(in),
+                               std::istreambuf_iterator<char>()};
+    size_t segments = 0;
+    for (size_t pos = playlist.find("#EXTINF"); pos != std::string::npos;
+         pos = playlist.find("#EXTINF", pos + 1)) {
+        ++segments;
+    }
+    // Two seconds in half-second segments.
+    EXPECT_EQ(segments, 4u);
+    EXPECT_NE(playlist.find("#EXT-X-ENDLIST"), std::string::npos);
+    EXPECT_TRUE(std::filesystem::exists(dir / "out0.ts"));
+    EXPECT_TRUE(std::filesystem::exists(dir / "out3.ts"));
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+}
+
+TEST(FFmpegEncoder, WritesStandaloneNumberedSegments) {
+    const std::string encoderName = ffmpeg_test_utils::pickH264EncoderName();
+    ASSERT_FALSE(encoderName.empty()) << "No H.264 encoder available";
+
+    const int width = 64;
+    const int height = 48;
+    const auto frame = makeGreyFrame(width, height);
+    const auto dir = makeMuxTestDir("vsdf_ffmpeg_segments_test");
+
+    ffmpeg_utils::EncodeSettings settings;
+    settings.outputPath = (dir / "seg_%03d.mp4").string();
+    settings.codec = encoderName;
+    settings.preset = "veryfast";
+    settings.mux = ffmpeg_utils::MuxMode::Segments;
+    settings.segmentSeconds = 0.5f;
+
+    ffmpeg_utils::FfmpegEncoder encoder(settings, width, height,
+                                        AV_PIX_FMT_BGRA, width * 4);
+    ASSERT_NO_THROW(encoder.open());
+    for (int i = 0; i < 45; ++i) {
+        ASSERT_NO_THROW(encoder.encodeFrame(frame.data(), i));
+    }
+    ASSERT_NO_THROW(encoder.flush());
+    ASSERT_NO_THROW(encoder.close());
+
+    // 15-frame segments, each a complete MP4 of its own.
+    int totalFrames = 0;
+    for (const char *name : {"seg_000.mp4", "seg_001.mp4", "seg_002.mp4"}) {
+        const auto decoded =
+            ffmpeg_test_utils::decodeVideoRgb24((dir / name).string());
+        EXPECT_EQ(decoded.frameCount, 15) << name;
+        totalFrames += decoded.frameCount;
+    }
+    EXPECT_EQ(totalFrames, 45);
+    EXPECT_FALSE(std::filesystem::exists(dir / "seg_003.mp4"));
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+}
+
+TEST(FFmpegEncoder, SegmentsNeedNumberedPath) {
+    ffmpeg_utils::EncodeSettings settings;
+    settings.outputPath = "out.mp4";
+    settings.mux = ffmpeg_utils::MuxMode::Segments;
+    ffmpeg_utils::FfmpegEncoder encoder(settings, 64, 48, AV_PIX_FMT_BGRA,
+                                        64 * 4);
+    EXPECT_THROW(encoder.open(), std::runtime_error);
+}
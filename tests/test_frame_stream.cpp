@@ -0,0 +1,136 @@
+#include "frame_stream.h"
+
+#include <gtest/gtest.h>
+
+#include <csignal>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+std::vector<uint8_t> readFile(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in),
+            std::istreambuf_iterator<char>()};
+}
+
+std::vector<uint8_t> makeFrame(size_t size, uint8_t seed) {
+    std::vector<uint8_t> frame(size);
+    for (size_t i = 0; i < size; ++i)
+        frame[i] = static_cast<uint8_t>(i * 31 + seed);
+    return frame;
+}
+} // namespace
+
+TEST(FrameStream, ParsesFormatNames) {
+    EXPECT_EQ(frame_stream::parseFormat("y4m"), frame_stream::Format::Y4M);
+    EXPECT_EQ(frame_stream::parseFormat("raw"), frame_stream::Format::Raw);
+    EXPECT_FALSE(frame_stream::parseFormat("nut").has_value());
+}
+
+TEST(FrameStream, WritesY4MHeader) {
+    EXPECT_EQ(frame_stream::y4mHeader(1280, 720, 60),
+              "YUV4MPEG2 W1280 H720 F60:1 Ip A1:1 C420jpeg "
+              "XCOLORRANGE=LIMITED\n");
+}
+
+TEST(FrameStream, WritesY4MFramesToFile) {
+    const auto path =
+        std::filesystem::temp_directory_path() / "vsdf_frame_stream.y4m";
+    constexpr uint32_t width = 8;
+    constexpr uint32_t height = 2;
+    constexpr size_t frameBytes = width * height * 3 / 2;
+    const auto first = makeFrame(frameBytes, 1);
+    const auto second = makeFrame(frameBytes, 2);
+    {
+        frame_stream::FrameStreamWriter writer(
+            {.path = path.string(), .format = frame_stream::Format::Y4M},
+            width, height, 30);
+        writer.writeFrame(first.data(), first.size());
+        writer.writeFrame(second.data(), second.size());
+    }
+
+    const std::string header = frame_stream::y4mHeader(width, height, 30);
+    std::vector<uint8_t> expected(header.begin(), header.end());
+    for (const auto *frame : {&first, &second}) {
+        const std::string marker = "FRAME\n";
+        expected.insert(expected.end(), marker.begin(), marker.end());
+        expected.insert(expected.end(), frame->begin(), frame->end());
+    }
+    EXPECT_EQ(readFile(path), expected);
+    std::filesystem::remove(path);
+}
+
+#if !defined(_WIN32)
+TEST(FrameStream, ReaderGetsEveryByteThroughFifo) {
+    const auto path =
+        std::filesystem::temp_directory_path() / "vsdf_frame_stream.fifo";
+    std::filesystem::remove(path);
+    ASSERT_EQ(mkfifo(path.c_str(), 0600), 0);
+
+    // Frames bigger than the pipe buffer force partial writes.
+    constexpr size_t frameBytes = 1 << 20;
+    constexpr int frameCount = 3;
+    std::vector<uint8_t> received;
+    std::thread reader([&]() {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        ASSERT_GE(fd, 0);
+        std::vector<uint8_t> chunk(4096);
+        ssize_t got = 0;
+        while ((got = ::read(fd, chunk.data(), chunk.size())) > 0) {
+            received.insert(received.end(), chunk.begin(), chunk.begin() + got);
+        }
+        ::close(fd);
+    });
+
+    std::vector<uint8_t> expected;
+    {
+        frame_stream::FrameStreamWriter writer(
+            {.path = path.string(), .format = frame_stream::Format::Raw}, 512,
+            512, 30);
+        for (int i = 0; i < frameCount; ++i) {
+            const auto frame = makeFrame(frameBytes, static_cast<uint8_t>(i));
+            writer.writeFrame(frame.data(), frame.size());
+            expected.insert(expected.end(), frame.begin(), frame.end());
+        }
+    }
+    reader.join();
+    EXPECT_EQ(received, expected);
+    std::filesystem::remove(path);
+}
+
+TEST(FrameStream, ThrowsWhenReaderCloses) {
+    const auto path =
+        std::filesystem::temp_directory_path() / "vsdf_frame_stream_epipe";
+    std::filesystem::remove(path);
+    ASSERT_EQ(mkfifo(path.c_str(), 0600), 0);
+    // As main does for streaming, so the write fails instead of killing us.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::thread reader([&]() {
+        // Open then immediately hang up.
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        ASSERT_GE(fd, 0);
+        ::close(fd);
+    });
+    const auto frame = makeFrame(1 << 20, 0);
+    frame_stream::FrameStreamWriter writer(
+        {.path = path.string(), .format = frame_stream::Format::Raw}, 512, 512,
+        30);
+    reader.join();
+    EXPECT_THROW(writer.writeFrame(frame.data(), frame.size()),
+                 std::runtime_error);
+    std::filesystem::remove(path);
+}
+#endif
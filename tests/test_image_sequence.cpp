@@ -0,0 +1,196 @@
+#include "image_sequence.h"
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+std::filesystem::path makeTempDir(const std::string &name) {
+    auto dir = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove_all(dir);
+    return dir;
+}
+
+std::vector<uint8_t> readFile(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in),
+            std::istreambuf_iterator<char>()};
+}
+
+uint32_t readBE32(const std::vector<uint8_t> &data, size_t offset) {
+    return static_cast<uint32_t>(data[offset]) << 24 |
+           static_cast<uint32_t>(data[offset + 1]) << 16 |
+           static_cast<uint32_t>(data[offset + 2]) << 8 |
+           static_cast<uint32_t>(data[offset + 3]);
+}
+
+// Small gradient with some repeated pixels so every QOI op gets used.
+std::vector<uint8_t> makeRgba(uint32_t width, uint32_t height) {
+    std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            uint8_t *p = rgba.data() + (static_cast<size_t>(y) * width + x) * 4;
+            p[0] = static_cast<uint8_t>(x * 7);
+            p[1] = static_cast<uint8_t>(y * 3);
+            p[2] = static_cast<uint8_t>(x < width / 2 ? 0 : 200);
+            p[3] = static_cast<uint8_t>(y % 3 == 0 ? 255 : 128);
+        }
+    }
+    return rgba;
+}
+
+// Decodes the PNG written by encodePNG (single IDAT, Sub filter on every
+// row) back to RGBA, checking chunk CRCs along the way.
+std::vector<uint8_t> decodePNG(const std::vector<uint8_t> &png,
+                               uint32_t &width, uint32_t &height) {
+    std::vector<uint8_t> idat;
+    size_t pos = 8;
+    while (pos < png.size()) {
+        const uint32_t length = readBE32(png, pos);
+        const std::string type(png.begin() + static_cast<long>(pos + 4),
+                               png.begin() + static_cast<long>(pos + 8));
+        const uint8_t *data = png.data() + pos + 8;
+        const uLong crc = crc32(0, png.data() + pos + 4, length + 4);
+        EXPECT_EQ(readBE32(png, pos + 8 + length), crc) << type;
+        if (type == "IHDR") {
+            width = readBE32(png, pos + 8);
+            height = readBE32(png, pos + 12);
+        } else if (type == "IDAT") {
+            idat.insert(idat.end(), data, data + length);
+        }
+        pos += 12 + length;
+    }
+
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> filtered((rowBytes + 1) * height);
+    uLongf size = static_cast<uLongf>(filtered.size());
+    EXPECT_EQ(uncompress(filtered.data(), &size, idat.data(),
+                         static_cast<uLong>(idat.size())),
+              Z_OK);
+    std::vector<uint8_t> rgba(rowBytes * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t *src = filtered.data() + y * (rowBytes + 1);
+        EXPECT_EQ(src[0], 1); // Sub
+        uint8_t *dst = rgba.data() + y * rowBytes;
+        for (size_t i = 0; i < rowBytes; ++i) {
+            dst[i] = static_cast<uint8_t>(src[i + 1] +
+                                          (i >= 4 ? dst[i - 4] : 0));
+        }
+    }
+    return rgba;
+}
+} // namespace
+
+TEST(ImageSequence, ParsesFormatNames) {
+    EXPECT_EQ(image_sequence::parseFormat("png"), image_sequence::Format::PNG);
+    EXPECT_EQ(image_sequence::parseFormat("qoi"), image_sequence::Format::QOI);
+    EXPECT_EQ(image_sequence::parseFormat("raw"), image_sequence::Format::Raw);
+    EXPECT_FALSE(image_sequence::parseFormat("jpeg").has_value());
+}
+
+TEST(ImageSequence, NumbersFramePaths) {
+    EXPECT_EQ(image_sequence::framePath("out", 42,
+                                        image_sequence::Format::PNG),
+              std::filesystem::path("out") / "frame_000042.png");
+    EXPECT_EQ(image_sequence::framePath("out", 1234567,
+                                        image_sequence::Format::Raw),
+              std::filesystem::path("out") / "frame_1234567.rgba");
+}
+
+TEST(ImageSequence, PngRoundTrips) {
+    const auto rgba = makeRgba(37, 11);
+    std::vector<uint8_t> png;
+    image_sequence::encodePNG(rgba.data(), 37, 11, png);
+    ASSERT_GT(png.size(), 8u);
+    EXPECT_EQ(png[1], 'P');
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    EXPECT_EQ(decodePNG(png, width, height), rgba);
+    EXPECT_EQ(width, 37u);
+    EXPECT_EQ(height, 11u);
+}
+
+TEST(ImageSequence, QoiUsesRunAndDiffOps) {
+    // Two pixels equal to QOI's implicit previous pixel: one run of 2.
+    const std::vector<uint8_t> black = {0, 0, 0, 255, 0, 0, 0, 255};
+    std::vector<uint8_t> qoi;
+    image_sequence::encodeQOI(black.data(), 2, 1, qoi);
+    const std::vector<uint8_t> expected = {
+        'q', 'o', 'i', 'f', 0, 0, 0, 2, 0, 0, 0, 1, 4, 0, // header
+        0xc1,                                              // run of 2
+        0, 0, 0, 0, 0, 0, 0, 1,                            // end marker
+    };
+    EXPECT_EQ(qoi, expected);
+
+    // +1 red from the previous pixel fits QOI_OP_DIFF.
+    const std::vector<uint8_t> red = {1, 0, 0, 255};
+    image_sequence::encodeQOI(red.data(), 1, 1, qoi);
+    ASSERT_EQ(qoi.size(), 14u + 1u + 8u);
+    EXPECT_EQ(qoi[14], 0x7a);
+}
+
+TEST(ImageSequence, WriterWritesEveryFrame) {
+    const auto dir = makeTempDir("vsdf_image_sequence_test");
+    constexpr uint32_t width = 8;
+    constexpr uint32_t height = 4;
+    constexpr uint32_t stride = width * 4 + 16; // Padded rows
+    std::vector<uint8_t> bgra(static_cast<size_t>(stride) * height, 0);
+    {
+        image_sequence::ImageSequenceWriter writer(
+            {.outputDir = dir,
+             .format = image_sequence::Format::Raw,
+             .threads = 3,
+             .maxInFlight = 2},
+            width, height, true);
+        EXPECT_EQ(writer.threadCount(), 3u);
+        for (uint32_t frame = 10; frame < 20; ++frame) {
+            // B, G, R, A with the frame number in red.
+            for (uint32_t y = 0; y < height; ++y) {
+                for (uint32_t x = 0; x < width; ++x) {
+                    uint8_t *p = bgra.data() + y * stride + x * 4;
+                    p[0] = 1;
+                    p[1] = 2;
+                    p[2] = static_cast<uint8_t>(frame);
+                    p[3] = 255;
+                }
+            }
+            writer.write(bgra.data(), stride, frame);
+        }
+        writer.finish();
+    }
+
+    for (uint32_t frame = 10; frame < 20; ++frame) {
+        const auto data = readFile(
+            image_sequence::framePath(dir, frame, image_sequence::Format::Raw));
+        ASSERT_EQ(data.size(), width * height * 4);
+        EXPECT_EQ(data[0], frame);
+        EXPECT_EQ(data[1], 2);
+        EXPECT_EQ(data[2], 1);
+        EXPECT_EQ(data[3], 255);
+    }
+    EXPECT_FALSE(std::filesystem::exists(
+        image_sequence::framePath(dir, 9, image_sequence::Format::Raw)));
+    std::filesystem::remove_all(dir);
+}
+
+TEST(ImageSequence, WriterReportsWriteErrors) {
+    const auto dir = makeTempDir("vsdf_image_sequence_error_test");
+    const std::vector<uint8_t> rgba = makeRgba(4, 4);
+    image_sequence::ImageSequenceWriter writer(
+        {.outputDir = dir,
+         .format = image_sequence::Format::QOI,
+         .threads = 1,
+         .maxInFlight = 1},
+        4, 4, false);
+    // The directory vanishing mid-render makes the worker's write fail.
+    std::filesystem::remove_all(dir);
+    writer.write(rgba.data(), 16, 0);
+    EXPECT_THROW(writer.finish(), std::runtime_error);
+}
@@ -0,0 +1,141 @@
+#include "job_manifest.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<job_manifest::Job> parse(const std::string &text) {
+    std::istringstream in(text);
+    return job_manifest::parseJobs(in, "/renders", "jobs.toml");
+}
+
+std::string parseError(const std::string &text) {
+    try {
+        (void)parse(text);
+    } catch (const std::runtime_error &e) {
+        return e.what();
+    }
+    return {};
+}
+} // namespace
+
+TEST(JobManifest, DefaultsApplyToEveryJob) {
+    const auto jobs = parse(R"(
+# shared settings
+width = 1920
+height = 1080
+codec = "libx265"
+
+[[job]]
+shader = "a.frag"
+frames = 300
+output = "out/a.mp4"
+
+[[job]]
+name = "wide b"   # overrides
+shader = "/abs/b.frag"
+toy = true
+width = 3840
+frames = 10
+fps = 60
+crf = 0
+preset = "fast"
+output = "out/b.mp4"
+)");
+    ASSERT_EQ(jobs.size(), 2u);
+    EXPECT_EQ(jobs[0].name, "a.frag");
+    EXPECT_EQ(jobs[0].shader, std::filesystem::path("/renders/a.frag"));
+    EXPECT_FALSE(jobs[0].toy);
+    EXPECT_EQ(jobs[0].width, 1920u);
+    EXPECT_EQ(jobs[0].height, 1080u);
+    EXPECT_EQ(jobs[0].frames, 300u);
+    EXPECT_EQ(jobs[0].encode.codec, "libx265");
+    EXPECT_EQ(jobs[0].encode.fps, 30);
+    EXPECT_EQ(jobs[0].encode.outputPath,
+              std::filesystem::path("/renders/out/a.mp4").string());
+
+    EXPECT_EQ(jobs[1].name, "wide b");
+    EXPECT_EQ(jobs[1].shader, std::filesystem::path("/abs/b.frag"));
+    EXPECT_TRUE(jobs[1].toy);
+    EXPECT_EQ(jobs[1].width, 3840u);
+    EXPECT_EQ(jobs[1].height, 1080u);
+    EXPECT_EQ(jobs[1].encode.fps, 60);
+    EXPECT_EQ(jobs[1].encode.crf, 0);
+    EXPECT_EQ(jobs[1].encode.preset, "fast");
+    EXPECT_EQ(jobs[1].encode.codec, "libx265");
+}
+
+TEST(JobManifest, EncodeDefaultsComeFromTheCaller) {
+    // The command line's encode flags apply unless the file overrides them.
+    ffmpeg_utils::EncodeSettings cli;
+    cli.codec = "libx265";
+    cli.crf = 18;
+    cli.preset = "slow";
+    cli.fps = 24;
+    std::istringstream in("crf = 28\n"
+                          "[[job]]\n"
+                          "shader = \"a.frag\"\n"
+                          "frames = 1\n"
+                          "output = \"a.mp4\"\n"
+                          "[[job]]\n"
+                          "shader = \"b.frag\"\n"
+                          "frames = 1\n"
+                          "preset = \"fast\"\n"
+                          "output = \"b.mp4\"\n");
+    const auto jobs =
+        job_manifest::parseJobs(in, "/renders", "jobs.toml", cli);
+    ASSERT_EQ(jobs.size(), 2u);
+    EXPECT_EQ(jobs[0].encode.codec, "libx265");
+    EXPECT_EQ(jobs[0].encode.crf, 28);
+    EXPECT_EQ(jobs[0].encode.preset, "slow");
+    EXPECT_EQ(jobs[0].encode.fps, 24);
+    EXPECT_EQ(jobs[1].encode.preset, "fast");
+    EXPECT_EQ(jobs[1].encode.outputPath,
+              std::filesystem::path("/renders/b.mp4").string());
+}
+
+TEST(JobManifest, StringsKeepHashesAndEscapes) {
+    const auto jobs = parse("[[job]]\n"
+                            "shader = \"dir #1/a.frag\"\n"
+                            "name = \"say \\\"hi\\\"\"\n"
+                            "frames = 1\n"
+                            "output = \"a.mp4\"\n");
+    ASSERT_EQ(jobs.size(), 1u);
+    EXPECT_EQ(jobs[0].shader, std::filesystem::path("/renders/dir #1/a.frag"));
+    EXPECT_EQ(jobs[0].name, "say \"hi\"");
+}
+
+TEST(JobManifest, ReportsLineOfBadEntries) {
+    EXPECT_EQ(parseError("[[job]]\nshader = \"a.frag\"\nspeed = 2\n"),
+              "jobs.toml:3: unknown key speed");
+    EXPECT_EQ(parseError("[[job]]\nframes = ten\n"),
+              "jobs.toml:2: invalid value ten");
+    EXPECT_EQ(parseError("[[job]]\nframes = 0\n"),
+              "jobs.toml:2: frames must be a positive integer");
+    EXPECT_EQ(parseError("[[job]]\nshader = 3\n"),
+              "jobs.toml:2: shader must be a string");
+    EXPECT_EQ(parseError("[[job]]\nname = \"a\n"),
+              "jobs.toml:2: unterminated string");
+    EXPECT_EQ(parseError("[[job]]\nframes = 1\nframes = 2\n"),
+              "jobs.toml:3: duplicate key frames");
+    EXPECT_EQ(parseError("[jobs]\n"), "jobs.toml:1: unknown table [jobs]");
+}
+
+TEST(JobManifest, RejectsIncompleteJobs) {
+    EXPECT_EQ(parseError("width = 64\n"), "jobs.toml: no [[job]] entries");
+    EXPECT_EQ(parseError("\n[[job]]\nframes = 1\noutput = \"a.mp4\"\n"),
+              "jobs.toml:2: job has no shader");
+    EXPECT_EQ(parseError("[[job]]\nshader = \"a.frag\"\nframes = 1\n"),
+              "jobs.toml:1: job has no output");
+    EXPECT_EQ(parseError("[[job]]\nshader = \"a.frag\"\noutput = \"a.mp4\"\n"),
+              "jobs.toml:1: job has no frames");
+    EXPECT_EQ(parseError("shader = \"a.frag\"\nframes = 1\n"
+                         "output = \"same.mp4\"\n[[job]]\n[[job]]\n"),
+              "jobs.toml:5: output /renders/same.mp4 is already written by "
+              "the job on line 4");
+}
@@ -0,0 +1,35 @@
+#include "motion_blur.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+TEST(MotionBlur, SingleSampleIsUnblurred) {
+    EXPECT_EQ(motion_blur::subframeOffset(7, 0, 1, 0.5f), 0.0f);
+}
+
+TEST(MotionBlur, SamplesStayInTheirShutterStratum) {
+    const uint32_t samples = 8;
+    const float shutter = 0.5f;
+    const float stratum = shutter / samples;
+    for (uint32_t frame = 0; frame < 64; ++frame) {
+        for (uint32_t sample = 0; sample < samples; ++sample) {
+            const float offset =
+                motion_blur::subframeOffset(frame, sample, samples, shutter);
+            EXPECT_GE(offset, static_cast<float>(sample) * stratum);
+            EXPECT_LT(offset, static_cast<float>(sample + 1) * stratum);
+        }
+    }
+}
+
+TEST(MotionBlur, JitterIsDeterministicButVariesPerFrame) {
+    EXPECT_EQ(motion_blur::subframeOffset(3, 2, 4, 1.0f),
+              motion_blur::subframeOffset(3, 2, 4, 1.0f));
+    int distinct = 0;
+    const float first = motion_blur::subframeOffset(0, 1, 4, 1.0f);
+    for (uint32_t frame = 1; frame < 16; ++frame) {
+        if (motion_blur::subframeOffset(frame, 1, 4, 1.0f) != first)
+            ++distinct;
+    }
+    EXPECT_GT(distinct, 12);
+}
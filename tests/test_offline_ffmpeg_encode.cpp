@@ -1,5 +1,6 @@
 #include "test_utils.h"
 #include "ffmpeg_test_utils.h"
+#include "render_checkpoint.h"
 
 #include <gtest/gtest.h>
 
@@ -7,55 +8,51 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 }
 
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <spdlog/fmt/fmt.h>
 #include <string>
+#include <thread>
 
-TEST(OfflineFFmpegEncode, RendersAndEncodesMp4) {
-    if (shouldSkipSmokeTests()) {
-        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
-    }
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
-    const std::string encoderName = ffmpeg_test_utils::pickH264EncoderName();
-    if (encoderName.empty()) {
-        GTEST_SKIP() << "No H.264 encoder available for offline render test";
-    }
+namespace {
+constexpr uint32_t kQuadrantFrames = 10;
 
+// Runs vsdf on debug_quadrants.frag from the source dir; returns the exit
+// code and leaves the output in the log.
+int runQuadrantsRender(const std::filesystem::path &outPath,
+                       const std::filesystem::path &logPath,
+                       const std::string &encoderName,
+                       const std::string &extraArgs) {
     const auto shaderPath =
         std::filesystem::path(VSDF_SOURCE_DIR) / "shaders" /
         "debug_quadrants.frag";
 
     const auto oldCwd = std::filesystem::current_path();
     std::filesystem::current_path(VSDF_SOURCE_DIR);
-
-    const auto outPath =
-        std::filesystem::current_path() / "offline_ffmpeg_test.mp4";
-    const auto logPath =
-        std::filesystem::current_path() / "offline_ffmpeg_test.log";
-    std::error_code ec;
-    std::filesystem::remove(outPath, ec);
-    std::filesystem::remove(logPath, ec);
-
-    const uint32_t framesToRender = 10;
     const std::string cmd = fmt::format(
         "\"{}\" \"{}\" --toy --frames {} "
         "--ffmpeg-output \"{}\" --ffmpeg-codec {} --ffmpeg-fps 30 "
-        "--ffmpeg-crf 23 --ffmpeg-preset veryfast --log-level debug "
+        "--ffmpeg-crf 23 --ffmpeg-preset veryfast --log-level debug {} "
         "> \"{}\" 2>&1",
-        VSDF_BINARY_PATH, shaderPath.string(), framesToRender,
-        outPath.string(), encoderName, logPath.string());
-
+        VSDF_BINARY_PATH, shaderPath.string(), kQuadrantFrames,
+        outPath.string(), encoderName, extraArgs, logPath.string());
     const int rc = std::system(cmd.c_str());
     std::filesystem::current_path(oldCwd);
-    if (rc != 0) {
-        const std::string log = readLogFileToString(logPath);
-        std::filesystem::remove(logPath, ec);
-        FAIL() << "Command failed (" << rc << "): " << cmd
-               << "\n--- vsdf log ---\n"
-               << log;
-    }
+    return rc;
+}
 
+// Decodes outPath and checks all frames are there and the four colored
+// quadrants survived encoding.
+void checkQuadrants(const std::filesystem::path &outPath) {
     ASSERT_TRUE(std::filesystem::exists(outPath));
     ASSERT_GT(std::filesystem::file_size(outPath), 0u);
 
@@ -63,7 +60,7 @@ TEST(OfflineFFmpegEncode, RendersAndEncodesMp4) {
         ffmpeg_test_utils::decodeVideoRgb24(outPath.string());
     EXPECT_EQ(decoded.width, 1280);
     EXPECT_EQ(decoded.height, 720);
-    EXPECT_EQ(decoded.frameCount, framesToRender);
+    EXPECT_EQ(decoded.frameCount, kQuadrantFrames);
     ASSERT_FALSE(decoded.firstFrame.empty());
 
     const auto topLeft =
@@ -93,6 +90,456 @@ TEST(OfflineFFmpegEncode, RendersAndEncodesMp4) {
     EXPECT_LT(bottomRight[0], 80);
     EXPECT_LT(bottomRight[1], 80);
     EXPECT_GT(bottomRight[2], 180);
+}
 
+// Renders debug_quadrants.frag through the offline path and checks the
+// four colored quadrants survive encoding.
+void renderAndCheckQuadrants(const std::string &outName,
+                             const std::string &extraArgs) {
+    const std::string encoderName = ffmpeg_test_utils::pickH264EncoderName();
+    if (encoderName.empty()) {
+        GTEST_SKIP() << "No H.264 encoder available for offline render test";
+    }
+
+    const auto outPath =
+        std::filesystem::path(VSDF_SOURCE_DIR) / (outName + ".mp4");
+    const auto logPath =
+        std::filesystem::path(VSDF_SOURCE_DIR) / (outName + ".log");
+    std::error_code ec;
     std::filesystem::remove(outPath, ec);
+    std::filesystem::remove(logPath, ec);
+
+    const int rc = runQuadrantsRender(outPath, logPath, encoderName, extraArgs);
+    if (rc != 0) {
+        const std::string log = readLogFileToString(logPath);
+        std::filesystem::remove(logPath, ec);
+        FAIL() << "vsdf failed (" << rc << ") with args: " << extraArgs
+               << "\n--- vsdf log ---\n"
+               << log;
+    }
+
+    checkQuadrants(outPath);
+    std::filesystem::remove(outPath, ec);
+}
+} // namespace
+
+TEST(OfflineFFmpegEncode, RendersAndEncodesMp4) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    renderAndCheckQuadrants("offline_ffmpeg_test", "");
+}
+
+TEST(OfflineFFmpegEncode, RendersWithGpuYuvConversion) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    renderAndCheckQuadrants("offline_ffmpeg_gpu_yuv420p_test",
+                            "--ffmpeg-gpu-convert yuv420p");
+    renderAndCheckQuadrants("offline_ffmpeg_gpu_nv12_test",
+                            "--ffmpeg-gpu-convert nv12");
+}
+
+TEST(OfflineFFmpegEncode, RendersInTiles) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    // 300 doesn't divide 1280x720, so edge tiles are clipped.
+    renderAndCheckQuadrants("offline_ffmpeg_tiled_test",
+                            "--ffmpeg-tile-size 300");
+}
+
+TEST(OfflineFFmpegEncode, RendersInShards) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    // 10 frames over 3 workers: uneven shards of 4, 3 and 3 frames.
+    renderAndCheckQuadrants("offline_ffmpeg_sharded_test",
+                            "--ffmpeg-shards 3");
+}
+
+TEST(OfflineFFmpegEncode, RendersCheckpointedSegments) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    // 10 frames in segments of 4: two full segments and a short last one,
+    // joined into the output at the end.
+    renderAndCheckQuadrants("offline_ffmpeg_checkpoint_test",
+                            "--ffmpeg-checkpoint 4");
+    EXPECT_FALSE(std::filesystem::exists(
+        std::filesystem::path(VSDF_SOURCE_DIR) /
+        "offline_ffmpeg_checkpoint_test.mp4.checkpoint"));
+}
+
+TEST(OfflineFFmpegEncode, ResumesInterruptedCheckpointedRender) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    const std::string encoderName = ffmpeg_test_utils::pickH264EncoderName();
+    if (encoderName.empty()) {
+        GTEST_SKIP() << "No H.264 encoder available for offline render test";
+    }
+
+    const auto dir = std::filesystem::path(VSDF_SOURCE_DIR);
+    const auto outPath = dir / "offline_ffmpeg_resume_test.mp4";
+    const auto logPath = dir / "offline_ffmpeg_resume_test.log";
+    const auto manifestPath =
+        render_checkpoint::manifestPath(outPath);
+    std::error_code ec;
+    std::filesystem::remove_all(outPath, ec);
+    std::filesystem::remove(manifestPath, ec);
+
+    // A directory in the way of the output makes the final join fail, so
+    // the first run exits with its segments and manifest still on disk.
+    std::filesystem::create_directory(outPath);
+    EXPECT_NE(runQuadrantsRender(outPath, logPath, encoderName,
+                                 "--ffmpeg-checkpoint 4"),
+              0);
+    std::filesystem::remove(outPath, ec);
+    const auto saved = render_checkpoint::readManifest(manifestPath);
+    ASSERT_TRUE(saved.has_value()) << readLogFileToString(logPath);
+    ASSERT_EQ(saved->segments.size(), 3u);
+
+    // Roll the manifest back to what a kill after the first segment
+    // leaves: one segment muxed, frames [4, 10) still to render.
+    render_checkpoint::Manifest interrupted = *saved;
+    interrupted.nextFrame = 4;
+    interrupted.segments.resize(1);
+    for (size_t i = 1; i < saved->segments.size(); ++i)
+        std::filesystem::remove(saved->segments[i], ec);
+    render_checkpoint::writeManifest(manifestPath, interrupted);
+
+    const int rc = runQuadrantsRender(outPath, logPath, encoderName,
+                                      "--ffmpeg-checkpoint 4 --resume");
+    const std::string log = readLogFileToString(logPath);
+    ASSERT_EQ(rc, 0) << log;
+    EXPECT_NE(log.find("Resuming at frame 4"), std::string::npos) << log;
+
+    checkQuadrants(outPath);
+    EXPECT_FALSE(std::filesystem::exists(manifestPath));
+    for (const std::string &segment : saved->segments)
+        EXPECT_FALSE(std::filesystem::exists(segment)) << segment;
+    std::filesystem::remove(outPath, ec);
+    std::filesystem::remove(logPath, ec);
+}
+
+TEST(OfflineFFmpegEncode, RendersWithMotionBlur) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    // The quadrants are static, so averaging sub-frames must not change
+    // them; this checks the accumulate + resolve path end to end.
+    renderAndCheckQuadrants("offline_ffmpeg_motion_blur_test",
+                            "--ffmpeg-motion-blur 4");
+}
+
+TEST(OfflineFFmpegEncode, RendersWithSupersampling) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    // The shader sees a 2x frame, so the quadrants only land in the right
+    // place if iResolution and the downsample agree.
+    renderAndCheckQuadrants("offline_ffmpeg_ssaa_test", "--ssaa 2");
+}
+
+TEST(OfflineFFmpegEncode, RendersLayeredFrames) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    // 10 frames in slots of 4 layers leaves a partly used last slot; every
+    // layer has to reach the encoder in order for the frame count to match.
+    renderAndCheckQuadrants("offline_ffmpeg_layers_test",
+                            "--ffmpeg-frame-layers 4");
+}
+
+TEST(OfflineFFmpegEncode, RendersWithFixedSubmitBatch) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    // 10 frames in batches of 3 leaves a short last batch.
+    renderAndCheckQuadrants("offline_ffmpeg_submit_batch_test",
+                            "--ffmpeg-ring-buffer-size 4 "
+                            "--ffmpeg-submit-batch 3");
+}
+
+TEST(OfflineFFmpegEncode, WritesRawImageSequence) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    const auto shaderPath =
+        std::filesystem::path(VSDF_SOURCE_DIR) / "shaders" /
+        "debug_quadrants.frag";
+    const auto outDir =
+        std::filesystem::path(VSDF_SOURCE_DIR) / "offline_image_sequence_test";
+    std::error_code ec;
+    std::filesystem::remove_all(outDir, ec);
+
+    const std::string cmd = fmt::format(
+        "\"{}\" \"{}\" --toy --frames 3 --image-output \"{}\" "
+        "--image-format raw --ffmpeg-width 64 --ffmpeg-height 32 "
+        "--log-level debug",
+        VSDF_BINARY_PATH, shaderPath.string(), outDir.string());
+    ASSERT_EQ(std::system(cmd.c_str()), 0) << cmd;
+
+    for (int frame = 0; frame < 3; ++frame) {
+        const auto path = outDir / fmt::format("frame_{:06}.rgba", frame);
+        ASSERT_TRUE(std::filesystem::exists(path)) << path;
+        EXPECT_EQ(std::filesystem::file_size(path), 64u * 32u * 4u);
+    }
+    // Top-left quadrant is red; pixel (16, 8) in RGBA.
+    std::ifstream in(outDir / "frame_000000.rgba", std::ios::binary);
+    in.seekg((8 * 64 + 16) * 4);
+    char rgba[4] = {};
+    in.read(rgba, 4);
+    EXPECT_GT(static_cast<unsigned char>(rgba[0]), 180);
+    EXPECT_LT(static_cast<unsigned char>(rgba[1]), 80);
+    EXPECT_LT(static_cast<unsigned char>(rgba[2]), 80);
+    in.close();
+    std::filesystem::remove_all(outDir, ec);
+}
+
+TEST(OfflineFFmpegEncode, StreamsY4MToStdout) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    const auto shaderPath =
+        std::filesystem::path(VSDF_SOURCE_DIR) / "shaders" /
+        "debug_quadrants.frag";
+    const auto outPath =
+        std::filesystem::path(VSDF_SOURCE_DIR) / "offline_stream_test.y4m";
+    std::error_code ec;
+    std::filesystem::remove(outPath, ec);
+
+    // Logs go to stderr, so stdout must hold nothing but the stream.
+    const std::string cmd = fmt::format(
+        "\"{}\" \"{}\" --toy --frames 3 --stream-output - "
+        "--ffmpeg-width 64 --ffmpeg-height 32 --log-level debug > \"{}\"",
+        VSDF_BINARY_PATH, shaderPath.string(), outPath.string());
+    ASSERT_EQ(std::system(cmd.c_str()), 0) << cmd;
+
+    const std::string header =
+        "YUV4MPEG2 W64 H32 F30:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n";
+    const size_t frameBytes = 6 + 64 * 32 * 3 / 2;
+    ASSERT_EQ(std::filesystem::file_size(outPath),
+              header.size() + 3 * frameBytes);
+    std::ifstream in(outPath, std::ios::binary);
+    std::string gotHeader(header.size(), '\0');
+    in.read(gotHeader.data(), static_cast<std::streamsize>(header.size()));
+    EXPECT_EQ(gotHeader, header);
+    // Top-left quadrant is red: BT.601 limited-range luma of about 82.
+    in.seekg(static_cast<std::streamoff>(header.size() + 6 + 8 * 64 + 16));
+    char luma = 0;
+    in.read(&luma, 1);
+    EXPECT_NEAR(static_cast<unsigned char>(luma), 82, 12);
+    in.close();
+    std::filesystem::remove(outPath, ec);
+}
+
+TEST(OfflineFFmpegEncode, WritesStageProfile) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    const auto profilePath =
+        std::filesystem::path(VSDF_SOURCE_DIR) / "offline_profile_test.csv";
+    std::error_code ec;
+    std::filesystem::remove(profilePath, ec);
+
+    renderAndCheckQuadrants("offline_ffmpeg_profile_test",
+                            "--profile-output \"" + profilePath.string() +
+                                "\"");
+
+    // Header plus one row per frame.
+    std::ifstream in(profilePath);
+    std::string line;
+    int lines = 0;
+    while (std::getline(in, line))
+        ++lines;
+    EXPECT_EQ(lines, 11);
+    in.close();
+    std::filesystem::remove(profilePath, ec);
+}
+
+TEST(OfflineFFmpegEncode, RendersJobFile) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    const std::string encoderName = ffmpeg_test_utils::pickH264EncoderName();
+    if (encoderName.empty()) {
+        GTEST_SKIP() << "No H.264 encoder available for offline render test";
+    }
+    const auto dir =
+        std::filesystem::path(VSDF_SOURCE_DIR) / "offline_jobs_test";
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    std::filesystem::create_directories(dir);
+    {
+        std::ofstream broken(dir / "broken.frag");
+        broken << "void mainImage(out vec4 c, in vec2 p) { c = nope; }\n";
+    }
+    const auto jobPath = dir / "jobs.toml";
+    {
+        std::ofstream jobs(jobPath);
+        jobs << fmt::format("codec = \"{}\"\npreset = \"veryfast\"\n"
+                            "toy = true\n",
+                            encoderName);
+        jobs << "[[job]]\nshader = \"../shaders/debug_quadrants.frag\"\n"
+                "width = 256\nheight = 128\nframes = 5\noutput = \"a.mp4\"\n";
+        jobs << "[[job]]\nshader = \"broken.frag\"\nframes = 5\n"
+                "output = \"broken.mp4\"\n";
+        // Compiles, but its encoder can't open the output.
+        jobs << "[[job]]\nshader = \"../shaders/debug_quadrants.frag\"\n"
+                "frames = 3\noutput = \"missing/unwritable.mp4\"\n";
+        jobs << "[[job]]\nshader = \"../shaders/debug_quadrants.frag\"\n"
+                "width = 128\nheight = 64\nframes = 3\noutput = \"b.mp4\"\n";
+    }
+
+    // The broken jobs fail the run but not the jobs around them.
+    const std::string cmd =
+        fmt::format("\"{}\" --jobs \"{}\" --log-level debug", VSDF_BINARY_PATH,
+                    jobPath.string());
+    EXPECT_NE(std::system(cmd.c_str()), 0) << cmd;
+
+    const auto first = ffmpeg_test_utils::decodeVideoRgb24(
+        (dir / "a.mp4").string());
+    EXPECT_EQ(first.width, 256);
+    EXPECT_EQ(first.height, 128);
+    EXPECT_EQ(first.frameCount, 5);
+    const auto second = ffmpeg_test_utils::decodeVideoRgb24(
+        (dir / "b.mp4").string());
+    EXPECT_EQ(second.width, 128);
+    EXPECT_EQ(second.frameCount, 3);
+    EXPECT_FALSE(std::filesystem::exists(dir / "broken.mp4"));
+    std::filesystem::remove_all(dir, ec);
+}
+
+#if !defined(_WIN32)
+namespace {
+// Sends one request to the daemon and returns its reply line; empty if
+// the daemon isn't listening.
+std::string daemonRequest(const std::filesystem::path &socketPath,
+                          const std::string &request) {
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return {};
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socketPath.c_str(),
+                 sizeof(addr.sun_path) - 1);
+    std::string reply;
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(&addr),
+                  sizeof(addr)) == 0 &&
+        ::write(fd, request.data(), request.size()) ==
+            static_cast<ssize_t>(request.size())) {
+        ::shutdown(fd, SHUT_WR);
+        char buf[512];
+        ssize_t got = 0;
+        while ((got = ::read(fd, buf, sizeof(buf))) > 0)
+            reply.append(buf, static_cast<size_t>(got));
+    }
+    ::close(fd);
+    return reply;
+}
+} // namespace
+
+TEST(OfflineFFmpegEncode, DaemonServesWarmRequests) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    const auto shaderPath =
+        std::filesystem::path(VSDF_SOURCE_DIR) / "shaders" /
+        "debug_quadrants.frag";
+    const auto dir = std::filesystem::temp_directory_path() / "vsdf_daemon";
+    const auto socketPath = dir / "vsdf.sock";
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    std::filesystem::create_directories(dir);
+
+    std::thread daemon([&]() {
+        const std::string cmd = fmt::format(
+            "\"{}\" --daemon \"{}\" --log-level debug > \"{}\" 2>&1",
+            VSDF_BINARY_PATH, socketPath.string(),
+            (dir / "daemon.log").string());
+        EXPECT_EQ(std::system(cmd.c_str()), 0) << cmd;
+    });
+    // Wait for the device to come up and the socket to appear.
+    for (int i = 0; i < 200 && !std::filesystem::exists(socketPath); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    const auto request = [&](const std::string &name) {
+        return fmt::format("shader {}\ntoy 1\nwidth 64\nheight 32\n"
+                           "times 0 0.5\noutput {}\nformat raw\n\n",
+                           shaderPath.string(), (dir / name).string());
+    };
+    const std::string cold = daemonRequest(socketPath, request("cold"));
+    const std::string warm = daemonRequest(socketPath, request("warm"));
+    const std::string bad = daemonRequest(
+        socketPath, "shader relative.frag\ntimes 0\noutput /tmp\n\n");
+    EXPECT_EQ(daemonRequest(socketPath, "shutdown\n"), "ok shutdown\n");
+    daemon.join();
+
+    EXPECT_EQ(cold.rfind("ok frames=2 ", 0), 0u) << cold;
+    EXPECT_NE(cold.find("warm=0"), std::string::npos) << cold;
+    EXPECT_EQ(warm.rfind("ok frames=2 ", 0), 0u) << warm;
+    EXPECT_NE(warm.find("warm=1"), std::string::npos) << warm;
+    EXPECT_EQ(bad.rfind("error ", 0), 0u) << bad;
+    for (const char *name : {"cold", "warm"}) {
+        for (int frame = 0; frame < 2; ++frame) {
+            const auto path =
+                dir / name / fmt::format("frame_{:06}.rgba", frame);
+            ASSERT_TRUE(std::filesystem::exists(path)) << path;
+            EXPECT_EQ(std::filesystem::file_size(path), 64u * 32u * 4u);
+        }
+    }
+    EXPECT_FALSE(std::filesystem::exists(socketPath));
+    std::filesystem::remove_all(dir, ec);
+}
+
+TEST(OfflineFFmpegEncode, DaemonSurvivesFailedRender) {
+    if (shouldSkipSmokeTests()) {
+        GTEST_SKIP() << "Offline FFmpeg test is skipped in CI unless VSDF_SMOKE_TESTS=1";
+    }
+    const auto shaderPath =
+        std::filesystem::path(VSDF_SOURCE_DIR) / "shaders" /
+        "debug_quadrants.frag";
+    const auto dir =
+        std::filesystem::temp_directory_path() / "vsdf_daemon_failure";
+    const auto socketPath = dir / "vsdf.sock";
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    // A directory where the first frame's temp file goes makes the image
+    // writer throw mid-render, after the renderer and its encoder thread
+    // are up.
+    std::filesystem::create_directories(dir / "broken" /
+                                        "frame_000000.rgba.tmp");
+
+    std::thread daemon([&]() {
+        const std::string cmd = fmt::format(
+            "\"{}\" --daemon \"{}\" --log-level debug > \"{}\" 2>&1",
+            VSDF_BINARY_PATH, socketPath.string(),
+            (dir / "daemon.log").string());
+        EXPECT_EQ(std::system(cmd.c_str()), 0) << cmd;
+    });
+    for (int i = 0; i < 200 && !std::filesystem::exists(socketPath); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    const auto request = [&](const std::string &name) {
+        return fmt::format("shader {}\ntoy 1\nwidth 64\nheight 32\n"
+                           "times 0 0.5\noutput {}\nformat raw\n\n",
+                           shaderPath.string(), (dir / name).string());
+    };
+    const std::string failed = daemonRequest(socketPath, request("broken"));
+    const std::string next = daemonRequest(socketPath, request("next"));
+    EXPECT_EQ(daemonRequest(socketPath, "shutdown\n"), "ok shutdown\n");
+    daemon.join();
+
+    EXPECT_EQ(failed.rfind("error ", 0), 0u) << failed;
+    EXPECT_EQ(next.rfind("ok frames=2 ", 0), 0u)
+        << next << readLogFileToString(dir / "daemon.log");
+    for (int frame = 0; frame < 2; ++frame) {
+        const auto path = dir / "next" / fmt::format("frame_{:06}.rgba", frame);
+        ASSERT_TRUE(std::filesystem::exists(path)) << path;
+        EXPECT_EQ(std::filesystem::file_size(path), 64u * 32u * 4u);
+    }
+    std::filesystem::remove_all(dir, ec);
 }
+#endif
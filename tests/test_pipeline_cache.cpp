@@ -0,0 +1,123 @@
+#include "pipeline_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+std::filesystem::path tempDir(const std::string &name) {
+    const auto stamp =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    return std::filesystem::temp_directory_path() /
+           ("vsdf_" + name + "_" + std::to_string(stamp));
+}
+
+pipeline_cache::DeviceKey sampleKey() {
+    pipeline_cache::DeviceKey key;
+    key.vendorID = 0x10de;
+    key.deviceID = 0x2684;
+    key.driverVersion = 0x89a4c000;
+    for (size_t i = 0; i < key.uuid.size(); ++i)
+        key.uuid[i] = static_cast<uint8_t>(i * 17);
+    return key;
+}
+
+void putU32(std::vector<uint8_t> &blob, size_t offset, uint32_t value) {
+    std::memcpy(blob.data() + offset, &value, sizeof(value));
+}
+
+// A header as the driver would write it, followed by some payload.
+std::vector<uint8_t> sampleBlob(const pipeline_cache::DeviceKey &key) {
+    std::vector<uint8_t> blob(32 + 64, 0xab);
+    putU32(blob, 0, 32);
+    putU32(blob, 4, 1);
+    putU32(blob, 8, key.vendorID);
+    putU32(blob, 12, key.deviceID);
+    std::memcpy(blob.data() + 16, key.uuid.data(), key.uuid.size());
+    return blob;
+}
+} // namespace
+
+TEST(PipelineCache, PathIdentifiesDeviceAndDriver) {
+    const auto key = sampleKey();
+    EXPECT_EQ(pipeline_cache::cachePath("cache", key).filename().string(),
+              "pipeline_10de_2684_89a4c000_"
+              "00112233445566778899aabbccddeeff.bin");
+    auto newerDriver = key;
+    newerDriver.driverVersion += 1;
+    EXPECT_NE(pipeline_cache::cachePath("cache", key),
+              pipeline_cache::cachePath("cache", newerDriver));
+}
+
+TEST(PipelineCache, HeaderMustMatchDevice) {
+    const auto key = sampleKey();
+    const auto blob = sampleBlob(key);
+    EXPECT_TRUE(pipeline_cache::headerMatches(blob, key));
+
+    auto otherDevice = key;
+    otherDevice.deviceID += 1;
+    EXPECT_FALSE(pipeline_cache::headerMatches(blob, otherDevice));
+    auto otherUuid = key;
+    otherUuid.uuid[15] ^= 1;
+    EXPECT_FALSE(pipeline_cache::headerMatches(blob, otherUuid));
+
+    auto badVersion = blob;
+    putU32(badVersion, 4, 2);
+    EXPECT_FALSE(pipeline_cache::headerMatches(badVersion, key));
+    auto badSize = blob;
+    putU32(badSize, 0, 4096);
+    EXPECT_FALSE(pipeline_cache::headerMatches(badSize, key));
+    EXPECT_FALSE(pipeline_cache::headerMatches(
+        std::vector<uint8_t>(blob.begin(), blob.begin() + 20), key));
+}
+
+TEST(PipelineCache, SaveAndLoadRoundTrip) {
+    const auto dir = tempDir("pipeline_cache");
+    const auto key = sampleKey();
+    const auto path = pipeline_cache::cachePath(dir / "nested", key);
+    EXPECT_TRUE(pipeline_cache::load(path, key).empty());
+
+    const auto blob = sampleBlob(key);
+    pipeline_cache::saveAtomic(path, blob);
+    EXPECT_EQ(pipeline_cache::load(path, key), blob);
+    // Only the final file is left behind.
+    size_t files = 0;
+    for ([[maybe_unused]] const auto &entry :
+         std::filesystem::directory_iterator(path.parent_path()))
+        ++files;
+    EXPECT_EQ(files, 1u);
+
+    // A blob from another device or a truncated file is a cold start.
+    auto otherDevice = key;
+    otherDevice.vendorID = 0x1002;
+    EXPECT_TRUE(pipeline_cache::load(path, otherDevice).empty());
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "junk";
+    }
+    EXPECT_TRUE(pipeline_cache::load(path, key).empty());
+    std::filesystem::remove_all(dir);
+}
+
+TEST(PipelineCache, FailedSaveLeavesNoTempFile) {
+    const auto dir = tempDir("pipeline_cache_rename");
+    const auto key = sampleKey();
+    const auto path = pipeline_cache::cachePath(dir, key);
+    // A non-empty directory where the cache file goes can't be replaced.
+    std::filesystem::create_directories(path / "occupied");
+
+    EXPECT_THROW(pipeline_cache::saveAtomic(path, sampleBlob(key)),
+                 std::runtime_error);
+    size_t files = 0;
+    for ([[maybe_unused]] const auto &entry :
+         std::filesystem::directory_iterator(dir))
+        ++files;
+    EXPECT_EQ(files, 1u);
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,21 @@
+#include "reload_hitch.h"
+
+#include <gtest/gtest.h>
+
+TEST(ReloadHitchMeter, ReportsLongestFrameAgainstMedian) {
+    ReloadHitchMeter meter(3, 8);
+    for (double ms : {16.0, 17.0, 16.5, 40.0, 16.0})
+        meter.frame(ms);
+    EXPECT_FALSE(meter.takeReport().has_value());
+
+    meter.reloaded();
+    meter.frame(21.0);
+    meter.frame(16.0);
+    EXPECT_FALSE(meter.takeReport().has_value());
+    meter.frame(18.0);
+    const auto report = meter.takeReport();
+    ASSERT_TRUE(report.has_value());
+    EXPECT_DOUBLE_EQ(report->longestMs, 21.0);
+    EXPECT_DOUBLE_EQ(report->typicalMs, 16.5);
+    EXPECT_FALSE(meter.takeReport().has_value());
+}
@@ -0,0 +1,122 @@
+#include "render_checkpoint.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+std::filesystem::path tempPath(const std::string &name) {
+    const auto stamp =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    return std::filesystem::temp_directory_path() /
+           ("vsdf_" + name + "_" + std::to_string(stamp));
+}
+
+render_checkpoint::Manifest sampleManifest() {
+    return render_checkpoint::Manifest{
+        .shaderHash = "0123456789abcdef",
+        .settings = "1280x720 fps=30 codec=libx264 crf=20 preset=slow",
+        .frameStart = 0,
+        .frameEnd = 100,
+        .segmentFrames = 30,
+        .nextFrame = 0,
+        .segments = {},
+    };
+}
+} // namespace
+
+TEST(RenderCheckpoint, ManifestRoundTrips) {
+    const auto path = tempPath("checkpoint_roundtrip");
+    auto manifest = sampleManifest();
+    manifest.nextFrame = 60;
+    manifest.segments = {"out.part0.mp4", "dir with space/out.part1.mp4"};
+
+    render_checkpoint::writeManifest(path, manifest);
+    const auto loaded = render_checkpoint::readManifest(path);
+    ASSERT_TRUE(loaded.has_value());
+    EXPECT_EQ(loaded->shaderHash, manifest.shaderHash);
+    EXPECT_EQ(loaded->settings, manifest.settings);
+    EXPECT_EQ(loaded->frameStart, 0u);
+    EXPECT_EQ(loaded->frameEnd, 100u);
+    EXPECT_EQ(loaded->segmentFrames, 30u);
+    EXPECT_EQ(loaded->nextFrame, 60u);
+    EXPECT_EQ(loaded->segments, manifest.segments);
+
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    EXPECT_FALSE(std::filesystem::exists(tmp));
+    std::filesystem::remove(path);
+}
+
+TEST(RenderCheckpoint, MissingManifestIsNotAnError) {
+    EXPECT_FALSE(
+        render_checkpoint::readManifest(tempPath("checkpoint_missing")));
+}
+
+TEST(RenderCheckpoint, RejectsMalformedManifest) {
+    const auto path = tempPath("checkpoint_malformed");
+    {
+        std::ofstream out(path);
+        out << "vsdf-checkpoint 1\nnext_frame lots\n";
+    }
+    EXPECT_THROW((void)render_checkpoint::readManifest(path),
+                 std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(RenderCheckpoint, ResumeRequiresSameRender) {
+    const auto expected = sampleManifest();
+    auto saved = sampleManifest();
+    saved.nextFrame = 30;
+    EXPECT_NO_THROW(render_checkpoint::validateResume(saved, expected));
+
+    auto otherShader = saved;
+    otherShader.shaderHash = "fedcba9876543210";
+    EXPECT_THROW(render_checkpoint::validateResume(otherShader, expected),
+                 std::runtime_error);
+
+    auto otherSettings = saved;
+    otherSettings.settings += " toy=true";
+    EXPECT_THROW(render_checkpoint::validateResume(otherSettings, expected),
+                 std::runtime_error);
+
+    auto otherRange = saved;
+    otherRange.frameEnd = 120;
+    EXPECT_THROW(render_checkpoint::validateResume(otherRange, expected),
+                 std::runtime_error);
+
+    auto missingSegment = saved;
+    missingSegment.segments = {tempPath("checkpoint_gone").string()};
+    EXPECT_THROW(render_checkpoint::validateResume(missingSegment, expected),
+                 std::runtime_error);
+}
+
+TEST(RenderCheckpoint, HashTracksFileContents) {
+    const auto path = tempPath("checkpoint_hash");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "void main() {}\n";
+    }
+    const std::string first = render_checkpoint::hashFile(path);
+    EXPECT_EQ(first.size(), 16u);
+    EXPECT_EQ(render_checkpoint::hashFile(path), first);
+    EXPECT_EQ(render_checkpoint::hashContents("void main() {}\n"), first);
+    {
+        std::ofstream out(path, std::ios::app);
+        out << "// edit\n";
+    }
+    EXPECT_NE(render_checkpoint::hashFile(path), first);
+    std::filesystem::remove(path);
+}
+
+TEST(RenderCheckpoint, SegmentPathsSitNextToOutput) {
+    const auto output = std::filesystem::path("renders") / "clip.mkv";
+    EXPECT_EQ(render_checkpoint::segmentPath(output, 3),
+              std::filesystem::path("renders") / "clip.part3.mkv");
+    EXPECT_EQ(render_checkpoint::manifestPath(output),
+              std::filesystem::path("renders") / "clip.mkv.checkpoint");
+}
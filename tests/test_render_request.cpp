@@ -0,0 +1,74 @@
+#include "render_request.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+render_request::Request parse(const std::string &text) {
+    std::istringstream in(text);
+    return render_request::parseRequest(in);
+}
+
+#if defined(_WIN32)
+const std::string kRoot = "C:/";
+#else
+const std::string kRoot = "/";
+#endif
+} // namespace
+
+TEST(RenderRequest, ParsesRequestUpToBlankLine) {
+    const auto request =
+        parse("shader " + kRoot + "shaders/a.frag\n"
+              "toy 1\n"
+              "width 320\n"
+              "height 180\n"
+              "times 0 1.5  3\n"
+              "output " + kRoot + "out dir\n"
+              "format qoi\n"
+              "\n"
+              "unknown trailing junk\n");
+    EXPECT_FALSE(request.shutdown);
+    EXPECT_EQ(request.shader, std::filesystem::path(kRoot + "shaders/a.frag"));
+    EXPECT_TRUE(request.toy);
+    EXPECT_EQ(request.width, 320u);
+    EXPECT_EQ(request.height, 180u);
+    ASSERT_EQ(request.times.size(), 3u);
+    EXPECT_FLOAT_EQ(request.times[1], 1.5f);
+    EXPECT_EQ(request.output, std::filesystem::path(kRoot + "out dir"));
+    EXPECT_EQ(request.format, image_sequence::Format::QOI);
+}
+
+TEST(RenderRequest, ParsesShutdown) {
+    EXPECT_TRUE(parse("shutdown\n").shutdown);
+}
+
+TEST(RenderRequest, RejectsBadRequests) {
+    const std::string shader = "shader " + kRoot + "a.frag\n";
+    const std::string output = "output " + kRoot + "out\n";
+    EXPECT_THROW(parse(""), std::runtime_error);
+    EXPECT_THROW(parse("shader a.frag\n"), std::runtime_error);
+    EXPECT_THROW(parse(shader + output), std::runtime_error);
+    EXPECT_THROW(parse(shader + "times 1\n"), std::runtime_error);
+    EXPECT_THROW(parse(shader + output + "times 1 x\n"), std::runtime_error);
+    EXPECT_THROW(parse(shader + output + "times 1\nwidth 0\n"),
+                 std::runtime_error);
+    EXPECT_THROW(parse(shader + output + "times 1\nheight 4294967295\n"),
+                 std::runtime_error);
+    EXPECT_THROW(parse(shader + output + "times 1\nwidth 16385\n"),
+                 std::runtime_error);
+    EXPECT_THROW(parse(shader + output + "times 1\nspeed 2\n"),
+                 std::runtime_error);
+    EXPECT_THROW(parse(shader + output + "times 1\nformat gif\n"),
+                 std::runtime_error);
+}
+
+TEST(RenderRequest, FormatsReplies) {
+    EXPECT_EQ(render_request::okReply(3, {41.2, 12.8, 28.4}, true),
+              "ok frames=3 ms=41.20 setup_ms=12.80 render_ms=28.40 warm=1\n");
+    EXPECT_EQ(render_request::errorReply("bad\nshader"),
+              "error bad shader\n");
+}
@@ -0,0 +1,121 @@
+#include "ffmpeg_encode_settings.h"
+#include "ffmpeg_encoder.h"
+#include "ffmpeg_test_utils.h"
+#include "ffmpeg_utils.h"
+#include "render_shards.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+std::filesystem::path tempVideoPath(const std::string &name) {
+    const auto stamp =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    return std::filesystem::temp_directory_path() /
+           ("vsdf_" + name + "_" + std::to_string(stamp) + ".mp4");
+}
+} // namespace
+
+TEST(RenderShards, SplitsIntoContiguousBalancedRanges) {
+    const auto ranges = render_shards::splitFrameRange({5, 15}, 3);
+    ASSERT_EQ(ranges.size(), 3u);
+    EXPECT_EQ(ranges[0].start, 5u);
+    EXPECT_EQ(ranges[0].end, 9u);
+    EXPECT_EQ(ranges[1].start, 9u);
+    EXPECT_EQ(ranges[1].end, 12u);
+    EXPECT_EQ(ranges[2].start, 12u);
+    EXPECT_EQ(ranges[2].end, 15u);
+}
+
+TEST(RenderShards, NeverProducesEmptyShards) {
+    const auto ranges = render_shards::splitFrameRange({0, 2}, 8);
+    ASSERT_EQ(ranges.size(), 2u);
+    EXPECT_EQ(ranges[0].end - ranges[0].start, 1u);
+    EXPECT_EQ(ranges[1].end - ranges[1].start, 1u);
+
+    EXPECT_THROW((void)render_shards::splitFrameRange({4, 4}, 2),
+                 std::runtime_error);
+}
+
+TEST(RenderShards, SegmentPathKeepsExtension) {
+    const auto segment =
+        render_shards::segmentPath(std::filesystem::path("out") / "a.mp4", 2);
+    EXPECT_EQ(segment, std::filesystem::path("out") / "a.shard2.mp4");
+}
+
+TEST(RenderShards, WorkerArgsReplaceRangeAndOutput) {
+    const std::vector<std::string> args = {
+        "shader.frag",     "--toy",   "--frames",        "100",
+        "--frame-start",   "10",      "--ffmpeg-output", "out.mp4",
+        "--ffmpeg-shards", "4",       "--ffmpeg-fps",    "60",
+    };
+    const auto worker =
+        render_shards::workerArgs(args, {10, 32}, "out.shard0.mp4");
+    const std::vector<std::string> expected = {
+        "shader.frag", "--toy",           "--frames",       "100",
+        "--ffmpeg-fps", "60",             "--frame-start",  "10",
+        "--frame-end", "32",              "--ffmpeg-output", "out.shard0.mp4",
+    };
+    EXPECT_EQ(worker, expected);
+}
+
+TEST(RenderShards, ConcatSegmentsJoinsWithoutGaps) {
+    const std::string encoderName = ffmpeg_test_utils::pickH264EncoderName();
+    if (encoderName.empty()) {
+        GTEST_SKIP() << "No H.264 encoder available";
+    }
+
+    const int width = 64;
+    const int height = 64;
+    const int stride = width * 4;
+    std::vector<uint8_t> frame(static_cast<size_t>(stride * height), 0);
+
+    // Two segments as two workers would write them: closed GOPs and
+    // timestamps starting at 0 in each.
+    const uint32_t segmentFrames[] = {4, 3};
+    std::vector<std::string> segments;
+    for (uint32_t frames : segmentFrames) {
+        const auto path = tempVideoPath("shard_segment");
+        segments.push_back(path.string());
+
+        ffmpeg_utils::EncodeSettings settings;
+        settings.outputPath = path.string();
+        settings.codec = encoderName;
+        settings.fps = 30;
+        settings.preset = "veryfast";
+        settings.closedGop = true;
+        ffmpeg_utils::FfmpegEncoder encoder(settings, width, height,
+                                            AV_PIX_FMT_BGRA, stride);
+        ASSERT_NO_THROW(encoder.open());
+        for (uint32_t i = 0; i < frames; ++i) {
+            std::fill(frame.begin(), frame.end(),
+                      static_cast<uint8_t>(segments.size() * 100));
+            ASSERT_NO_THROW(encoder.encodeFrame(frame.data(), i));
+        }
+        ASSERT_NO_THROW(encoder.flush());
+        ASSERT_NO_THROW(encoder.close());
+    }
+
+    const auto joined = tempVideoPath("shard_joined");
+    ASSERT_NO_THROW(ffmpeg_utils::concatSegments(segments, joined.string()));
+
+    const auto metadata =
+        ffmpeg_test_utils::probeVideoMetadata(joined.string());
+    EXPECT_NEAR(metadata.durationSeconds, 7.0 / 30.0, 0.05);
+    const auto decoded = ffmpeg_test_utils::decodeVideoRgb24(joined.string());
+    EXPECT_EQ(decoded.width, width);
+    EXPECT_EQ(decoded.height, height);
+    EXPECT_EQ(decoded.frameCount, 7);
+
+    std::error_code ec;
+    for (const auto &segment : segments)
+        std::filesystem::remove(segment, ec);
+    std::filesystem::remove(joined, ec);
+}
@@ -0,0 +1,69 @@
+#include "ring_depth_controller.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+RingDepthController::Config testConfig() {
+    RingDepthController::Config config;
+    config.minDepth = 2;
+    config.maxDepth = 6;
+    config.windowFrames = 10;
+    config.shrinkAfterWindows = 2;
+    config.growCooldownWindows = 3;
+    return config;
+}
+
+void feedWindows(RingDepthController &controller, int windows,
+                 const RingDepthController::FrameTimes &times) {
+    for (int i = 0; i < windows * 10; ++i) {
+        controller.addFrame(times);
+    }
+}
+} // namespace
+
+TEST(RingDepthController, StartsAtMinimumDepth) {
+    RingDepthController controller(testConfig());
+    EXPECT_EQ(controller.depth(), 2u);
+}
+
+TEST(RingDepthController, GrowsWhileBottleneckIdles) {
+    RingDepthController controller(testConfig());
+    // Encoder-bound (8 ms encode vs 5 ms GPU) but waiting 2 ms per frame.
+    feedWindows(controller, 2, {.gpuMs = 4.0, .readbackMs = 1.0,
+                                .encodeMs = 8.0, .wallMs = 10.0});
+    EXPECT_EQ(controller.depth(), 4u);
+}
+
+TEST(RingDepthController, StopsAtMaximumDepth) {
+    RingDepthController controller(testConfig());
+    feedWindows(controller, 20, {.gpuMs = 1.0, .encodeMs = 2.0,
+                                 .wallMs = 10.0});
+    EXPECT_EQ(controller.depth(), 6u);
+    EXPECT_EQ(controller.peakDepth(), 6u);
+}
+
+TEST(RingDepthController, HoldsWhenBottleneckIsSaturated) {
+    RingDepthController controller(testConfig());
+    // GPU-bound and the GPU never waits: no reason to add slots.
+    feedWindows(controller, 10, {.gpuMs = 9.0, .readbackMs = 1.0,
+                                 .encodeMs = 3.0, .wallMs = 10.0});
+    EXPECT_EQ(controller.depth(), 2u);
+}
+
+TEST(RingDepthController, ShrinksAfterCalmWindowsAndCooldown) {
+    RingDepthController controller(testConfig());
+    feedWindows(controller, 2, {.gpuMs = 1.0, .encodeMs = 5.0,
+                                .wallMs = 10.0});
+    ASSERT_EQ(controller.depth(), 4u);
+
+    // Saturated from here on: cooldown (3) then one slot per 2 calm windows.
+    const RingDepthController::FrameTimes saturated{
+        .gpuMs = 1.0, .encodeMs = 10.0, .wallMs = 10.0};
+    feedWindows(controller, 2, saturated);
+    EXPECT_EQ(controller.depth(), 4u);
+    feedWindows(controller, 2, saturated);
+    EXPECT_EQ(controller.depth(), 3u);
+    feedWindows(controller, 10, saturated);
+    EXPECT_EQ(controller.depth(), 2u);
+    EXPECT_EQ(controller.peakDepth(), 4u);
+}
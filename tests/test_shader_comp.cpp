@@ -80,6 +80,72 @@ TEST(ShaderUtilsTest, CompileWithUnknownExtension) {
                  std::runtime_error);
 }
 
+TEST(ShaderUtilsTest, CompileEmbeddedOfflineShaders) {
+    ASSERT_FALSE(shader_utils::compileRgbaToYuvCompSpirv().empty());
+    ASSERT_FALSE(shader_utils::compileBoxDownsampleFragSpirv().empty());
+}
+
+TEST(ShaderUtilsTest, ToyTemplateFrameInputs) {
+    // Push constants by default; VSDF_FRAME_UBO switches the template to
+    // the uniform block the offline renderer records once against.
+    const auto pushSpirv = shader_utils::compileFileToSpirv(
+        SHADER_DIR "testtoyshader.frag", true);
+    EXPECT_TRUE(shader_utils::usesPushConstants(pushSpirv));
+    const auto uboSpirv = shader_utils::compileFileToSpirv(
+        SHADER_DIR "testtoyshader.frag", true,
+        shader_utils::FrameInputs::UniformBuffer);
+    EXPECT_FALSE(shader_utils::usesPushConstants(uboSpirv));
+}
+
+TEST(ShaderUtilsTest, PushConstantShaderIgnoresFrameUboDefine) {
+    TempShaderFile tempShader(
+        "temp_push.frag",
+        "#version 450\n"
+        "layout(push_constant) uniform P { float iTime; } pc;\n"
+        "layout(location = 0) out vec4 color;\n"
+        "void main() { color = vec4(pc.iTime); }");
+    const auto spirv = shader_utils::compileFileToSpirv(
+        tempShader.filename(), false,
+        shader_utils::FrameInputs::UniformBuffer);
+    EXPECT_TRUE(shader_utils::usesPushConstants(spirv));
+    EXPECT_FALSE(shader_utils::usesPushConstants(
+        shader_utils::compileFullscreenQuadVertSpirv()));
+}
+
+TEST(ShaderUtilsTest, CompilesLayeredFrameInputs) {
+    // Layered offline renders: per-layer inputs in the toy template and
+    // vulktemplate.frag, gl_Layer from the vertex shader.
+    const auto toySpirv = shader_utils::compileFileToSpirv(
+        SHADER_DIR "testtoyshader.frag", true,
+        shader_utils::FrameInputs::UniformBuffer, 4);
+    EXPECT_FALSE(shader_utils::usesPushConstants(toySpirv));
+    const auto templateSpirv = shader_utils::compileFileToSpirv(
+        SHADER_DIR "vulktemplate.frag", false,
+        shader_utils::FrameInputs::UniformBuffer, 4);
+    EXPECT_FALSE(shader_utils::usesPushConstants(templateSpirv));
+    EXPECT_TRUE(shader_utils::readsFrameLayer(toySpirv));
+    EXPECT_TRUE(shader_utils::readsFrameLayer(templateSpirv));
+    EXPECT_FALSE(shader_utils::compileFullscreenQuadVertSpirv(4).empty());
+}
+
+TEST(ShaderUtilsTest, DetectsShadersIgnoringFrameLayer) {
+    // A uniform-block shader without the per-layer inputs would render
+    // layer 0's frame into every layer.
+    TempShaderFile tempShader(
+        "temp_unlayered.frag",
+        "#version 450\n"
+        "layout(set = 0, binding = 0) uniform F { float iTime; } pc;\n"
+        "layout(location = 1) flat in int vsdfLayer;\n"
+        "layout(location = 0) out vec4 color;\n"
+        "void main() { color = vec4(pc.iTime); }");
+    const auto spirv = shader_utils::compileFileToSpirv(
+        tempShader.filename(), false,
+        shader_utils::FrameInputs::UniformBuffer, 4);
+    EXPECT_FALSE(shader_utils::readsFrameLayer(spirv));
+    EXPECT_FALSE(shader_utils::readsFrameLayer(
+        shader_utils::compileFileToSpirv(SHADER_DIR "vulktemplate.frag")));
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
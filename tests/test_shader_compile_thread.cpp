@@ -0,0 +1,103 @@
+#include "shader_compile_thread.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+// Polls like the render loop does, once per "frame".
+ShaderCompileThread<>::Result waitForResult(ShaderCompileThread<> &compiler) {
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (auto result = compiler.takeResult())
+            return *result;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    throw std::runtime_error("Timed out waiting for a compile");
+}
+} // namespace
+
+TEST(ShaderCompileThread, DeliversResultsAndErrors) {
+    ShaderCompileThread<> compiler;
+    EXPECT_FALSE(compiler.takeResult().has_value());
+
+    const uint64_t first =
+        compiler.request([] { return std::vector<uint32_t>{1, 2, 3}; });
+    auto result = waitForResult(compiler);
+    EXPECT_EQ(result.generation, first);
+    ASSERT_TRUE(result.output.has_value());
+    EXPECT_EQ(*result.output, (std::vector<uint32_t>{1, 2, 3}));
+    EXPECT_FALSE(compiler.takeResult().has_value());
+
+    compiler.request([]() -> std::vector<uint32_t> {
+        throw std::runtime_error("Failed to parse shader");
+    });
+    result = waitForResult(compiler);
+    EXPECT_FALSE(result.output.has_value());
+    EXPECT_EQ(result.error, "Failed to parse shader");
+}
+
+TEST(ShaderCompileThread, DropsCompilesOvertakenByNewerSaves) {
+    ShaderCompileThread<> compiler;
+    std::promise<void> started;
+    std::promise<void> release;
+    auto releaseFuture = release.get_future().share();
+    compiler.request([&started, releaseFuture] {
+        started.set_value();
+        releaseFuture.wait();
+        return std::vector<uint32_t>{1};
+    });
+    started.get_future().wait();
+
+    // Two saves while the first compile runs: the middle one never starts.
+    int middleRuns = 0;
+    compiler.request([&middleRuns] {
+        ++middleRuns;
+        return std::vector<uint32_t>{2};
+    });
+    const uint64_t newest =
+        compiler.request([] { return std::vector<uint32_t>{3}; });
+    release.set_value();
+
+    const auto result = waitForResult(compiler);
+    EXPECT_EQ(result.generation, newest);
+    EXPECT_EQ(*result.output, std::vector<uint32_t>{3});
+    EXPECT_EQ(middleRuns, 0);
+    EXPECT_EQ(compiler.droppedCount(), 1u);
+}
+
+TEST(ShaderCompileThread, DiscardsStaleAndUntakenResults) {
+    // Results that own GPU objects must be released when nobody takes
+    // them: the overtaken compile's at once, the last one on stop().
+    std::vector<int> discarded;
+    std::promise<void> started;
+    std::promise<void> release;
+    auto releaseFuture = release.get_future().share();
+    ShaderCompileThread<int> compiler(
+        [&discarded](int &value) { discarded.push_back(value); });
+    compiler.request([&started, releaseFuture] {
+        started.set_value();
+        releaseFuture.wait();
+        return 1;
+    });
+    started.get_future().wait();
+    compiler.request([] { return 2; });
+    release.set_value();
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (compiler.droppedCount() == 0 &&
+           std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    compiler.stop();
+    EXPECT_EQ(discarded, (std::vector<int>{1, 2}));
+    EXPECT_FALSE(compiler.takeResult().has_value());
+    compiler.request([] { return 3; });
+    EXPECT_FALSE(compiler.takeResult().has_value());
+}
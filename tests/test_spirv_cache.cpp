@@ -0,0 +1,91 @@
+#include "spirv_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+std::filesystem::path tempDir(const std::string &name) {
+    const auto stamp =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    return std::filesystem::temp_directory_path() /
+           ("vsdf_" + name + "_" + std::to_string(stamp));
+}
+
+// A SPIR-V header followed by `words` words of payload.
+std::vector<uint32_t> module(uint32_t words, uint32_t fill) {
+    std::vector<uint32_t> spirv(5 + words, fill);
+    spirv[0] = 0x07230203;
+    return spirv;
+}
+
+constexpr size_t kModuleBytes = (5 + 27) * sizeof(uint32_t);
+} // namespace
+
+TEST(SpirvCache, KeyCoversWholeInput) {
+    EXPECT_EQ(spirv_cache::makeKey("void main() {}"),
+              spirv_cache::makeKey("void main() {}"));
+    EXPECT_NE(spirv_cache::makeKey("void main() {}"),
+              spirv_cache::makeKey("void main() { }"));
+    EXPECT_NE(spirv_cache::makeKey(std::string("a\0b", 3)),
+              spirv_cache::makeKey("a"));
+}
+
+TEST(SpirvCache, MemoryHitsAndLruEviction) {
+    spirv_cache::Cache cache({}, 2 * kModuleBytes, 0);
+    EXPECT_FALSE(cache.find("a").has_value());
+    cache.store("a", module(27, 1));
+    cache.store("b", module(27, 2));
+    ASSERT_TRUE(cache.find("a").has_value());
+    // "b" is now the least recently used, so it makes room for "c".
+    cache.store("c", module(27, 3));
+    EXPECT_FALSE(cache.find("b").has_value());
+    EXPECT_EQ(cache.find("a"), module(27, 1));
+    EXPECT_EQ(cache.find("c"), module(27, 3));
+
+    const auto stats = cache.stats();
+    EXPECT_EQ(stats.memoryHits, 3u);
+    EXPECT_EQ(stats.diskHits, 0u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.evictions, 1u);
+}
+
+TEST(SpirvCache, DiskSurvivesRestartAndIsBounded) {
+    const auto dir = tempDir("spirv_cache");
+    {
+        spirv_cache::Cache cache(dir, 1 << 20, 2 * kModuleBytes);
+        cache.store("a", module(27, 1));
+        cache.store("b", module(27, 2));
+    }
+    {
+        // A new process: nothing in memory, both entries on disk.
+        spirv_cache::Cache cache(dir, 1 << 20, 2 * kModuleBytes);
+        EXPECT_EQ(cache.find("b"), module(27, 2));
+        EXPECT_EQ(cache.find("b"), module(27, 2));
+        EXPECT_EQ(cache.stats().diskHits, 1u);
+        EXPECT_EQ(cache.stats().memoryHits, 1u);
+        // Mark "a" older than "b" so it is evicted first.
+        std::filesystem::last_write_time(
+            dir / "a.spv",
+            std::filesystem::last_write_time(dir / "b.spv") -
+                std::chrono::hours(1));
+        cache.store("c", module(27, 3));
+        EXPECT_FALSE(std::filesystem::exists(dir / "a.spv"));
+        EXPECT_TRUE(std::filesystem::exists(dir / "b.spv"));
+        EXPECT_TRUE(std::filesystem::exists(dir / "c.spv"));
+        EXPECT_EQ(cache.stats().evictions, 1u);
+    }
+    {
+        // Files that aren't SPIR-V are misses, not errors.
+        std::ofstream out(dir / "bad.spv", std::ios::binary);
+        out << "not spirv";
+    }
+    spirv_cache::Cache cache(dir, 1 << 20, 1 << 20);
+    EXPECT_FALSE(cache.find("bad").has_value());
+    EXPECT_EQ(cache.stats().misses, 1u);
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,58 @@
+#include "spsc_ring.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+TEST(SpscRing, RoundsCapacityToPowerOfTwo) {
+    SpscRing<int> ring(3);
+    EXPECT_EQ(ring.capacity(), 4u);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(ring.tryPush(i));
+    }
+    EXPECT_FALSE(ring.tryPush(4));
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(ring.tryPop(), i);
+    }
+    EXPECT_FALSE(ring.tryPop().has_value());
+}
+
+TEST(SpscRing, CloseDrainsThenStops) {
+    SpscRing<int> ring(4);
+    ASSERT_TRUE(ring.push(7));
+    ring.close();
+    EXPECT_FALSE(ring.push(8));
+    EXPECT_EQ(ring.pop(), 7);
+    EXPECT_FALSE(ring.pop().has_value());
+}
+
+TEST(SpscRing, CloseWakesBlockedConsumer) {
+    SpscRing<int> ring(2);
+    std::thread consumer([&] { EXPECT_FALSE(ring.pop().has_value()); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ring.close();
+    consumer.join();
+}
+
+TEST(SpscRing, PreservesOrderAcrossThreads) {
+    // Small ring so both sides block on the atomic wait fallback often.
+    SpscRing<uint32_t> ring(2);
+    constexpr uint32_t count = 200000;
+
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < count; ++i) {
+            ASSERT_TRUE(ring.push(i));
+        }
+        ring.close();
+    });
+
+    uint32_t expected = 0;
+    while (auto value = ring.pop()) {
+        ASSERT_EQ(*value, expected);
+        ++expected;
+    }
+    producer.join();
+    EXPECT_EQ(expected, count);
+}
@@ -0,0 +1,70 @@
+#include "stage_profiler.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <sstream>
+#include <string>
+
+namespace {
+using Stage = StageProfiler::Stage;
+
+StageProfiler makeProfiler(int frames) {
+    StageProfiler profiler;
+    for (int i = 0; i < frames; ++i) {
+        StageProfiler::Sample sample;
+        sample.frameIndex = static_cast<uint32_t>(i);
+        // 1..frames ms so percentiles land on known values.
+        sample[Stage::GpuRender] = static_cast<double>(i + 1);
+        sample[Stage::Mux] = 0.5;
+        profiler.add(sample);
+    }
+    return profiler;
+}
+} // namespace
+
+TEST(StageProfiler, NearestRankPercentiles) {
+    const auto profiler = makeProfiler(100);
+    const auto render = profiler.stats(Stage::GpuRender);
+    EXPECT_DOUBLE_EQ(render.p50, 50.0);
+    EXPECT_DOUBLE_EQ(render.p95, 95.0);
+    EXPECT_DOUBLE_EQ(render.p99, 99.0);
+    EXPECT_DOUBLE_EQ(render.max, 100.0);
+    EXPECT_DOUBLE_EQ(render.mean, 50.5);
+
+    const auto mux = profiler.stats(Stage::Mux);
+    EXPECT_DOUBLE_EQ(mux.p50, 0.5);
+    EXPECT_DOUBLE_EQ(mux.max, 0.5);
+}
+
+TEST(StageProfiler, SingleSampleIsEveryPercentile) {
+    const auto stats = makeProfiler(1).stats(Stage::GpuRender);
+    EXPECT_DOUBLE_EQ(stats.p50, 1.0);
+    EXPECT_DOUBLE_EQ(stats.p99, 1.0);
+    EXPECT_DOUBLE_EQ(StageProfiler{}.stats(Stage::GpuRender).max, 0.0);
+}
+
+TEST(StageProfiler, WritesCsvRowPerFrame) {
+    std::ostringstream out;
+    makeProfiler(3).writeCsv(out);
+    const std::string csv = out.str();
+    EXPECT_EQ(csv.rfind("frame,gpu_render_ms,gpu_readback_ms,", 0), 0u);
+    EXPECT_NE(csv.find("\n2,3.0000,0.0000,"), std::string::npos);
+    size_t lines = 0;
+    for (const char c : csv)
+        lines += c == '\n';
+    EXPECT_EQ(lines, 4u);
+}
+
+TEST(StageProfiler, WritesJsonSummary) {
+    std::ostringstream out;
+    makeProfiler(4).writeJson(out, std::chrono::seconds(2));
+    const std::string json = out.str();
+    EXPECT_NE(json.find("\"frames\": 4"), std::string::npos);
+    EXPECT_NE(json.find("\"wall_seconds\": 2.0000"), std::string::npos);
+    EXPECT_NE(json.find("\"gpu_render\": {\"p50\": 2.0000"),
+              std::string::npos);
+    EXPECT_NE(json.find("{\"frame\": 3, \"gpu_render\": 4.0000"),
+              std::string::npos);
+    EXPECT_EQ(json.back(), '\n');
+}